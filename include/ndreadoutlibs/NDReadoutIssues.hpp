@@ -0,0 +1,35 @@
+/**
+ * @file NDReadoutIssues.hpp ND readout specific ERS issues
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_NDREADOUTISSUES_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_NDREADOUTISSUES_HPP_
+
+#include <ers/Issue.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace dunedaq {
+
+ERS_DECLARE_ISSUE(ndreadoutlibs,
+                  ConfigurationError,
+                  " ND readout configuration error: " << conferror,
+                  ((std::string)conferror))
+
+ERS_DECLARE_ISSUE(ndreadoutlibs,
+                  ReplayFileError,
+                  " Unable to replay capture file " << path << ": " << reason,
+                  ((std::string)path)((std::string)reason))
+
+ERS_DECLARE_ISSUE(ndreadoutlibs,
+                  RecordFileError,
+                  " Unable to write or read recording " << path << ": " << reason,
+                  ((std::string)path)((std::string)reason))
+
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_NDREADOUTISSUES_HPP_
@@ -0,0 +1,183 @@
+/**
+ * @file NDReadoutMPDInlineTypeAdapter.hpp MPD frame stored inside the latency buffer entry
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_NDREADOUTMPDINLINETYPEADAPTER_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_NDREADOUTMPDINLINETYPEADAPTER_HPP_
+
+#include "daqdataformats/FragmentHeader.hpp"
+#include "daqdataformats/SourceID.hpp"
+#include "nddetdataformats/MPDFrame.hpp"
+#include "ndreadoutlibs/mpd/MPDMessageFormat.hpp"
+#include "ndreadoutlibs/utils/LatencyStamps.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace types {
+
+/**
+ * @brief MPD frame copied into a buffer of InlineCapacity bytes inside the adapter.
+ *
+ * Frames up to InlineCapacity bytes need no allocation on load_message(), and the frame
+ * lives in the latency buffer entry itself. Larger frames fall back to a heap buffer, which
+ * a later oversized load into the same adapter reuses; heap_fallbacks() counts the heap
+ * allocations.
+ * */
+template<std::size_t InlineCapacity>
+struct NDReadoutMPDInlineTypeAdapterModel : latency::LoadStamp
+{
+  using FrameType = NDReadoutMPDInlineTypeAdapterModel;
+  static const constexpr std::size_t inline_capacity = InlineCapacity;
+
+  // Key decoded once by load_message(), so that comparisons never touch the payload
+  uint64_t timestamp = 0;     // NOLINT(build/unsigned)
+  uint32_t frame_bytes = 0;   // NOLINT(build/unsigned)
+  uint32_t heap_capacity = 0; // NOLINT(build/unsigned)
+  std::unique_ptr<char[]> heap; // NOLINT(modernize-avoid-c-arrays)
+  // Left uninitialised, only frame_bytes of it are ever read
+  alignas(8) std::array<char, InlineCapacity> inline_data;
+
+  NDReadoutMPDInlineTypeAdapterModel() = default;
+
+  NDReadoutMPDInlineTypeAdapterModel(const NDReadoutMPDInlineTypeAdapterModel& other)
+    : latency::LoadStamp(other)
+    , timestamp(other.timestamp)
+  {
+    store(other.message_data(), other.frame_bytes);
+  }
+
+  NDReadoutMPDInlineTypeAdapterModel& operator=(const NDReadoutMPDInlineTypeAdapterModel& other)
+  {
+    if (this != &other) {
+      latency::LoadStamp::operator=(other);
+      store(other.message_data(), other.frame_bytes);
+      timestamp = other.timestamp;
+    }
+    return *this;
+  }
+
+  // Only the valid bytes of the inline buffer are copied
+  NDReadoutMPDInlineTypeAdapterModel(NDReadoutMPDInlineTypeAdapterModel&& other) noexcept
+    : latency::LoadStamp(other)
+    , timestamp(other.timestamp)
+    , frame_bytes(std::exchange(other.frame_bytes, 0))
+    , heap_capacity(std::exchange(other.heap_capacity, 0))
+    , heap(std::move(other.heap))
+  {
+    if (!heap) {
+      std::memcpy(inline_data.data(), other.inline_data.data(), frame_bytes);
+    }
+  }
+
+  NDReadoutMPDInlineTypeAdapterModel& operator=(NDReadoutMPDInlineTypeAdapterModel&& other) noexcept
+  {
+    if (this != &other) {
+      latency::LoadStamp::operator=(other);
+      timestamp = other.timestamp;
+      frame_bytes = std::exchange(other.frame_bytes, 0);
+      heap_capacity = std::exchange(other.heap_capacity, 0);
+      heap = std::move(other.heap);
+      if (!heap) {
+        std::memcpy(inline_data.data(), other.inline_data.data(), frame_bytes);
+      }
+    }
+    return *this;
+  }
+
+  static std::atomic<uint64_t>& heap_fallbacks() // NOLINT(build/unsigned)
+  {
+    static std::atomic<uint64_t> counter{ 0 }; // NOLINT(build/unsigned)
+    return counter;
+  }
+
+  void load_message(const void* load_data, const unsigned int size)
+  {
+    store(load_data, size);
+    timestamp = decode_timestamp();
+    stamp_load();
+  }
+
+  bool operator<(const NDReadoutMPDInlineTypeAdapterModel& other) const { return timestamp < other.timestamp; }
+
+  uint64_t get_timestamp() const { return timestamp; } // NOLINT(build/unsigned)
+
+  uint64_t decode_timestamp() const // NOLINT(build/unsigned)
+  {
+    if (frame_bytes < sizeof(dunedaq::nddetdataformats::MPDFrame)) {
+      return 0;
+    }
+    auto frame = reinterpret_cast<const dunedaq::nddetdataformats::MPDFrame*>(message_data()); // NOLINT
+    return frame->get_timestamp();
+  }
+
+  uint64_t get_first_timestamp() const { return get_timestamp(); } // NOLINT(build/unsigned)
+  void set_first_timestamp(uint64_t ts) { timestamp = ts; }        // NOLINT(build/unsigned)
+
+  // Bytes of the frame as declared by its device header, or of the whole buffer when the
+  // header is missing or declares more than was received
+  std::size_t get_message_size() const
+  {
+    if (frame_bytes < mpd::device_header_size) {
+      return frame_bytes;
+    }
+    auto declared = mpd::declared_frame_size(message_data());
+    return declared <= frame_bytes ? declared : frame_bytes;
+  }
+
+  size_t get_payload_size() { return get_message_size(); }
+  size_t get_num_frames() { return 1; }
+  size_t get_frame_size() { return get_message_size(); }
+  // Bytes held in the latency buffer for this frame
+  size_t get_buffer_size() const { return sizeof(*this) + heap_capacity; }
+  // Bytes received for this frame, whatever its header declares
+  size_t get_received_size() const { return frame_bytes; }
+  static const constexpr uint64_t expected_tick_difference = 0; // NOLINT(build/unsigned)
+
+  char* message_data() { return heap ? heap.get() : inline_data.data(); }
+  const char* message_data() const { return heap ? heap.get() : inline_data.data(); }
+
+  FrameType* begin() { return reinterpret_cast<FrameType*>(message_data()); }                    // NOLINT
+  FrameType* end() { return reinterpret_cast<FrameType*>(message_data() + get_message_size()); } // NOLINT
+
+  static const constexpr daqdataformats::SourceID::Subsystem subsystem =
+    daqdataformats::SourceID::Subsystem::kDetectorReadout;
+  static const constexpr daqdataformats::FragmentType fragment_type = daqdataformats::FragmentType::kMPD;
+
+private:
+  void store(const void* src, std::size_t size)
+  {
+    if (size <= InlineCapacity) {
+      heap.reset();
+      heap_capacity = 0;
+    } else if (size > heap_capacity) {
+      heap.reset(new char[size]); // NOLINT(modernize-avoid-c-arrays)
+      heap_capacity = size;
+      heap_fallbacks().fetch_add(1, std::memory_order_relaxed);
+    }
+    frame_bytes = size;
+    if (size > 0) {
+      std::memcpy(message_data(), src, size);
+    }
+  }
+};
+
+// MPDFrame header and up to mpd::max_inline_sample_bytes of samples without allocation
+using NDReadoutMPDInlineTypeAdapter =
+  NDReadoutMPDInlineTypeAdapterModel<sizeof(nddetdataformats::MPDFrame) + mpd::max_inline_sample_bytes>;
+
+} // namespace types
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_NDREADOUTMPDINLINETYPEADAPTER_HPP_
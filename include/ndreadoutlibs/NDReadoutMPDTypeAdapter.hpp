@@ -13,8 +13,14 @@
 #include "daqdataformats/SourceID.hpp"
 #include "nddetdataformats/MPDFrame.hpp"
 #include "logging/Logging.hpp"
+#include "ndreadoutlibs/mpd/MPDMessageFormat.hpp"
+#include "ndreadoutlibs/utils/LatencyStamps.hpp"
+#include "ndreadoutlibs/utils/PayloadPool.hpp"
 #include <cstdint> // uint_t types
+#include <functional>
 #include <memory>  // unique_ptr
+#include <utility>
+#include <vector>
 
 namespace dunedaq {
   namespace ndreadoutlibs {
@@ -22,55 +28,94 @@ namespace dunedaq {
       /**
        * @brief MPD frame
        * */
-      struct NDReadoutMPDTypeAdapter {
+      struct NDReadoutMPDTypeAdapter : latency::LoadStamp {
 	using FrameType = NDReadoutMPDTypeAdapter;
-	std::vector<char> data ;
+	// Key decoded once by load_message(), so that comparisons never touch the payload
+	uint64_t timestamp = 0; // NOLINT(build/unsigned)
+	PayloadBuffer data ;
 
+	// Frames above PayloadPool::max_block_size are copied to a heap buffer of their own
 	void load_message( const void * load_data, const unsigned int size ) {
-	  data.resize(size);
-	  memcpy(&data[0], load_data, size);
+	  data.assign(load_data, size);
+	  timestamp = decode_timestamp();
+	  stamp_load();
 	}
 
-	bool operator<(const NDReadoutMPDTypeAdapter & other) const
+	/**
+	 * Zero-copy alternative to load_message(): the payload points into the given buffer and
+	 * owner is kept alive until the adapter releases it.
+	 * */
+	void adopt_message(void* load_data, const unsigned int size, std::shared_ptr<void> owner)
 	{
-          uint64_t this_timestamp  = 0;  //NOLINT
-          uint64_t other_timestamp = 0;  //NOLINT
+	  data.adopt(static_cast<char*>(load_data), size, std::move(owner));
+	  timestamp = decode_timestamp();
+	  stamp_load();
+	}
 
-          // 27-Apr-2023, KAB: the size of the data member needs to be checked to see whether it
-          // actually contains any data, before trying to interpret the contents.
-          if (data.size() >= sizeof(dunedaq::nddetdataformats::MPDFrame)) {
-            auto thisptr = reinterpret_cast<const dunedaq::nddetdataformats::MPDFrame*>(&data[0]);  // NOLINT
-            this_timestamp = thisptr->get_timestamp();
-          }
-          if (other.data.size() >= sizeof(dunedaq::nddetdataformats::MPDFrame)) {
-            auto otherptr = reinterpret_cast<const dunedaq::nddetdataformats::MPDFrame*>(&other.data[0]);  // NOLINT
-            other_timestamp = otherptr->get_timestamp();
-          }
+	// Adopt a buffer handed over with a callback that gives it back to its owner
+	void adopt_message(void* load_data, const unsigned int size, std::function<void()> release)
+	{
+	  adopt_message(load_data, size, std::shared_ptr<void>(load_data, [release = std::move(release)](void*) { release(); }));
+	}
 
-	  return (this_timestamp < other_timestamp) ? true : false;
+	// Move the receiver's message in
+	void adopt_message(std::vector<char>&& message)
+	{
+	  auto owner = std::make_shared<std::vector<char>>(std::move(message));
+	  adopt_message(owner->data(), owner->size(), std::shared_ptr<void>(owner));
+	}
+
+	bool operator<(const NDReadoutMPDTypeAdapter & other) const
+	{
+	  return (timestamp < other.timestamp) ? true : false;
 	}
 	
-	uint64_t get_timestamp() const // NOLINT(build/unsigned)
+	uint64_t get_timestamp() const { return timestamp; } // NOLINT(build/unsigned)
+
+	uint64_t decode_timestamp() const // NOLINT(build/unsigned)
 	{
+          // 27-Apr-2023, KAB: the size of the data member needs to be checked to see whether it
+          // actually contains any data, before trying to interpret the contents.
+          if (data.size() < sizeof(dunedaq::nddetdataformats::MPDFrame)) {
+            return 0;
+          }
 	  auto thisptr = reinterpret_cast<const dunedaq::nddetdataformats::MPDFrame*>(&data[0]);        // NOLINT
 	  return thisptr->get_timestamp();
 	}
 
 	uint64_t get_first_timestamp() const { return get_timestamp(); }
 
-	void set_first_timestamp(uint64_t /*ts*/) // NOLINT(build/unsigned)
+	void set_first_timestamp(uint64_t ts) // NOLINT(build/unsigned)
 	{
-	  //
+	  timestamp = ts;
 	}
 
-	size_t get_payload_size() { return data.size(); }
+	// Bytes of the frame as declared by its device header, or of the whole buffer when the
+	// header is missing or declares more than was received
+	std::size_t get_message_size() const
+	{
+	  if (data.size() < mpd::device_header_size) {
+	    return data.size();
+	  }
+	  auto declared = mpd::declared_frame_size(data.data());
+	  return declared <= data.size() ? declared : data.size();
+	}
+
+	size_t get_payload_size() { return get_message_size(); }
 	size_t get_num_frames() { return 1; }
-	size_t get_frame_size() { return data.size(); }
+	size_t get_frame_size() { return get_message_size(); }
+	// Bytes held in the latency buffer for this frame
+	size_t get_buffer_size() const { return data.size(); }
+	// Bytes received for this frame, whatever its header declares
+	size_t get_received_size() const { return data.size(); }
 	// Set the right value for this field
 	static const constexpr uint64_t expected_tick_difference = 0; // NOLINT(build/unsigned)
 
 	FrameType* begin() { return reinterpret_cast<FrameType*>(&data[0]); }
-	FrameType* end()   { return reinterpret_cast<FrameType*>(data[0] + data.size()); }
+	FrameType* end()   { return reinterpret_cast<FrameType*>(&data[0] + get_message_size()); } // NOLINT
+
+	// Frame bytes, get_message_size() of them are valid
+	const char* message_data() const { return data.data(); }
 
 	static const constexpr daqdataformats::SourceID::Subsystem subsystem = daqdataformats::SourceID::Subsystem::kDetectorReadout;
 	static const constexpr daqdataformats::FragmentType fragment_type = daqdataformats::FragmentType::kMPD;
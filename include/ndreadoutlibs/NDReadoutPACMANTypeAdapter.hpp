@@ -13,8 +13,19 @@
 #include "daqdataformats/SourceID.hpp"
 #include "nddetdataformats/PACMANFrame.hpp"
 #include "logging/Logging.hpp"
+#include "ndreadoutlibs/pacman/PACMANMessageFormat.hpp"
+#include "ndreadoutlibs/utils/LatencyStamps.hpp"
+#include "ndreadoutlibs/utils/PayloadPool.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cstdint> // uint_t types
+#include <functional>
+#include <limits>
 #include <memory>  // unique_ptr
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace dunedaq {
 
@@ -32,60 +43,315 @@ namespace dunedaq {
        * Size = 816[Bytes] (12*64+1*32+2*8)
        * */
       const constexpr std::size_t PACMAN_FRAME_SIZE = 1024 * 1024;
-      struct NDReadoutPACMANTypeAdapter
+      // PACMAN message layout: 8 byte header followed by header.words 16 byte words
+      const constexpr std::size_t PACMAN_MSG_HEADER_SIZE = 8;
+      const constexpr std::size_t PACMAN_MSG_WORD_SIZE = 16;
+      // Word type of PACMAN data words and packet type of LArPix data packets
+      const constexpr char PACMAN_DATA_WORD = 'D';
+      const constexpr uint8_t LARPIX_DATA_PACKET = 0; // NOLINT(build/unsigned)
+
+      /**
+       * @brief How NDReadoutPACMANTypeAdapter stores its payload
+       * kFixedFrame: every loaded adapter owns a zero-filled PACMAN_FRAME_SIZE block (legacy),
+       *              allocated by load_message() so that unloaded probe elements stay empty
+       * kPooled: only the bytes received by load_message() are kept, in a block of the
+       *          smallest fitting PayloadPool size class
+       * */
+      enum class PACMANStorageMode { kFixedFrame, kPooled };
+
+      /**
+       * @brief Source of the latency buffer key of a PACMAN message
+       * kUnixSeconds: header unix_ts only (one second granularity)
+       * kReceiptTimestamp: unix_ts plus the sub-second receipt timestamp of the first word
+       * kPacketTimestamp: unix_ts plus the sub-second LArPix timestamp of the first data packet
+       * kPacketRange: unix_ts plus the earliest sub-second LArPix data packet timestamp; the
+       *               latest one is kept as end of the message, for interval request matching
+       * The sub-second counters are expected to be reset by the PPS sync, their frequency is
+       * subsecond_clock_frequency.
+       * */
+      enum class PACMANTimestampMode { kUnixSeconds, kReceiptTimestamp, kPacketTimestamp, kPacketRange };
+
+      struct PACMANTypeAdapterConfig
+      {
+	PACMANStorageMode storage_mode = PACMANStorageMode::kFixedFrame;
+	PACMANTimestampMode timestamp_mode = PACMANTimestampMode::kUnixSeconds;
+	uint64_t clock_frequency = 50000000;           // NOLINT(build/unsigned) DAQ ticks per second
+	uint64_t subsecond_clock_frequency = 50000000; // NOLINT(build/unsigned)
+
+	bool operator==(const PACMANTypeAdapterConfig& other) const
+	{
+	  return std::tie(storage_mode, timestamp_mode, clock_frequency, subsecond_clock_frequency) ==
+	         std::tie(other.storage_mode, other.timestamp_mode, other.clock_frequency, other.subsecond_clock_frequency);
+	}
+	bool operator!=(const PACMANTypeAdapterConfig& other) const { return !(*this == other); }
+      };
+
+      struct NDReadoutPACMANTypeAdapter : latency::LoadStamp
       {
 	using FrameType = NDReadoutPACMANTypeAdapter;
-	// data
-	std::vector<char> data{std::vector<char>(PACMAN_FRAME_SIZE,0)};
+
+	/**
+	 * Process wide adapter settings. readoutlibs loads messages into default constructed
+	 * adapters, without any link context, so all PACMAN links of a process share them: the
+	 * first PACMANFrameProcessor::conf applies them through acquire_config(), the others must
+	 * agree, and they only change once every processor released them in scrap. Nothing but
+	 * acquire_config() (and single threaded tests) writes config(), and never while data flows.
+	 * */
+	static PACMANTypeAdapterConfig& config()
+	{
+	  static PACMANTypeAdapterConfig cfg;
+	  return cfg;
+	}
+
+	// Applies cfg if no processor holds the settings, returns false if different ones are held
+	static bool acquire_config(const PACMANTypeAdapterConfig& cfg)
+	{
+	  auto& holders = config_holders();
+	  std::lock_guard<std::mutex> lk(holders.mutex);
+	  if (holders.count != 0 && config() != cfg) {
+	    return false;
+	  }
+	  if (holders.count == 0) {
+	    config() = cfg;
+	  }
+	  ++holders.count;
+	  return true;
+	}
+
+	static void release_config()
+	{
+	  auto& holders = config_holders();
+	  std::lock_guard<std::mutex> lk(holders.mutex);
+	  if (holders.count != 0) {
+	    --holders.count;
+	  }
+	}
+
+	struct ConfigHolders
+	{
+	  std::mutex mutex;
+	  std::size_t count = 0;
+	};
+	static ConfigHolders& config_holders()
+	{
+	  static ConfigHolders holders;
+	  return holders;
+	}
+
+	// Tie-break between messages with the same timestamp, so none is lost on insert, shared
+	// by all links as it only needs to grow
+	static std::atomic<uint64_t>& sequence_counter() // NOLINT(build/unsigned)
+	{
+	  static std::atomic<uint64_t> counter{ 0 }; // NOLINT(build/unsigned)
+	  return counter;
+	}
+
+	// Key decoded once by load_message(), so that comparisons never touch the payload
+	uint64_t timestamp = 0; // NOLINT(build/unsigned)
+	uint64_t sequence = 0;  // NOLINT(build/unsigned)
+	// Latest packet timestamp in kPacketRange mode, the key otherwise
+	uint64_t end_timestamp = 0; // NOLINT(build/unsigned)
+	// data, empty until a message is loaded or adopted
+	PayloadBuffer data;
+
 	void load_message( const void * load_data, const unsigned int size ) {
-	  if( size > data.size() ) {
-	    ers::error(InvalidDataSize(ERS_HERE, size, data.size()));
+	  if( size > PACMAN_FRAME_SIZE ) {
+	    ers::error(InvalidDataSize(ERS_HERE, size, PACMAN_FRAME_SIZE));
+	    return;
+	  }
+	  sequence = sequence_counter().fetch_add(1, std::memory_order_relaxed) + 1;
+	  if (config().storage_mode == PACMANStorageMode::kPooled) {
+	    data.assign(load_data, size);
+	  } else {
+	    if (data.size() != PACMAN_FRAME_SIZE) {
+	      data = PayloadBuffer(PACMAN_FRAME_SIZE, true);
+	    }
+	    memcpy(&data[0], load_data, size);
+	    PayloadPool::instance().count_copy(size);
+	  }
+	  decode_keys();
+	  stamp_load();
+	}
+
+	/**
+	 * Zero-copy alternative to load_message(): the payload points into the given buffer and
+	 * owner is kept alive until the adapter releases it. Independently of the storage mode the
+	 * payload size is the adopted size.
+	 * */
+	void adopt_message(void* load_data, const unsigned int size, std::shared_ptr<void> owner)
+	{
+	  if( size > PACMAN_FRAME_SIZE ) {
+	    ers::error(InvalidDataSize(ERS_HERE, size, PACMAN_FRAME_SIZE));
 	    return;
 	  }
-	  memcpy(&data[0], load_data, size);
+	  sequence = sequence_counter().fetch_add(1, std::memory_order_relaxed) + 1;
+	  data.adopt(static_cast<char*>(load_data), size, std::move(owner));
+	  decode_keys();
+	  stamp_load();
 	}
 
-	// comparable based on first timestamp
+	// Adopt a buffer handed over with a callback that gives it back to its owner
+	void adopt_message(void* load_data, const unsigned int size, std::function<void()> release)
+	{
+	  adopt_message(load_data, size, std::shared_ptr<void>(load_data, [release = std::move(release)](void*) { release(); }));
+	}
+
+	// Move the receiver's message in
+	void adopt_message(std::vector<char>&& message)
+	{
+	  auto owner = std::make_shared<std::vector<char>>(std::move(message));
+	  adopt_message(owner->data(), owner->size(), std::shared_ptr<void>(owner));
+	}
+
+	// Key and end of the message
+	void decode_keys()
+	{
+	  if (config().timestamp_mode != PACMANTimestampMode::kPacketRange) {
+	    timestamp = decode_timestamp();
+	    end_timestamp = timestamp;
+	    return;
+	  }
+	  std::tie(timestamp, end_timestamp) = decode_packet_range();
+	}
+
+	// A header has to be present before anything can be decoded
+	bool has_header() const { return data.size() >= PACMAN_MSG_HEADER_SIZE; }
+
+	// comparable based on first timestamp, then arrival order
 	bool operator<(const NDReadoutPACMANTypeAdapter& other) const
 	{
-	  auto thisptr = reinterpret_cast<const dunedaq::nddetdataformats::PACMANFrame*>(&data[0]);        // NOLINT
-	  auto otherptr = reinterpret_cast<const dunedaq::nddetdataformats::PACMANFrame*>(&other.data[0]); // NOLINT
-	  return (thisptr->get_msg_header((void*)&data[0])->unix_ts) <
-	    (otherptr->get_msg_header((void*)&other.data[0])->unix_ts) // NOLINT
-	    ? true
-	    : false;
+	  if (timestamp != other.timestamp) {
+	    return timestamp < other.timestamp;
+	  }
+	  return sequence < other.sequence;
+	}
+
+	// Message timestamp in DAQ ticks, at the granularity selected by config().timestamp_mode
+	uint64_t get_timestamp() const { return timestamp; } // NOLINT(build/unsigned)
+
+	uint64_t decode_timestamp() const // NOLINT(build/unsigned)
+	{
+	  if (!has_header()) {
+	    return 0;
+	  }
+	  auto frame = reinterpret_cast<const dunedaq::nddetdataformats::PACMANFrame*>(&data[0]); // NOLINT
+	  auto header = frame->get_msg_header((void*)&data[0]);                                    // NOLINT
+	  auto& cfg = config();
+	  uint64_t ticks = static_cast<uint64_t>(header->unix_ts) * cfg.clock_frequency; // NOLINT(build/unsigned)
+	  if (cfg.timestamp_mode == PACMANTimestampMode::kUnixSeconds) {
+	    return ticks;
+	  }
+	  if (cfg.timestamp_mode == PACMANTimestampMode::kPacketRange) {
+	    return decode_packet_range().first;
+	  }
+
+	  uint64_t num_words = std::min<uint64_t>(header->words, // NOLINT(build/unsigned)
+						  (data.size() - PACMAN_MSG_HEADER_SIZE) / PACMAN_MSG_WORD_SIZE);
+	  for (uint64_t i = 0; i < num_words; ++i) { // NOLINT(build/unsigned)
+	    auto word = frame->get_msg_word((void*)&data[0], i); // NOLINT
+	    uint64_t subsecond = 0;                               // NOLINT(build/unsigned)
+	    if (cfg.timestamp_mode == PACMANTimestampMode::kReceiptTimestamp) {
+	      subsecond = word->data_word.receipt_timestamp;
+	    } else if ((char)word->data_word.type == PACMAN_DATA_WORD && // NOLINT
+		       word->data_word.larpix_word.data_packet.type == LARPIX_DATA_PACKET) {
+	      subsecond = word->data_word.larpix_word.data_packet.timestamp;
+	    } else {
+	      continue;
+	    }
+	    subsecond %= cfg.subsecond_clock_frequency;
+	    return ticks + subsecond * cfg.clock_frequency / cfg.subsecond_clock_frequency;
+	  }
+	  return ticks;
+	}
+
+	/**
+	 * Earliest and latest timestamps of the LArPix data packets with correct parity, in DAQ
+	 * ticks. Both are the header unix_ts when the message holds no such packet.
+	 * */
+	std::pair<uint64_t, uint64_t> decode_packet_range() const // NOLINT(build/unsigned)
+	{
+	  if (!has_header()) {
+	    return { 0, 0 };
+	  }
+	  const char* msg = data.data();
+	  uint64_t second_ticks = static_cast<uint64_t>(pacman::load_header_unix_ts(msg)) * config().clock_frequency; // NOLINT
+	  std::size_t num_words = std::min<std::size_t>(pacman::load_header_words(msg),
+							(data.size() - PACMAN_MSG_HEADER_SIZE) / PACMAN_MSG_WORD_SIZE);
+	  uint64_t first = std::numeric_limits<uint64_t>::max(); // NOLINT(build/unsigned)
+	  uint64_t last = 0;                                      // NOLINT(build/unsigned)
+	  for (std::size_t i = 0; i < num_words; ++i) {
+	    const char* word = msg + PACMAN_MSG_HEADER_SIZE + i * PACMAN_MSG_WORD_SIZE;
+	    uint64_t packet = pacman::load_packet(word); // NOLINT(build/unsigned)
+	    if (!is_data_packet(word, packet)) {
+	      continue;
+	    }
+	    auto ticks = packet_ticks(second_ticks, packet);
+	    first = std::min(first, ticks);
+	    last = std::max(last, ticks);
+	  }
+	  if (first > last) {
+	    return { second_ticks, second_ticks };
+	  }
+	  return { first, last };
+	}
+
+	// Data word carrying a LArPix data packet with correct parity
+	static bool is_data_packet(const char* word, uint64_t packet) // NOLINT(build/unsigned)
+	{
+	  return static_cast<uint8_t>(word[pacman::word_type_offset]) == pacman::data_word_type && // NOLINT(build/unsigned)
+		 ((packet >> pacman::packet_type_shift) & pacman::packet_type_mask) == LARPIX_DATA_PACKET &&
+		 pacman::parity_ok(packet);
 	}
 
-	// message UNIX timestamp - NOT individual packet timestamps
-	uint64_t get_timestamp() const // NOLINT(build/unsigned)
+	// DAQ ticks of a data packet of a message sent in the second starting at second_ticks
+	static uint64_t packet_ticks(uint64_t second_ticks, uint64_t packet) // NOLINT(build/unsigned)
 	{
-	  return ((uint64_t)( // NOLINT
-			     reinterpret_cast<const dunedaq::nddetdataformats::PACMANFrame*>(&data[0])
-			     ->get_msg_header((void*)&data[0])
-			     ->unix_ts) * // NOLINT
-		  // 1000000000);
-		  // FIX ME!!! HARDCODED CONVERSION TO TICKS FROM SECONDS. MULTIPLYING BY 5E7 SINCE
-		  // 50 MHz CLOCK.
-		  50000000);
+	  auto& cfg = config();
+	  uint64_t count = ((packet >> pacman::timestamp_shift) & pacman::timestamp_mask) % // NOLINT(build/unsigned)
+			   cfg.subsecond_clock_frequency;
+	  return second_ticks + count * cfg.clock_frequency / cfg.subsecond_clock_frequency;
 	}
 
 	uint64_t get_first_timestamp() const { return get_timestamp(); }
+	uint64_t get_end_timestamp() const { return end_timestamp; } // NOLINT(build/unsigned)
 
-	// FIX ME - implement this in the frame later
-	void set_first_timestamp(uint64_t /*ts*/) // NOLINT(build/unsigned)
+	// Only the cached keys are set, the message header is left untouched. The end keeps its
+	// distance to the key.
+	void set_first_timestamp(uint64_t ts) // NOLINT(build/unsigned)
 	{
-	  // reinterpret_cast<dunedaq::nddetdataformats::PACMANFrame*>(&data)->set_timestamp(ts); // NOLINT
+	  end_timestamp = ts + (end_timestamp > timestamp ? end_timestamp - timestamp : 0);
+	  timestamp = ts;
 	}
 
 	uint64_t get_message_type() const // NOLINT(build/unsigned)
 	{
+	  if (!has_header()) {
+	    return 0;
+	  }
 	  return reinterpret_cast<const dunedaq::nddetdataformats::PACMANFrame*>(&data[0]) // NOLINT
 	    ->get_msg_header((void*)&data[0])                                                    // NOLINT
 	    ->type;
 	}
+
+	// Bytes of the received message. A fixed frame block does not keep the received size,
+	// there the size declared by the header word count is used.
+	std::size_t get_message_size() const
+	{
+	  if (data.size() != PACMAN_FRAME_SIZE || !has_header()) {
+	    return data.size();
+	  }
+	  auto words = reinterpret_cast<const dunedaq::nddetdataformats::PACMANFrame*>(&data[0]) // NOLINT
+			 ->get_msg_header((void*)&data[0])                                          // NOLINT
+			 ->words;
+	  return std::min(data.size(), PACMAN_MSG_HEADER_SIZE + words * PACMAN_MSG_WORD_SIZE);
+	}
+
 	void inspect_message() const
 	{
 	  TLOG_DEBUG(1) << "Message timestamp: " << get_timestamp();
+	  if (!has_header()) {
+	    return;
+	  }
 
 	  TLOG_DEBUG(1) << "Message Type: " << (char)get_message_type(); // NOLINT
 
@@ -126,14 +392,18 @@ namespace dunedaq {
 
 	FrameType* end()
 	{
-	  return reinterpret_cast<FrameType*>(data[0] + data.size()); // NOLINT
+	  return reinterpret_cast<FrameType*>(&data[0] + get_message_size()); // NOLINT
 	}
 
-	size_t get_payload_size() { return data.size(); }
+	// Only the message bytes are shipped, never the padding of a fixed frame block
+	size_t get_payload_size() { return get_message_size(); }
 
 	size_t get_num_frames() { return 1; }
 
-	size_t get_frame_size() { return data.size(); }
+	size_t get_frame_size() { return get_message_size(); }
+
+	// Bytes held in the latency buffer for this message
+	size_t get_buffer_size() const { return data.size(); }
 
 	static const constexpr daqdataformats::SourceID::Subsystem subsystem = daqdataformats::SourceID::Subsystem::kDetectorReadout;
 	static const constexpr daqdataformats::FragmentType fragment_type = daqdataformats::FragmentType::kPACMAN;
@@ -0,0 +1,127 @@
+/**
+ * @file LinkMergerModel.hpp Time ordered merge of several ND links into one latency buffer
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_LINKMERGERMODEL_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_LINKMERGERMODEL_HPP_
+
+#include "logging/Logging.hpp"
+#include "ndreadoutlibs/NDReadoutIssues.hpp"
+#include "ndreadoutlibs/models/MergedLinkElement.hpp"
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/ndreadoutconfig/Nljs.hpp"
+#include "ndreadoutlibs/ndreadoutinfo/InfoNljs.hpp"
+#include "opmonlib/InfoCollector.hpp"
+#include "readoutlibs/ReadoutLogging.hpp"
+
+#include <folly/ProducerConsumerQueue.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+/**
+ * @brief K-way merge of the messages of several links, in key order, into one latency buffer.
+ *
+ * Every link pushes into its own SPSC queue. A merge thread keeps the oldest message of each
+ * link as its cursor and a min-heap of the cursors, and writes the heap top into the shared
+ * buffer tagged with its link. The top is only written once no link can still deliver an
+ * older message: every other link has a cursor, or already delivered a message at least as
+ * recent, or has been silent for longer than the maximum wait, after which it no longer holds
+ * the merge back. Links are expected to deliver their own messages in key order.
+ * */
+template<class ReadoutType>
+class LinkMergerModel
+{
+public:
+  using MergedType = MergedLinkElement<ReadoutType>;
+  using LatencyBufferType = NDLatencyBufferModel<MergedType>;
+  using timestamp_t = std::uint64_t; // NOLINT(build/unsigned)
+
+  explicit LinkMergerModel(std::unique_ptr<LatencyBufferType>& latency_buffer)
+    : m_latency_buffer(latency_buffer)
+  {}
+  ~LinkMergerModel() { stop(); }
+  LinkMergerModel(const LinkMergerModel&) = delete;
+  LinkMergerModel& operator=(const LinkMergerModel&) = delete;
+
+  void conf(const nlohmann::json& args);
+  void start();
+  // Merges whatever is queued regardless of the wait, then joins the merge thread
+  void stop();
+
+  // Called on the merge thread after every write, typically the request handler cleanup_check
+  void set_write_callback(std::function<void()> callback) { m_write_callback = std::move(callback); }
+
+  // Producer side of one link; returns false if the link queue is full
+  bool push(std::size_t link, ReadoutType&& element);
+
+  std::size_t num_links() const { return m_links.size(); }
+  void get_info(opmonlib::InfoCollector& ci, int level);
+
+private:
+  struct Link
+  {
+    std::unique_ptr<folly::ProducerConsumerQueue<ReadoutType>> queue;
+    std::optional<ReadoutType> cursor;
+    timestamp_t last_ts = 0;
+    bool seen = false;
+    std::chrono::steady_clock::time_point last_arrival;
+  };
+
+  // Heap entry, ordered so that std::push_heap keeps the oldest cursor on top
+  struct HeapEntry
+  {
+    timestamp_t ts;
+    std::size_t link;
+    bool operator<(const HeapEntry& other) const
+    {
+      return ts != other.ts ? ts > other.ts : link > other.link;
+    }
+  };
+
+  void run();
+  void refill(std::size_t link, std::chrono::steady_clock::time_point now);
+  bool can_emit(const HeapEntry& top, std::chrono::steady_clock::time_point now, bool draining);
+  // Returns the number of messages written
+  std::size_t merge(bool draining);
+
+  std::unique_ptr<LatencyBufferType>& m_latency_buffer;
+  std::function<void()> m_write_callback;
+  std::vector<Link> m_links;
+  std::vector<HeapEntry> m_heap;
+  std::size_t m_queue_size = 1024;
+  std::chrono::microseconds m_max_wait{ 1000 };
+  timestamp_t m_last_merged_ts = 0;
+
+  std::atomic<bool> m_run_marker{ false };
+  std::thread m_thread;
+
+  // Stats
+  std::atomic<uint64_t> m_merged{ 0 };         // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_input_dropped{ 0 };  // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_buffer_dropped{ 0 }; // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_late{ 0 };           // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_idle_skips{ 0 };     // NOLINT(build/unsigned)
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+// Declarations
+#include "detail/LinkMergerModel.hxx"
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_LINKMERGERMODEL_HPP_
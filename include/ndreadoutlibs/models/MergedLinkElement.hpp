@@ -0,0 +1,99 @@
+/**
+ * @file MergedLinkElement.hpp Latency buffer element of a merged buffer, tagged with the link
+ * it was received on
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_MERGEDLINKELEMENT_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_MERGEDLINKELEMENT_HPP_
+
+#include "daqdataformats/FragmentHeader.hpp"
+#include "daqdataformats/SourceID.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+/**
+ * Precedes every message in the fragments of a merged buffer, so that consumers can tell
+ * the links apart: the link index given to LinkMergerModel::push and the message bytes that
+ * follow the header.
+ * */
+struct MergedPieceHeader
+{
+  uint32_t link = 0; // NOLINT(build/unsigned)
+  uint32_t size = 0; // NOLINT(build/unsigned)
+};
+
+/**
+ * @brief A ReadoutType element together with the link it came from.
+ *
+ * Forwards the adapter interface used by the latency buffers and request handlers to the
+ * wrapped element. Elements are ordered by key, then link, then by the element order, so
+ * that a probe with only the key set sorts before every element of that key.
+ * */
+template<class ReadoutType>
+struct MergedLinkElement
+{
+  using FrameType = typename ReadoutType::FrameType;
+
+  MergedPieceHeader header;
+  ReadoutType element;
+
+  MergedLinkElement() = default;
+  MergedLinkElement(ReadoutType&& readout_element, uint32_t link) // NOLINT(build/unsigned)
+    : element(std::move(readout_element))
+  {
+    header.link = link;
+    header.size = element.get_payload_size();
+  }
+
+  bool operator<(const MergedLinkElement& other) const
+  {
+    auto ts = element.get_first_timestamp();
+    auto other_ts = other.element.get_first_timestamp();
+    if (ts != other_ts) {
+      return ts < other_ts;
+    }
+    if (header.link != other.header.link) {
+      return header.link < other.header.link;
+    }
+    return element < other.element;
+  }
+
+  uint32_t get_link() const { return header.link; } // NOLINT(build/unsigned)
+  uint64_t get_load_stamp() const { return element.get_load_stamp(); } // NOLINT(build/unsigned)
+
+  uint64_t get_timestamp() const { return element.get_timestamp(); }             // NOLINT(build/unsigned)
+  uint64_t get_first_timestamp() const { return element.get_first_timestamp(); } // NOLINT(build/unsigned)
+  void set_first_timestamp(uint64_t ts) { element.set_first_timestamp(ts); }     // NOLINT(build/unsigned)
+  // Only present if the wrapped element covers a time range
+  template<class R = ReadoutType>
+  auto get_end_timestamp() const -> decltype(std::declval<const R&>().get_end_timestamp())
+  {
+    return element.get_end_timestamp();
+  }
+
+  size_t get_payload_size() { return element.get_payload_size(); }
+  size_t get_num_frames() { return element.get_num_frames(); }
+  size_t get_frame_size() { return element.get_frame_size(); }
+  size_t get_buffer_size() const { return element.get_buffer_size(); }
+
+  FrameType* begin() { return element.begin(); }
+  FrameType* end() { return element.end(); }
+
+  static const constexpr uint64_t expected_tick_difference = ReadoutType::expected_tick_difference; // NOLINT
+  static const constexpr daqdataformats::SourceID::Subsystem subsystem = ReadoutType::subsystem;
+  static const constexpr daqdataformats::FragmentType fragment_type = ReadoutType::fragment_type;
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_MERGEDLINKELEMENT_HPP_
@@ -0,0 +1,61 @@
+/**
+ * @file MergedListRequestHandlerModel.hpp Trigger matching on the shared latency buffer of
+ * merged links
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_MERGEDLISTREQUESTHANDLERMODEL_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_MERGEDLISTREQUESTHANDLERMODEL_HPP_
+
+#include "logging/Logging.hpp"
+#include "ndreadoutlibs/models/MergedLinkElement.hpp"
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/models/NDListRequestHandlerModel.hpp"
+#include "readoutlibs/ReadoutLogging.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+/**
+ * Serves a request window across every link fed into a LinkMergerModel with one fragment.
+ * Each message in the fragment is preceded by its MergedPieceHeader (link index and message
+ * size), messages follow in key order across the links. Elements covering a time range
+ * (PACMAN messages in the range timestamp mode) are matched on that range as by
+ * PACMANListRequestHandler.
+ * */
+template<class ReadoutType>
+class MergedListRequestHandlerModel
+  : public NDListRequestHandlerModel<MergedLinkElement<ReadoutType>, NDLatencyBufferModel<MergedLinkElement<ReadoutType>>>
+{
+public:
+  using MergedType = MergedLinkElement<ReadoutType>;
+  using LatencyBufferType = NDLatencyBufferModel<MergedType>;
+  using inherited = NDListRequestHandlerModel<MergedType, LatencyBufferType>;
+
+  MergedListRequestHandlerModel(std::unique_ptr<LatencyBufferType>& latency_buffer,
+                                std::unique_ptr<readoutlibs::FrameErrorRegistry>& error_registry)
+    : inherited(latency_buffer, error_registry)
+  {
+    TLOG_DEBUG(readoutlibs::logging::TLVL_WORK_STEPS) << "MergedListRequestHandlerModel created...";
+  }
+
+protected:
+  std::size_t add_fragment_pieces(MergedType& element, typename inherited::FragmentContext& context) override
+  {
+    context.pieces.emplace_back(static_cast<void*>(&element.header), sizeof(MergedPieceHeader));
+    context.pieces.emplace_back(static_cast<void*>(element.begin()), element.header.size);
+    return sizeof(MergedPieceHeader) + element.header.size;
+  }
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_MERGEDLISTREQUESTHANDLERMODEL_HPP_
@@ -0,0 +1,209 @@
+/**
+ * @file NDLatencyBufferModel.hpp Latency buffer of the ND request handlers, backed by a skip
+ * list or by time buckets depending on the configuration
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_NDLATENCYBUFFERMODEL_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_NDLATENCYBUFFERMODEL_HPP_
+
+#include "readoutlibs/concepts/LatencyBufferConcept.hpp"
+#include "readoutlibs/models/SkipListLatencyBufferModel.hpp"
+
+#include "logging/Logging.hpp"
+#include "ndreadoutlibs/NDReadoutIssues.hpp"
+#include "ndreadoutlibs/models/TimeBucketLatencyBufferModel.hpp"
+#include "ndreadoutlibs/ndreadoutconfig/Nljs.hpp"
+#include "ndreadoutlibs/utils/DeferredReclaimer.hpp"
+#include "ndreadoutlibs/utils/LatencyStamps.hpp"
+#include "readoutlibs/ReadoutLogging.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+// Elements covering a time range, from their key to get_end_timestamp()
+template<class T, class = void>
+struct has_end_timestamp : std::false_type
+{};
+template<class T>
+struct has_end_timestamp<T, std::void_t<decltype(std::declval<const T&>().get_end_timestamp())>> : std::true_type
+{};
+
+/**
+ * @brief Latency buffer selected by ndreadoutconf.latency_buffer_model.
+ *
+ * "skiplist" (default) keeps the readoutlibs SkipListLatencyBufferModel, "buckets" the
+ * TimeBucketLatencyBufferModel. Both backends exist, only the configured one receives data.
+ * Besides the LatencyBufferConcept and the iterator interface used by readoutlibs, it offers
+ * window traversal and timestamp based cleanup for either backend.
+ * */
+template<class T>
+class NDLatencyBufferModel : public readoutlibs::LatencyBufferConcept<T>
+{
+public:
+  using timestamp_t = std::uint64_t; // NOLINT(build/unsigned)
+  using SkipListModel = readoutlibs::SkipListLatencyBufferModel<T>;
+  using BucketModel = TimeBucketLatencyBufferModel<T>;
+  using SkipListIterator = decltype(std::declval<SkipListModel&>().lower_bound(std::declval<T&>(), false));
+  using BucketIterator = typename BucketModel::Iterator;
+
+  enum class Backend
+  {
+    kSkipList,
+    kTimeBuckets
+  };
+
+  class NDIterator
+  {
+  public:
+    explicit NDIterator(SkipListIterator&& it)
+      : m_skip_list(std::move(it))
+    {}
+    explicit NDIterator(BucketIterator&& it)
+      : m_buckets(std::move(it))
+    {}
+
+    NDIterator& operator++()
+    {
+      if (m_skip_list) {
+        ++*m_skip_list;
+      } else {
+        ++*m_buckets;
+      }
+      return *this;
+    }
+    T& operator*() { return m_skip_list ? **m_skip_list : **m_buckets; }
+    T* operator->() { return &**this; }
+    bool good() { return m_skip_list ? m_skip_list->good() : m_buckets->good(); }
+    bool operator==(const NDIterator& other) const
+    {
+      return m_skip_list ? *m_skip_list == *other.m_skip_list : *m_buckets == *other.m_buckets;
+    }
+    bool operator!=(const NDIterator& other) const { return !(*this == other); }
+
+  private:
+    std::optional<SkipListIterator> m_skip_list;
+    std::optional<BucketIterator> m_buckets;
+  };
+  using Iterator = NDIterator;
+
+  NDLatencyBufferModel() = default;
+
+  void conf(const nlohmann::json& cfg) override;
+  void scrap(const nlohmann::json& cfg) override;
+
+  std::size_t occupancy() const override
+  {
+    return m_backend == Backend::kSkipList ? m_skip_list.occupancy() : m_buckets.occupancy();
+  }
+  bool write(T&& new_element) override
+  {
+    m_insert_latency.record_since_load(new_element);
+    note_span(new_element);
+    return m_backend == Backend::kSkipList ? m_skip_list.write(std::move(new_element))
+                                           : m_buckets.write(std::move(new_element));
+  }
+  bool put(T& new_element)
+  {
+    m_insert_latency.record_since_load(new_element);
+    note_span(new_element);
+    return m_backend == Backend::kSkipList ? m_skip_list.put(new_element) : m_buckets.put(new_element);
+  }
+  bool read(T& element) override
+  {
+    return m_backend == Backend::kSkipList ? m_skip_list.read(element) : m_buckets.read(element);
+  }
+
+  Iterator begin();
+  Iterator end();
+  Iterator lower_bound(T& element, bool with_errors = false);
+
+  // As in readoutlibs, the pointer is not kept alive against a concurrent pop or cleanup
+  const T* front() override { return m_backend == Backend::kSkipList ? m_skip_list.front() : m_buckets.front(); }
+  const T* back() override { return m_backend == Backend::kSkipList ? m_skip_list.back() : m_buckets.back(); }
+  // Keys of the oldest and newest element, read while the backend keeps the element alive
+  std::optional<timestamp_t> front_timestamp();
+  std::optional<timestamp_t> back_timestamp();
+  void pop(std::size_t num = 1) override; // NOLINT(build/unsigned)
+  void flush() override;
+  void allocate_memory(std::size_t size) override;
+
+  // Call fn(element) for every element with key in [begin_ts, end_ts), in key order for the skip list.
+  // The visited elements stay valid as long as the returned handle is held.
+  template<class Fn>
+  std::shared_ptr<const void> for_each_in_window(timestamp_t begin_ts, timestamp_t end_ts, Fn&& fn);
+
+  /**
+   * Remove elements with key below ts, oldest first, until max_num are removed. The bucket
+   * backend removes whole buckets and may exceed max_num by one bucket; its retired buckets
+   * are handed to reclaimer when given. Skip list entries are released by the skip list
+   * itself, once no accessor refers to them anymore.
+   * */
+  LatencyBufferEviction pop_until(timestamp_t ts,
+                                  std::size_t max_num = std::numeric_limits<std::size_t>::max(),
+                                  DeferredReclaimer* reclaimer = nullptr);
+
+  Backend get_backend() const { return m_backend; }
+  SkipListModel& get_skip_list_model() { return m_skip_list; }
+  BucketModel& get_bucket_model() { return m_buckets; }
+  // Time from load_message() to insertion, recorded with NDREADOUTLIBS_LATENCY_STAMPS
+  latency::LogLinearHistogram& get_insert_latency() { return m_insert_latency; }
+
+  /**
+   * For elements with an end timestamp: widest end - key written since the last reset, at
+   * most the span limit, and the number of elements found wider than the limit.
+   * */
+  timestamp_t get_max_span() const { return m_max_span.load(std::memory_order_relaxed); }
+  uint64_t get_capped_spans() const { return m_capped_spans.load(std::memory_order_relaxed); } // NOLINT
+  void set_span_limit(timestamp_t limit) { m_span_limit = limit; }
+  void reset_max_span()
+  {
+    m_max_span.store(0, std::memory_order_relaxed);
+    m_capped_spans.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  void note_span(const T& element)
+  {
+    if constexpr (has_end_timestamp<T>::value) {
+      auto end = element.get_end_timestamp();
+      auto key = element.get_first_timestamp();
+      timestamp_t span = end > key ? end - key : 0;
+      if (span > m_span_limit) {
+        m_capped_spans.fetch_add(1, std::memory_order_relaxed);
+        span = m_span_limit;
+      }
+      auto current = m_max_span.load(std::memory_order_relaxed);
+      while (span > current && !m_max_span.compare_exchange_weak(current, span, std::memory_order_relaxed)) {
+      }
+    }
+  }
+
+  Backend m_backend = Backend::kSkipList;
+  SkipListModel m_skip_list;
+  BucketModel m_buckets;
+  latency::LogLinearHistogram m_insert_latency;
+  std::atomic<timestamp_t> m_max_span{ 0 };
+  std::atomic<uint64_t> m_capped_spans{ 0 }; // NOLINT(build/unsigned)
+  timestamp_t m_span_limit = std::numeric_limits<timestamp_t>::max();
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+// Declarations
+#include "detail/NDLatencyBufferModel.hxx"
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_NDLATENCYBUFFERMODEL_HPP_
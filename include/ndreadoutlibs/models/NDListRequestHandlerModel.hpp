@@ -0,0 +1,128 @@
+/**
+ * @file NDListRequestHandlerModel.hpp Request handling shared by the ND request handlers
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_NDLISTREQUESTHANDLERMODEL_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_NDLISTREQUESTHANDLERMODEL_HPP_
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+#include "readoutlibs/ReadoutIssues.hpp"
+#include "readoutlibs/models/DefaultRequestHandlerModel.hpp"
+
+#include "daqdataformats/Fragment.hpp"
+#include "logging/Logging.hpp"
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/ndreadoutconfig/Nljs.hpp"
+#include "ndreadoutlibs/ndreadoutinfo/InfoNljs.hpp"
+#include "ndreadoutlibs/utils/DeferredReclaimer.hpp"
+#include "ndreadoutlibs/utils/LatencyStamps.hpp"
+#include "readoutlibs/ReadoutLogging.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+/**
+ * Trigger matching on a latency buffer offering for_each_in_window() (NDLatencyBufferModel).
+ * ND messages carry no fixed number of ticks, so a request collects every message whose key
+ * falls in the window instead of stepping through the buffer frame by frame. The fragment is
+ * gathered from pointers into the latency buffer entries, each sized to the message bytes.
+ * Entries whose data extends past their key are matched through window_lookup_begin() and
+ * overlaps_window(): for elements with get_end_timestamp(), a request looks back by the
+ * widest range written to the latency buffer since start, capped at
+ * pacman_max_range_span_ticks, and keeps the entries whose range reaches into the window.
+ *
+ * Cleanup evicts in batches, either down to the pop size when the occupancy exceeds the pop
+ * limit or up to a horizon behind the newest key, and stops starting batches once its time
+ * budget is spent. Requests are not blocked meanwhile: they and the cleanup read the buffer
+ * bounds as keys (front_timestamp(), back_timestamp()), and the handle returned by
+ * for_each_in_window() keeps evicted entries alive until the fragment is built.
+ *
+ * Built with NDREADOUTLIBS_LATENCY_STAMPS, it reports the time from load_message() to the
+ * latency buffer insert and to the request serving each message, and the request durations.
+ * */
+template<class RDT, class LBT>
+class NDListRequestHandlerModel : public readoutlibs::DefaultRequestHandlerModel<RDT, LBT>
+{
+public:
+  using inherited = readoutlibs::DefaultRequestHandlerModel<RDT, LBT>;
+  using RequestResult = typename inherited::RequestResult;
+  using ResultCode = typename inherited::ResultCode;
+
+  NDListRequestHandlerModel(std::unique_ptr<LBT>& latency_buffer,
+                            std::unique_ptr<readoutlibs::FrameErrorRegistry>& error_registry)
+    : inherited(latency_buffer, error_registry)
+  {}
+
+  void conf(const nlohmann::json& args) override;
+  void start(const nlohmann::json& args) override;
+  void stop(const nlohmann::json& args) override;
+  void cleanup_check() override;
+  void get_info(opmonlib::InfoCollector& ci, int level) override;
+
+protected:
+  RequestResult data_request(dfmessages::DataRequest dr) override;
+
+  // Request window being served and the pieces of its fragment
+  struct FragmentContext
+  {
+    uint64_t begin_ts = 0; // NOLINT(build/unsigned)
+    uint64_t end_ts = 0;   // NOLINT(build/unsigned)
+    std::vector<std::pair<void*, size_t>> pieces;
+    // Piece bytes not held by the latency buffer, kept until the fragment is built
+    std::deque<std::vector<char>> storage;
+  };
+
+  // Smallest key of an entry that can hold data from begin_ts on
+  virtual uint64_t window_lookup_begin(uint64_t begin_ts); // NOLINT(build/unsigned)
+  // Whether an entry keyed before the window holds data inside it
+  virtual bool overlaps_window(const RDT& element, const FragmentContext& context);
+  // Append the fragment pieces of one latency buffer entry, returns the bytes they add.
+  // An entry adding no piece is not counted as part of the fragment.
+  virtual std::size_t add_fragment_pieces(RDT& element, FragmentContext& context);
+
+  bool cleanup_needed();
+  void cleanup_pass();
+
+  // Configuration
+  uint64_t m_cleanup_horizon = 0; // NOLINT(build/unsigned)
+  std::size_t m_cleanup_batch_size = 1024;
+  std::chrono::microseconds m_cleanup_budget{ 200 };
+  bool m_deferred_reclaim = true;
+
+  DeferredReclaimer m_reclaimer;
+  std::atomic<bool> m_cleanup_running{ false };
+
+  // Stats
+  std::atomic<uint64_t> m_cleanup_passes{ 0 };          // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_budget_exhausted_passes{ 0 }; // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_entries_evicted{ 0 };         // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_bytes_freed{ 0 };             // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_cleanup_time_us{ 0 };         // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_max_cleanup_time_us{ 0 };     // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_fragments{ 0 };               // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_fragment_pieces{ 0 };         // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_buffer_bytes{ 0 };            // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_shipped_bytes{ 0 };           // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_max_fragment_bytes{ 0 };      // NOLINT(build/unsigned)
+  latency::LogLinearHistogram m_serve_latency;
+  latency::LogLinearHistogram m_request_latency;
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+// Declarations
+#include "detail/NDListRequestHandlerModel.hxx"
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_NDLISTREQUESTHANDLERMODEL_HPP_
@@ -0,0 +1,213 @@
+/**
+ * @file TimeBucketLatencyBufferModel.hpp Latency buffer of time buckets holding append-only
+ * arrays of ND messages
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_TIMEBUCKETLATENCYBUFFERMODEL_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_TIMEBUCKETLATENCYBUFFERMODEL_HPP_
+
+#include "readoutlibs/concepts/LatencyBufferConcept.hpp"
+
+#include "logging/Logging.hpp"
+#include "ndreadoutlibs/NDReadoutIssues.hpp"
+#include "ndreadoutlibs/ndreadoutconfig/Nljs.hpp"
+#include "readoutlibs/ReadoutLogging.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+// What an eviction from an ND latency buffer removed, and how many buffer bytes it gave back
+struct LatencyBufferEviction
+{
+  std::size_t entries = 0;
+  std::size_t bytes = 0;
+};
+
+/**
+ * @brief Latency buffer for data without a fixed rate.
+ *
+ * The key space is cut into buckets of bucket_width ticks. A bucket stores its messages in
+ * arrival order in a segmented array (chunk k holds base_chunk_entries << k elements), so
+ * elements never move once written and an insert is an amortized O(1) append.
+ * Window lookups only visit the buckets overlapping the window and cleanup retires whole
+ * buckets.
+ *
+ * One thread writes, any number of threads read, and one cleans up. Appends to an existing
+ * bucket are lock free; the ordered list of buckets is an immutable snapshot, replaced under
+ * a mutex when a bucket is created or retired. Readers and iterators hold the snapshot they
+ * started with, so retired buckets are freed by whoever releases the last reference.
+ * */
+template<class T>
+class TimeBucketLatencyBufferModel : public readoutlibs::LatencyBufferConcept<T>
+{
+public:
+  using timestamp_t = std::uint64_t; // NOLINT(build/unsigned)
+
+  static const constexpr std::size_t base_chunk_entries = 64;
+  static const constexpr std::size_t max_chunks = 40;
+
+  class Bucket
+  {
+  public:
+    Bucket(timestamp_t index, timestamp_t width)
+      : m_index(index)
+      , m_begin_ts(index * width)
+      , m_end_ts(index * width + width)
+    {}
+    ~Bucket();
+    Bucket(const Bucket&) = delete;
+    Bucket& operator=(const Bucket&) = delete;
+
+    // Writer side
+    void append(T&& element);
+
+    // Reader side
+    T& at(std::size_t pos) const;
+    std::size_t size() const { return m_size.load(std::memory_order_acquire); }
+    std::size_t first() const { return m_popped.load(std::memory_order_acquire); }
+    std::size_t visible() const { return size() - std::min(size(), first()); }
+    bool sorted() const { return m_sorted.load(std::memory_order_acquire); }
+    // Buffer bytes of all elements ever appended
+    std::size_t buffer_bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+    // First position at or after first() whose key is not below ts, first() if the bucket is not sorted
+    std::size_t lower_bound(timestamp_t ts) const;
+
+    timestamp_t index() const { return m_index; }
+    timestamp_t begin_ts() const { return m_begin_ts; }
+    timestamp_t end_ts() const { return m_end_ts; }
+    bool contains(timestamp_t ts) const { return ts >= m_begin_ts && ts < m_end_ts; }
+
+  private:
+    friend class TimeBucketLatencyBufferModel;
+
+    static std::pair<std::size_t, std::size_t> locate(std::size_t pos);
+
+    const timestamp_t m_index;
+    const timestamp_t m_begin_ts;
+    const timestamp_t m_end_ts;
+    std::array<std::atomic<T*>, max_chunks> m_chunks{};
+    std::atomic<std::size_t> m_size{ 0 };
+    std::atomic<std::size_t> m_popped{ 0 };
+    std::atomic<bool> m_sorted{ true };
+    std::atomic<std::size_t> m_bytes{ 0 };
+    timestamp_t m_last_ts = 0; // writer only
+  };
+
+  using BucketPtr = std::shared_ptr<Bucket>;
+  using Snapshot = std::vector<BucketPtr>;
+  using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+  /**
+   * Walks the buffer in bucket order, arrival order within a bucket. The iterator keeps
+   * its snapshot alive, so elements stay valid while it exists.
+   * */
+  class BucketIterator
+  {
+  public:
+    BucketIterator() = default;
+    BucketIterator(SnapshotPtr snapshot, std::size_t bucket, std::size_t pos);
+
+    BucketIterator& operator++();
+    T& operator*() { return (*m_snapshot)[m_bucket]->at(m_pos); }
+    T* operator->() { return &(*m_snapshot)[m_bucket]->at(m_pos); }
+    bool good() { return m_snapshot && m_bucket < m_snapshot->size() && m_pos < (*m_snapshot)[m_bucket]->size(); }
+    bool operator==(const BucketIterator& other) const { return m_bucket == other.m_bucket && m_pos == other.m_pos; }
+    bool operator!=(const BucketIterator& other) const { return !(*this == other); }
+
+  private:
+    void skip_empty();
+
+    SnapshotPtr m_snapshot;
+    std::size_t m_bucket = 0;
+    std::size_t m_pos = 0;
+  };
+  using Iterator = BucketIterator;
+
+  TimeBucketLatencyBufferModel()
+    : m_snapshot(std::make_shared<const Snapshot>())
+  {
+    TLOG_DEBUG(readoutlibs::logging::TLVL_WORK_STEPS) << "Initializing time bucket latency buffer";
+  }
+
+  // Reads ndreadoutconf.bucket_width_ticks if present
+  void conf(const nlohmann::json& cfg) override;
+  void scrap(const nlohmann::json& /*cfg*/) override { flush(); }
+
+  std::size_t occupancy() const override { return m_occupancy.load(std::memory_order_relaxed); }
+  bool write(T&& new_element) override;
+  bool put(T& new_element);
+  bool read(T& element) override;
+
+  Iterator begin();
+  Iterator end();
+  // Elements before the returned position have lower keys; later ones may too, if their bucket received data out of order
+  Iterator lower_bound(T& element, bool with_errors = false);
+
+  // Oldest and newest element. The pointer stays valid only until the next pop or cleanup,
+  // readers running alongside the cleanup use front_timestamp() and back_timestamp().
+  const T* front() override;
+  const T* back() override;
+  // Keys of the oldest and newest element, read while the snapshot holds them
+  std::optional<timestamp_t> front_timestamp() const;
+  std::optional<timestamp_t> back_timestamp() const;
+  void pop(std::size_t num = 1) override; // NOLINT(build/unsigned)
+  void flush() override;
+  void allocate_memory(std::size_t /*size*/) override {}
+
+  // Call fn(element) for every element with key in [begin_ts, end_ts), visiting only the overlapping buckets.
+  // The returned handle keeps the visited elements alive.
+  template<class Fn>
+  std::shared_ptr<const void> for_each_in_window(timestamp_t begin_ts, timestamp_t end_ts, Fn&& fn);
+
+  /**
+   * Retire the buckets ending at or before ts, oldest first, until at least max_num elements
+   * are removed. The bucket being written is not retired, its elements are hidden instead.
+   * Retired buckets are moved to retired if given, so that the caller chooses where they are
+   * freed. Bytes are counted for retired buckets only, as hidden elements are not freed yet.
+   * */
+  LatencyBufferEviction pop_until(timestamp_t ts,
+                                  std::size_t max_num = std::numeric_limits<std::size_t>::max(),
+                                  Snapshot* retired = nullptr);
+
+  SnapshotPtr get_snapshot() const { return std::atomic_load(&m_snapshot); }
+  std::size_t num_buckets() const { return get_snapshot()->size(); }
+  timestamp_t get_bucket_width() const { return m_bucket_width; }
+
+private:
+  // Bucket for ts, created and published if needed; called by the writer with m_mutex held
+  Bucket* find_or_create(timestamp_t ts);
+  void publish(Snapshot&& buckets) { std::atomic_store(&m_snapshot, SnapshotPtr(std::make_shared<const Snapshot>(std::move(buckets)))); }
+  static std::size_t first_bucket_from(const Snapshot& buckets, timestamp_t index);
+  static const T* front_of(const Snapshot& buckets);
+  static const T* back_of(const Snapshot& buckets);
+
+  timestamp_t m_bucket_width = 50000;
+  SnapshotPtr m_snapshot;
+  std::mutex m_mutex;
+  std::atomic<std::size_t> m_occupancy{ 0 };
+  // Writer fast path: the bucket of the previous insert. pop() and pop_until() never retire
+  // it, flush() and scrap() expect the writer to be stopped.
+  std::atomic<Bucket*> m_write_bucket{ nullptr };
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+// Declarations
+#include "detail/TimeBucketLatencyBufferModel.hxx"
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MODELS_TIMEBUCKETLATENCYBUFFERMODEL_HPP_
@@ -0,0 +1,176 @@
+// Declarations for LinkMergerModel
+
+#include <algorithm>
+
+#include <pthread.h>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+template<class ReadoutType>
+void
+LinkMergerModel<ReadoutType>::conf(const nlohmann::json& args)
+{
+  ndreadoutconfig::Conf ndconf;
+  if (args.contains("ndreadoutconf")) {
+    ndconf = args["ndreadoutconf"].get<ndreadoutconfig::Conf>();
+  }
+  if (ndconf.link_merge_inputs == 0) {
+    throw ConfigurationError(ERS_HERE, "link_merge_inputs must be non-zero");
+  }
+  m_queue_size = std::max<std::size_t>(ndconf.link_merge_queue_size, 2);
+  m_max_wait = std::chrono::microseconds(ndconf.link_merge_max_wait_us);
+  m_links.clear();
+  m_links.resize(ndconf.link_merge_inputs);
+  for (auto& link : m_links) {
+    link.queue = std::make_unique<folly::ProducerConsumerQueue<ReadoutType>>(m_queue_size);
+  }
+  m_heap.clear();
+  m_heap.reserve(m_links.size());
+  TLOG_DEBUG(readoutlibs::logging::TLVL_WORK_STEPS) << "Merging " << m_links.size() << " links";
+}
+
+template<class ReadoutType>
+void
+LinkMergerModel<ReadoutType>::start()
+{
+  if (m_run_marker.exchange(true)) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  for (auto& link : m_links) {
+    link.last_arrival = now;
+  }
+  m_thread = std::thread(&LinkMergerModel<ReadoutType>::run, this);
+  pthread_setname_np(m_thread.native_handle(), "nd-link-merge");
+}
+
+template<class ReadoutType>
+void
+LinkMergerModel<ReadoutType>::stop()
+{
+  if (!m_run_marker.exchange(false)) {
+    return;
+  }
+  m_thread.join();
+}
+
+template<class ReadoutType>
+bool
+LinkMergerModel<ReadoutType>::push(std::size_t link, ReadoutType&& element)
+{
+  if (m_links[link].queue->write(std::move(element))) {
+    return true;
+  }
+  m_input_dropped.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+template<class ReadoutType>
+void
+LinkMergerModel<ReadoutType>::run()
+{
+  while (m_run_marker.load(std::memory_order_relaxed)) {
+    if (merge(false) == 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+  while (merge(true) != 0) {
+  }
+}
+
+template<class ReadoutType>
+void
+LinkMergerModel<ReadoutType>::refill(std::size_t link_index, std::chrono::steady_clock::time_point now)
+{
+  auto& link = m_links[link_index];
+  ReadoutType element;
+  if (!link.queue->read(element)) {
+    return;
+  }
+  timestamp_t ts = element.get_first_timestamp();
+  link.cursor.emplace(std::move(element));
+  link.last_ts = link.seen ? std::max(link.last_ts, ts) : ts;
+  link.seen = true;
+  link.last_arrival = now;
+  m_heap.push_back(HeapEntry{ ts, link_index });
+  std::push_heap(m_heap.begin(), m_heap.end());
+}
+
+template<class ReadoutType>
+bool
+LinkMergerModel<ReadoutType>::can_emit(const HeapEntry& top,
+                                       std::chrono::steady_clock::time_point now,
+                                       bool draining)
+{
+  if (draining) {
+    return true;
+  }
+  for (auto& link : m_links) {
+    if (link.cursor || (link.seen && link.last_ts >= top.ts)) {
+      continue;
+    }
+    if (now - link.last_arrival < m_max_wait) {
+      return false;
+    }
+    m_idle_skips.fetch_add(1, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+template<class ReadoutType>
+std::size_t
+LinkMergerModel<ReadoutType>::merge(bool draining)
+{
+  auto now = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < m_links.size(); ++i) {
+    if (!m_links[i].cursor) {
+      refill(i, now);
+    }
+  }
+
+  std::size_t written = 0;
+  while (!m_heap.empty() && can_emit(m_heap.front(), now, draining)) {
+    std::pop_heap(m_heap.begin(), m_heap.end());
+    HeapEntry top = m_heap.back();
+    m_heap.pop_back();
+    auto& link = m_links[top.link];
+
+    if (top.ts < m_last_merged_ts) {
+      // Arrived after the wait for its link expired, the buffer still sorts it in
+      m_late.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_last_merged_ts = std::max(m_last_merged_ts, top.ts);
+    if (m_latency_buffer->write(MergedType(std::move(*link.cursor), top.link))) {
+      m_merged.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      m_buffer_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    link.cursor.reset();
+    ++written;
+    if (m_write_callback) {
+      m_write_callback();
+    }
+    refill(top.link, now);
+  }
+  return written;
+}
+
+template<class ReadoutType>
+void
+LinkMergerModel<ReadoutType>::get_info(opmonlib::InfoCollector& ci, int /*level*/)
+{
+  ndreadoutinfo::LinkMergerInfo info;
+  info.merged = m_merged.exchange(0);
+  info.input_dropped = m_input_dropped.exchange(0);
+  info.buffer_dropped = m_buffer_dropped.exchange(0);
+  info.late = m_late.exchange(0);
+  info.idle_link_skips = m_idle_skips.exchange(0);
+  for (auto& link : m_links) {
+    info.queued += link.queue->sizeGuess();
+  }
+  ci.add(info);
+}
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
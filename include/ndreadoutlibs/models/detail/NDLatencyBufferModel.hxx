@@ -0,0 +1,174 @@
+// Declarations for NDLatencyBufferModel
+
+#include <string>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+template<class T>
+void
+NDLatencyBufferModel<T>::conf(const nlohmann::json& cfg)
+{
+  std::string model = "skiplist";
+  if (cfg.contains("ndreadoutconf")) {
+    model = cfg["ndreadoutconf"].get<ndreadoutconfig::Conf>().latency_buffer_model;
+  }
+  if (model == "skiplist") {
+    m_backend = Backend::kSkipList;
+    m_skip_list.conf(cfg);
+  } else if (model == "buckets") {
+    m_backend = Backend::kTimeBuckets;
+    m_buckets.conf(cfg);
+  } else {
+    throw ConfigurationError(ERS_HERE, "unknown latency_buffer_model " + model);
+  }
+  TLOG_DEBUG(readoutlibs::logging::TLVL_WORK_STEPS) << "ND latency buffer model: " << model;
+}
+
+template<class T>
+void
+NDLatencyBufferModel<T>::scrap(const nlohmann::json& cfg)
+{
+  m_skip_list.scrap(cfg);
+  m_buckets.scrap(cfg);
+}
+
+template<class T>
+typename NDLatencyBufferModel<T>::Iterator
+NDLatencyBufferModel<T>::begin()
+{
+  if (m_backend == Backend::kSkipList) {
+    return Iterator(m_skip_list.begin());
+  }
+  return Iterator(m_buckets.begin());
+}
+
+template<class T>
+typename NDLatencyBufferModel<T>::Iterator
+NDLatencyBufferModel<T>::end()
+{
+  if (m_backend == Backend::kSkipList) {
+    return Iterator(m_skip_list.end());
+  }
+  return Iterator(m_buckets.end());
+}
+
+template<class T>
+typename NDLatencyBufferModel<T>::Iterator
+NDLatencyBufferModel<T>::lower_bound(T& element, bool with_errors)
+{
+  if (m_backend == Backend::kSkipList) {
+    return Iterator(m_skip_list.lower_bound(element, with_errors));
+  }
+  return Iterator(m_buckets.lower_bound(element, with_errors));
+}
+
+template<class T>
+void
+NDLatencyBufferModel<T>::pop(std::size_t num) // NOLINT(build/unsigned)
+{
+  if (m_backend == Backend::kSkipList) {
+    m_skip_list.pop(num);
+  } else {
+    m_buckets.pop(num);
+  }
+}
+
+template<class T>
+void
+NDLatencyBufferModel<T>::flush()
+{
+  if (m_backend == Backend::kSkipList) {
+    m_skip_list.flush();
+  } else {
+    m_buckets.flush();
+  }
+}
+
+template<class T>
+void
+NDLatencyBufferModel<T>::allocate_memory(std::size_t size)
+{
+  if (m_backend == Backend::kSkipList) {
+    m_skip_list.allocate_memory(size);
+  } else {
+    m_buckets.allocate_memory(size);
+  }
+}
+
+template<class T>
+std::optional<typename NDLatencyBufferModel<T>::timestamp_t>
+NDLatencyBufferModel<T>::front_timestamp()
+{
+  if (m_backend == Backend::kTimeBuckets) {
+    return m_buckets.front_timestamp();
+  }
+  typename SkipListModel::SkipListTAcc acc(m_skip_list.get_skip_list());
+  auto first = acc.first();
+  return first == nullptr ? std::nullopt : std::optional<timestamp_t>(first->get_first_timestamp());
+}
+
+template<class T>
+std::optional<typename NDLatencyBufferModel<T>::timestamp_t>
+NDLatencyBufferModel<T>::back_timestamp()
+{
+  if (m_backend == Backend::kTimeBuckets) {
+    return m_buckets.back_timestamp();
+  }
+  typename SkipListModel::SkipListTAcc acc(m_skip_list.get_skip_list());
+  auto last = acc.last();
+  return last == nullptr ? std::nullopt : std::optional<timestamp_t>(last->get_first_timestamp());
+}
+
+template<class T>
+template<class Fn>
+std::shared_ptr<const void>
+NDLatencyBufferModel<T>::for_each_in_window(timestamp_t begin_ts, timestamp_t end_ts, Fn&& fn)
+{
+  if (m_backend == Backend::kTimeBuckets) {
+    return m_buckets.for_each_in_window(begin_ts, end_ts, std::forward<Fn>(fn));
+  }
+  T request_element;
+  request_element.set_first_timestamp(begin_ts);
+  // The iterator holds a skip list accessor, which defers the release of removed nodes
+  auto it = std::make_shared<SkipListIterator>(m_skip_list.lower_bound(request_element, false));
+  for (; it->good(); ++*it) {
+    if ((*it)->get_first_timestamp() >= end_ts) {
+      break;
+    }
+    fn(**it);
+  }
+  return it;
+}
+
+template<class T>
+LatencyBufferEviction
+NDLatencyBufferModel<T>::pop_until(timestamp_t ts, std::size_t max_num, DeferredReclaimer* reclaimer)
+{
+  if (m_backend == Backend::kTimeBuckets) {
+    if (reclaimer == nullptr) {
+      return m_buckets.pop_until(ts, max_num);
+    }
+    auto retired = std::make_shared<typename BucketModel::Snapshot>();
+    auto eviction = m_buckets.pop_until(ts, max_num, retired.get());
+    if (!retired->empty()) {
+      reclaimer->retire(std::move(retired));
+    }
+    return eviction;
+  }
+  // One accessor for the whole batch: removed nodes are only released once it is dropped
+  LatencyBufferEviction eviction;
+  typename SkipListModel::SkipListTAcc acc(m_skip_list.get_skip_list());
+  for (auto first = acc.first(); first != nullptr && first->get_first_timestamp() < ts && eviction.entries < max_num;
+       first = acc.first()) {
+    eviction.bytes += first->get_buffer_size();
+    if (!acc.remove(*first)) {
+      break;
+    }
+    ++eviction.entries;
+  }
+  return eviction;
+}
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
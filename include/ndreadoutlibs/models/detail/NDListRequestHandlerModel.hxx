@@ -0,0 +1,286 @@
+// Declarations for NDListRequestHandlerModel
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+template<class RDT, class LBT>
+void
+NDListRequestHandlerModel<RDT, LBT>::conf(const nlohmann::json& args)
+{
+  inherited::conf(args);
+  if (args.contains("ndreadoutconf")) {
+    auto ndconf = args["ndreadoutconf"].get<ndreadoutconfig::Conf>();
+    m_cleanup_horizon = ndconf.cleanup_horizon_ticks;
+    m_cleanup_batch_size = std::max<std::size_t>(ndconf.cleanup_batch_size, 1);
+    m_cleanup_budget = std::chrono::microseconds(ndconf.cleanup_time_budget_us);
+    m_deferred_reclaim = ndconf.cleanup_deferred_reclaim;
+  }
+  if constexpr (has_end_timestamp<RDT>::value) {
+    ndreadoutconfig::Conf ndconf;
+    if (args.contains("ndreadoutconf")) {
+      ndconf = args["ndreadoutconf"].get<ndreadoutconfig::Conf>();
+    }
+    inherited::m_latency_buffer->set_span_limit(ndconf.pacman_max_range_span_ticks);
+  }
+}
+
+template<class RDT, class LBT>
+void
+NDListRequestHandlerModel<RDT, LBT>::start(const nlohmann::json& args)
+{
+  // Ranges of a previous run do not widen the lookback of this one
+  inherited::m_latency_buffer->reset_max_span();
+  if (m_deferred_reclaim) {
+    m_reclaimer.start("nd-reclaim");
+  }
+  inherited::start(args);
+}
+
+template<class RDT, class LBT>
+void
+NDListRequestHandlerModel<RDT, LBT>::stop(const nlohmann::json& args)
+{
+  inherited::stop(args);
+  m_reclaimer.stop();
+}
+
+template<class RDT, class LBT>
+bool
+NDListRequestHandlerModel<RDT, LBT>::cleanup_needed()
+{
+  auto& latency_buffer = inherited::m_latency_buffer;
+  if (latency_buffer->occupancy() > inherited::m_pop_limit_size) {
+    return true;
+  }
+  if (m_cleanup_horizon == 0) {
+    return false;
+  }
+  auto front_ts = latency_buffer->front_timestamp();
+  auto back_ts = latency_buffer->back_timestamp();
+  return front_ts && back_ts && *back_ts > *front_ts + m_cleanup_horizon;
+}
+
+template<class RDT, class LBT>
+void
+NDListRequestHandlerModel<RDT, LBT>::cleanup_check()
+{
+  // Called after every write; a pass already running elsewhere is not waited for. Unlike
+  // readoutlibs, requests are not excluded: they only touch entries through keys and the
+  // keep-alive handle of for_each_in_window().
+  if (!cleanup_needed() || m_cleanup_running.exchange(true)) {
+    return;
+  }
+  cleanup_pass();
+  m_cleanup_running.store(false);
+}
+
+template<class RDT, class LBT>
+void
+NDListRequestHandlerModel<RDT, LBT>::cleanup_pass()
+{
+  auto start = std::chrono::steady_clock::now();
+  auto& latency_buffer = inherited::m_latency_buffer;
+  DeferredReclaimer* reclaimer = m_deferred_reclaim ? &m_reclaimer : nullptr;
+
+  std::size_t occupancy = latency_buffer->occupancy();
+  std::size_t to_evict = occupancy > inherited::m_pop_limit_size ? inherited::m_pop_size_pct * occupancy : 0;
+  uint64_t horizon = 0; // NOLINT(build/unsigned)
+  auto back_ts = m_cleanup_horizon != 0 ? latency_buffer->back_timestamp() : std::nullopt;
+  if (back_ts && *back_ts > m_cleanup_horizon) {
+    horizon = *back_ts - m_cleanup_horizon;
+  }
+
+  LatencyBufferEviction evicted;
+  bool budget_exhausted = false;
+  while (true) {
+    LatencyBufferEviction batch;
+    if (evicted.entries < to_evict) {
+      batch = latency_buffer->pop_until(std::numeric_limits<uint64_t>::max(), // NOLINT(build/unsigned)
+                                        std::min(m_cleanup_batch_size, to_evict - evicted.entries),
+                                        reclaimer);
+    } else if (horizon != 0) {
+      batch = latency_buffer->pop_until(horizon, m_cleanup_batch_size, reclaimer);
+    }
+    evicted.entries += batch.entries;
+    evicted.bytes += batch.bytes;
+    if (batch.entries == 0) {
+      break;
+    }
+    if (m_cleanup_budget.count() != 0 && std::chrono::steady_clock::now() - start >= m_cleanup_budget) {
+      budget_exhausted = true;
+      break;
+    }
+  }
+
+  uint64_t duration = // NOLINT(build/unsigned)
+    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  inherited::m_pops_count += evicted.entries;
+  ++inherited::m_pop_reqs;
+  ++m_cleanup_passes;
+  m_budget_exhausted_passes += budget_exhausted;
+  m_entries_evicted += evicted.entries;
+  m_bytes_freed += evicted.bytes;
+  m_cleanup_time_us += duration;
+  if (duration > m_max_cleanup_time_us.load(std::memory_order_relaxed)) {
+    m_max_cleanup_time_us.store(duration, std::memory_order_relaxed);
+  }
+}
+
+template<class RDT, class LBT>
+void
+NDListRequestHandlerModel<RDT, LBT>::get_info(opmonlib::InfoCollector& ci, int level)
+{
+  ndreadoutinfo::RequestHandlerCleanupInfo info;
+  info.cleanup_passes = m_cleanup_passes.exchange(0);
+  info.budget_exhausted_passes = m_budget_exhausted_passes.exchange(0);
+  info.entries_evicted = m_entries_evicted.exchange(0);
+  info.bytes_freed = m_bytes_freed.exchange(0);
+  info.cleanup_time_us = m_cleanup_time_us.exchange(0);
+  info.max_cleanup_time_us = m_max_cleanup_time_us.exchange(0);
+  info.reclaim_pending = m_reclaimer.get_pending();
+  ci.add(info);
+
+  ndreadoutinfo::RequestHandlerFragmentInfo finfo;
+  finfo.fragments = m_fragments.exchange(0);
+  finfo.fragment_pieces = m_fragment_pieces.exchange(0);
+  finfo.buffer_bytes = m_buffer_bytes.exchange(0);
+  finfo.shipped_bytes = m_shipped_bytes.exchange(0);
+  finfo.max_fragment_bytes = m_max_fragment_bytes.exchange(0);
+  ci.add(finfo);
+
+  if constexpr (latency::enabled) {
+    auto insert = inherited::m_latency_buffer->get_insert_latency().take();
+    auto serve = m_serve_latency.take();
+    auto request = m_request_latency.take();
+    ndreadoutinfo::RequestLatencyInfo linfo;
+    linfo.insert_count = insert.count;
+    linfo.insert_mean_ns = insert.mean_ns;
+    linfo.insert_p50_ns = insert.p50_ns;
+    linfo.insert_p99_ns = insert.p99_ns;
+    linfo.insert_p999_ns = insert.p999_ns;
+    linfo.insert_max_ns = insert.max_ns;
+    linfo.serve_count = serve.count;
+    linfo.serve_mean_ns = serve.mean_ns;
+    linfo.serve_p50_ns = serve.p50_ns;
+    linfo.serve_p99_ns = serve.p99_ns;
+    linfo.serve_p999_ns = serve.p999_ns;
+    linfo.serve_max_ns = serve.max_ns;
+    linfo.request_count = request.count;
+    linfo.request_mean_ns = request.mean_ns;
+    linfo.request_p50_ns = request.p50_ns;
+    linfo.request_p99_ns = request.p99_ns;
+    linfo.request_p999_ns = request.p999_ns;
+    linfo.request_max_ns = request.max_ns;
+    ci.add(linfo);
+  }
+
+  inherited::get_info(ci, level);
+}
+
+template<class RDT, class LBT>
+uint64_t // NOLINT(build/unsigned)
+NDListRequestHandlerModel<RDT, LBT>::window_lookup_begin(uint64_t begin_ts) // NOLINT(build/unsigned)
+{
+  // Stays 0 for elements without an end timestamp
+  auto span = inherited::m_latency_buffer->get_max_span();
+  return begin_ts > span ? begin_ts - span : 0;
+}
+
+template<class RDT, class LBT>
+bool
+NDListRequestHandlerModel<RDT, LBT>::overlaps_window(const RDT& element, const FragmentContext& context)
+{
+  if constexpr (has_end_timestamp<RDT>::value) {
+    return element.get_end_timestamp() >= context.begin_ts;
+  }
+  return true;
+}
+
+template<class RDT, class LBT>
+std::size_t
+NDListRequestHandlerModel<RDT, LBT>::add_fragment_pieces(RDT& element, FragmentContext& context)
+{
+  auto size = element.get_payload_size();
+  context.pieces.emplace_back(static_cast<void*>(element.begin()), size);
+  return size;
+}
+
+template<class RDT, class LBT>
+typename NDListRequestHandlerModel<RDT, LBT>::RequestResult
+NDListRequestHandlerModel<RDT, LBT>::data_request(dfmessages::DataRequest dr)
+{
+  uint64_t request_start_ns = latency::enabled ? latency::now_ns() : 0; // NOLINT(build/unsigned)
+  RequestResult rres(ResultCode::kUnknown, dr);
+  auto frag_header = inherited::create_fragment_header(dr);
+  FragmentContext context;
+  // Keeps the pieces valid against a concurrent cleanup until the fragment is built
+  std::shared_ptr<const void> keep_alive;
+
+  uint64_t start_win_ts = dr.request_information.window_begin; // NOLINT(build/unsigned)
+  uint64_t end_win_ts = dr.request_information.window_end;     // NOLINT(build/unsigned)
+  context.begin_ts = start_win_ts;
+  context.end_ts = end_win_ts;
+
+  auto& latency_buffer = inherited::m_latency_buffer;
+  // Keys only: the oldest entry may be evicted by a concurrent cleanup at any time
+  auto front_ts = latency_buffer->front_timestamp();
+  auto back_ts = latency_buffer->back_timestamp();
+  if (!front_ts || !back_ts) {
+    frag_header.error_bits |= (0x1 << static_cast<size_t>(daqdataformats::FragmentErrorBits::kDataNotFound));
+    rres.result_code = ResultCode::kNotFound;
+    ++inherited::m_num_requests_bad;
+  } else if (end_win_ts > *back_ts) {
+    // The end of the window may still arrive
+    rres.result_code = ResultCode::kNotYet;
+    ++inherited::m_num_requests_delayed;
+  } else if (end_win_ts <= *front_ts) {
+    frag_header.error_bits |= (0x1 << static_cast<size_t>(daqdataformats::FragmentErrorBits::kDataNotFound));
+    rres.result_code = ResultCode::kTooOld;
+    ++inherited::m_num_requests_old_window;
+  } else {
+    if (start_win_ts < *front_ts) {
+      frag_header.error_bits |= (0x1 << static_cast<size_t>(daqdataformats::FragmentErrorBits::kIncomplete));
+    }
+    uint64_t buffer_bytes = 0;  // NOLINT(build/unsigned)
+    uint64_t shipped_bytes = 0; // NOLINT(build/unsigned)
+    auto lookup_begin = window_lookup_begin(start_win_ts);
+    keep_alive = latency_buffer->for_each_in_window(lookup_begin, end_win_ts, [&](RDT& element) {
+      // Entries keyed before the window only count if their data reaches into it
+      if (element.get_first_timestamp() < start_win_ts && !overlaps_window(element, context)) {
+        return;
+      }
+      m_serve_latency.record_since_load(element);
+      auto num_pieces = context.pieces.size();
+      auto bytes = add_fragment_pieces(element, context);
+      if (context.pieces.size() == num_pieces) {
+        return;
+      }
+      shipped_bytes += bytes;
+      buffer_bytes += element.get_buffer_size();
+    });
+    rres.result_code = ResultCode::kFound;
+    ++inherited::m_num_requests_found;
+
+    ++m_fragments;
+    m_fragment_pieces += context.pieces.size();
+    m_buffer_bytes += buffer_bytes;
+    m_shipped_bytes += shipped_bytes;
+    auto max_bytes = m_max_fragment_bytes.load(std::memory_order_relaxed);
+    while (shipped_bytes > max_bytes && !m_max_fragment_bytes.compare_exchange_weak(max_bytes, shipped_bytes)) {
+    }
+  }
+
+  rres.fragment = std::make_unique<daqdataformats::Fragment>(context.pieces);
+  rres.fragment->set_header_fields(frag_header);
+  if constexpr (latency::enabled) {
+    m_request_latency.record(latency::now_ns() - request_start_ns);
+  }
+  return rres;
+}
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
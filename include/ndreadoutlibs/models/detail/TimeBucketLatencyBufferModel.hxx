@@ -0,0 +1,393 @@
+// Declarations for TimeBucketLatencyBufferModel
+
+#include <algorithm>
+#include <new>
+#include <string>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+template<class T>
+TimeBucketLatencyBufferModel<T>::Bucket::~Bucket()
+{
+  auto num = m_size.load(std::memory_order_acquire);
+  for (std::size_t pos = 0; pos < num; ++pos) {
+    at(pos).~T();
+  }
+  for (auto& chunk : m_chunks) {
+    ::operator delete(chunk.load(std::memory_order_relaxed));
+  }
+}
+
+template<class T>
+std::pair<std::size_t, std::size_t>
+TimeBucketLatencyBufferModel<T>::Bucket::locate(std::size_t pos)
+{
+  // Chunk k starts at base * (2^k - 1) and holds base * 2^k elements
+  std::size_t chunk = 63 - __builtin_clzll(pos / base_chunk_entries + 1);
+  return { chunk, pos - base_chunk_entries * ((std::size_t(1) << chunk) - 1) };
+}
+
+template<class T>
+void
+TimeBucketLatencyBufferModel<T>::Bucket::append(T&& element)
+{
+  auto pos = m_size.load(std::memory_order_relaxed);
+  auto loc = locate(pos);
+  T* chunk = m_chunks[loc.first].load(std::memory_order_relaxed);
+  if (chunk == nullptr) {
+    chunk = static_cast<T*>(::operator new(sizeof(T) * (base_chunk_entries << loc.first)));
+    m_chunks[loc.first].store(chunk, std::memory_order_release);
+  }
+  timestamp_t ts = element.get_first_timestamp();
+  m_bytes.store(m_bytes.load(std::memory_order_relaxed) + element.get_buffer_size(), std::memory_order_relaxed);
+  new (chunk + loc.second) T(std::move(element));
+  if (pos > 0 && ts < m_last_ts) {
+    m_sorted.store(false, std::memory_order_release);
+  }
+  m_last_ts = std::max(m_last_ts, ts);
+  m_size.store(pos + 1, std::memory_order_release);
+}
+
+template<class T>
+T&
+TimeBucketLatencyBufferModel<T>::Bucket::at(std::size_t pos) const
+{
+  auto loc = locate(pos);
+  return m_chunks[loc.first].load(std::memory_order_acquire)[loc.second];
+}
+
+template<class T>
+std::size_t
+TimeBucketLatencyBufferModel<T>::Bucket::lower_bound(timestamp_t ts) const
+{
+  std::size_t lo = first();
+  std::size_t hi = size();
+  // An unsorted bucket is scanned from its first element
+  if (!sorted()) {
+    return lo;
+  }
+  while (lo < hi) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    if (at(mid).get_first_timestamp() < ts) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+template<class T>
+TimeBucketLatencyBufferModel<T>::BucketIterator::BucketIterator(SnapshotPtr snapshot, std::size_t bucket, std::size_t pos)
+  : m_snapshot(std::move(snapshot))
+  , m_bucket(bucket)
+  , m_pos(pos)
+{
+  skip_empty();
+}
+
+template<class T>
+typename TimeBucketLatencyBufferModel<T>::BucketIterator&
+TimeBucketLatencyBufferModel<T>::BucketIterator::operator++()
+{
+  ++m_pos;
+  skip_empty();
+  return *this;
+}
+
+template<class T>
+void
+TimeBucketLatencyBufferModel<T>::BucketIterator::skip_empty()
+{
+  while (m_bucket < m_snapshot->size() && m_pos >= (*m_snapshot)[m_bucket]->size()) {
+    ++m_bucket;
+    m_pos = m_bucket < m_snapshot->size() ? (*m_snapshot)[m_bucket]->first() : 0;
+  }
+}
+
+template<class T>
+void
+TimeBucketLatencyBufferModel<T>::conf(const nlohmann::json& cfg)
+{
+  if (cfg.contains("ndreadoutconf")) {
+    auto ndconf = cfg["ndreadoutconf"].get<ndreadoutconfig::Conf>();
+    if (ndconf.bucket_width_ticks == 0) {
+      throw ConfigurationError(ERS_HERE, "bucket_width_ticks must be non-zero");
+    }
+    m_bucket_width = ndconf.bucket_width_ticks;
+  }
+  TLOG_DEBUG(readoutlibs::logging::TLVL_WORK_STEPS) << "Time bucket latency buffer width: " << m_bucket_width << " ticks";
+}
+
+template<class T>
+typename TimeBucketLatencyBufferModel<T>::Bucket*
+TimeBucketLatencyBufferModel<T>::find_or_create(timestamp_t ts)
+{
+  timestamp_t index = ts / m_bucket_width;
+  const Snapshot& buckets = *m_snapshot;
+  auto pos = first_bucket_from(buckets, index);
+  if (pos < buckets.size() && buckets[pos]->index() == index) {
+    return buckets[pos].get();
+  }
+  Snapshot updated;
+  updated.reserve(buckets.size() + 1);
+  updated.insert(updated.end(), buckets.begin(), buckets.begin() + pos);
+  auto bucket = std::make_shared<Bucket>(index, m_bucket_width);
+  updated.push_back(bucket);
+  updated.insert(updated.end(), buckets.begin() + pos, buckets.end());
+  publish(std::move(updated));
+  return bucket.get();
+}
+
+template<class T>
+std::size_t
+TimeBucketLatencyBufferModel<T>::first_bucket_from(const Snapshot& buckets, timestamp_t index)
+{
+  return std::lower_bound(buckets.begin(),
+                          buckets.end(),
+                          index,
+                          [](const BucketPtr& bucket, timestamp_t idx) { return bucket->index() < idx; }) -
+         buckets.begin();
+}
+
+template<class T>
+bool
+TimeBucketLatencyBufferModel<T>::write(T&& new_element)
+{
+  timestamp_t ts = new_element.get_first_timestamp();
+  Bucket* bucket = m_write_bucket.load(std::memory_order_relaxed);
+  if (bucket != nullptr && bucket->contains(ts)) {
+    bucket->append(std::move(new_element));
+  } else {
+    // New or late bucket: append under the lock, so that cleanup cannot retire it meanwhile
+    std::lock_guard<std::mutex> lk(m_mutex);
+    bucket = find_or_create(ts);
+    bucket->append(std::move(new_element));
+    if (bucket == m_snapshot->back().get()) {
+      m_write_bucket.store(bucket, std::memory_order_relaxed);
+    }
+  }
+  m_occupancy.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+template<class T>
+bool
+TimeBucketLatencyBufferModel<T>::put(T& new_element)
+{
+  T element_copy(new_element);
+  return write(std::move(element_copy));
+}
+
+template<class T>
+bool
+TimeBucketLatencyBufferModel<T>::read(T& element)
+{
+  auto snapshot = get_snapshot();
+  auto first = front_of(*snapshot);
+  if (first == nullptr) {
+    return false;
+  }
+  element = *first;
+  pop(1);
+  return true;
+}
+
+template<class T>
+typename TimeBucketLatencyBufferModel<T>::Iterator
+TimeBucketLatencyBufferModel<T>::begin()
+{
+  auto snapshot = get_snapshot();
+  std::size_t first = snapshot->empty() ? 0 : snapshot->front()->first();
+  return Iterator(std::move(snapshot), 0, first);
+}
+
+template<class T>
+typename TimeBucketLatencyBufferModel<T>::Iterator
+TimeBucketLatencyBufferModel<T>::end()
+{
+  auto snapshot = get_snapshot();
+  std::size_t num = snapshot->size();
+  return Iterator(std::move(snapshot), num, 0);
+}
+
+template<class T>
+typename TimeBucketLatencyBufferModel<T>::Iterator
+TimeBucketLatencyBufferModel<T>::lower_bound(T& element, bool /*with_errors*/)
+{
+  timestamp_t ts = element.get_first_timestamp();
+  auto snapshot = get_snapshot();
+  auto pos = first_bucket_from(*snapshot, ts / m_bucket_width);
+  if (pos == snapshot->size()) {
+    return Iterator(std::move(snapshot), pos, 0);
+  }
+  const auto& bucket = (*snapshot)[pos];
+  std::size_t first = bucket->contains(ts) ? bucket->lower_bound(ts) : bucket->first();
+  return Iterator(std::move(snapshot), pos, first);
+}
+
+template<class T>
+const T*
+TimeBucketLatencyBufferModel<T>::front_of(const Snapshot& buckets)
+{
+  for (const auto& bucket : buckets) {
+    if (bucket->visible() > 0) {
+      return &bucket->at(bucket->first());
+    }
+  }
+  return nullptr;
+}
+
+template<class T>
+const T*
+TimeBucketLatencyBufferModel<T>::back_of(const Snapshot& buckets)
+{
+  for (auto it = buckets.rbegin(); it != buckets.rend(); ++it) {
+    if ((*it)->visible() > 0) {
+      return &(*it)->at((*it)->size() - 1);
+    }
+  }
+  return nullptr;
+}
+
+template<class T>
+const T*
+TimeBucketLatencyBufferModel<T>::front()
+{
+  return front_of(*get_snapshot());
+}
+
+template<class T>
+const T*
+TimeBucketLatencyBufferModel<T>::back()
+{
+  return back_of(*get_snapshot());
+}
+
+template<class T>
+std::optional<typename TimeBucketLatencyBufferModel<T>::timestamp_t>
+TimeBucketLatencyBufferModel<T>::front_timestamp() const
+{
+  auto snapshot = get_snapshot();
+  auto first = front_of(*snapshot);
+  return first == nullptr ? std::nullopt : std::optional<timestamp_t>(first->get_first_timestamp());
+}
+
+template<class T>
+std::optional<typename TimeBucketLatencyBufferModel<T>::timestamp_t>
+TimeBucketLatencyBufferModel<T>::back_timestamp() const
+{
+  auto snapshot = get_snapshot();
+  auto last = back_of(*snapshot);
+  return last == nullptr ? std::nullopt : std::optional<timestamp_t>(last->get_first_timestamp());
+}
+
+template<class T>
+void
+TimeBucketLatencyBufferModel<T>::pop(std::size_t num) // NOLINT(build/unsigned)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  const Snapshot& buckets = *m_snapshot;
+  Bucket* write_bucket = m_write_bucket.load(std::memory_order_relaxed);
+  Snapshot kept;
+  kept.reserve(buckets.size());
+  std::size_t removed = 0;
+  for (const auto& bucket : buckets) {
+    std::size_t visible = removed < num ? bucket->visible() : 0;
+    if (visible > 0 && visible <= num - removed && bucket.get() != write_bucket) {
+      // Whole bucket popped
+      removed += visible;
+      continue;
+    }
+    if (visible > 0) {
+      // Partial pop, or the bucket the writer keeps appending to: hide the front elements
+      std::size_t hide = std::min(visible, num - removed);
+      bucket->m_popped.fetch_add(hide, std::memory_order_release);
+      removed += hide;
+    }
+    kept.push_back(bucket);
+  }
+  if (kept.size() != buckets.size()) {
+    publish(std::move(kept));
+  }
+  m_occupancy.fetch_sub(removed, std::memory_order_relaxed);
+}
+
+template<class T>
+LatencyBufferEviction
+TimeBucketLatencyBufferModel<T>::pop_until(timestamp_t ts, std::size_t max_num, Snapshot* retired)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  const Snapshot& buckets = *m_snapshot;
+  Bucket* write_bucket = m_write_bucket.load(std::memory_order_relaxed);
+  LatencyBufferEviction eviction;
+  std::size_t num_retired = 0;
+  while (num_retired < buckets.size() && eviction.entries < max_num && buckets[num_retired]->end_ts() <= ts) {
+    const auto& bucket = buckets[num_retired];
+    if (bucket.get() == write_bucket) {
+      std::size_t hide = std::min(bucket->visible(), max_num - eviction.entries);
+      bucket->m_popped.fetch_add(hide, std::memory_order_release);
+      eviction.entries += hide;
+      break;
+    }
+    eviction.entries += bucket->visible();
+    eviction.bytes += bucket->buffer_bytes();
+    ++num_retired;
+  }
+  if (num_retired > 0) {
+    if (retired != nullptr) {
+      retired->insert(retired->end(), buckets.begin(), buckets.begin() + num_retired);
+    }
+    publish(Snapshot(buckets.begin() + num_retired, buckets.end()));
+  }
+  m_occupancy.fetch_sub(eviction.entries, std::memory_order_relaxed);
+  return eviction;
+}
+
+template<class T>
+void
+TimeBucketLatencyBufferModel<T>::flush()
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  publish(Snapshot());
+  m_write_bucket.store(nullptr, std::memory_order_relaxed);
+  m_occupancy.store(0, std::memory_order_relaxed);
+}
+
+template<class T>
+template<class Fn>
+std::shared_ptr<const void>
+TimeBucketLatencyBufferModel<T>::for_each_in_window(timestamp_t begin_ts, timestamp_t end_ts, Fn&& fn)
+{
+  auto snapshot = get_snapshot();
+  if (begin_ts >= end_ts) {
+    return snapshot;
+  }
+  for (auto pos = first_bucket_from(*snapshot, begin_ts / m_bucket_width);
+       pos < snapshot->size() && (*snapshot)[pos]->begin_ts() < end_ts;
+       ++pos) {
+    const auto& bucket = (*snapshot)[pos];
+    // Size before the sorted flag: elements published up to this size are covered by the flag read
+    std::size_t size = bucket->size();
+    bool sorted = bucket->sorted();
+    std::size_t first = (sorted && bucket->contains(begin_ts)) ? bucket->lower_bound(begin_ts) : bucket->first();
+    for (std::size_t i = first; i < size; ++i) {
+      T& element = bucket->at(i);
+      timestamp_t ts = element.get_first_timestamp();
+      if (ts >= end_ts) {
+        if (sorted) {
+          break;
+        }
+        continue;
+      }
+      if (ts >= begin_ts) {
+        fn(element);
+      }
+    }
+  }
+  return snapshot;
+}
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
@@ -12,10 +12,20 @@
 #include "readoutlibs/models/TaskRawDataProcessorModel.hpp"
 
 #include "nddetdataformats/MPDFrame.hpp"
+#include "daqdataformats/Types.hpp"
 #include "logging/Logging.hpp"
+#include "ndreadoutlibs/NDReadoutIssues.hpp"
+#include "ndreadoutlibs/NDReadoutMPDInlineTypeAdapter.hpp"
 #include "ndreadoutlibs/NDReadoutMPDTypeAdapter.hpp"
+#include "ndreadoutlibs/mpd/MPDMessageFormat.hpp"
+#include "ndreadoutlibs/ndreadoutconfig/Nljs.hpp"
+#include "ndreadoutlibs/ndreadoutinfo/InfoNljs.hpp"
+#include "ndreadoutlibs/utils/CompressedRecorder.hpp"
+#include "ndreadoutlibs/utils/LatencyStamps.hpp"
+#include "ndreadoutlibs/utils/TimestampContinuityChecker.hpp"
 #include "readoutlibs/ReadoutLogging.hpp"
 
+#include <array>
 #include <atomic>
 #include <functional>
 #include <memory>
@@ -26,43 +36,96 @@ using dunedaq::readoutlibs::logging::TLVL_BOOKKEEPING;
 namespace dunedaq {
 namespace ndreadoutlibs {
 
-class MPDFrameProcessor : public readoutlibs::TaskRawDataProcessorModel<types::NDReadoutMPDTypeAdapter>
+/**
+ * MPD frame checks, for the pooled (NDReadoutMPDTypeAdapter) and the inline
+ * (NDReadoutMPDInlineTypeAdapter) frame storage.
+ * */
+template<class ReadoutType>
+class MPDFrameProcessorModel : public readoutlibs::TaskRawDataProcessorModel<ReadoutType>
 {
 public:
-  using inherited = readoutlibs::TaskRawDataProcessorModel<types::NDReadoutMPDTypeAdapter>;
-  using frameptr = types::NDReadoutMPDTypeAdapter*;
+  using inherited = readoutlibs::TaskRawDataProcessorModel<ReadoutType>;
+  using frameptr = ReadoutType*;
+  using constframeptr = const ReadoutType*;
   using mpdframeptr = dunedaq::nddetdataformats::MPDFrame*;
   using timestamp_t = std::uint64_t; // NOLINT(build/unsigned)
 
-  explicit MPDFrameProcessor(std::unique_ptr<readoutlibs::FrameErrorRegistry>& error_registry)
-    : readoutlibs::TaskRawDataProcessorModel<types::NDReadoutMPDTypeAdapter>(error_registry)
+  explicit MPDFrameProcessorModel(std::unique_ptr<readoutlibs::FrameErrorRegistry>& error_registry)
+    : readoutlibs::TaskRawDataProcessorModel<ReadoutType>(error_registry)
   {}
 
   // Custom pipeline registration
   void conf(const nlohmann::json& args) override; 
+  void start(const nlohmann::json& args) override;
+  void stop(const nlohmann::json& args) override;
+
+  void get_info(opmonlib::InfoCollector& ci, int level) override;
+
+  // Failures recorded into the FrameErrorRegistry, under the names in error_names
+  enum FrameError
+  {
+    kTruncated = 0,
+    kSyncError,
+    kLengthError,
+    kZeroTimestamp,
+    kTimestampRegression,
+    kDuplicateTimestamp,
+    kNumFrameErrors
+  };
+  static const constexpr std::array<const char*, kNumFrameErrors> error_names = {
+    "MPDTruncated", "MPDSync", "MPDLength", "MPDZeroTs", "MPDTsRegression", "MPDTsDuplicate"
+  };
 
 protected:
   // Internals
   timestamp_t m_previous_ts = 0;
   timestamp_t m_current_ts = 0;
+  timestamp_t m_emulator_ts_step = 2500;
   bool m_first_ts_fake = true;
   bool m_first_ts_missmatch = true;
   bool m_problem_reported = false;
   std::atomic<int> m_ts_error_ctr{ 0 };
+  TimestampContinuityChecker<ReadoutType> m_continuity;
 
   /**
    * Pipeline Stage 1.: Check proper timestamp increments in MPD frame
    * */
   void timestamp_check(frameptr fp) ;
   /**
-   * Pipeline Stage 2.: Check headers for error flags
+   * Pipeline Stage 2.: Check frame size and device header against the expected MPD format
    * */
-  void frame_error_check(frameptr /*fp*/) ;
+  void frame_error_check(frameptr fp) ;
+  /**
+   * Last stage with NDREADOUTLIBS_LATENCY_STAMPS: time since load_message()
+   * */
+  void preprocess_done(frameptr fp);
+
+  /**
+   * Post-processing stage: record the frame bytes
+   * */
+  void record_message(constframeptr fp);
 
 private:
+  // Count the error and mark the frame in the error registry, no logging on this path
+  void record_error(FrameError error, timestamp_t ts);
+
   uint64_t m_clock_frequency; // NOLINT(build/unsigned)
+  bool m_frame_check_enabled = true;
+  uint32_t m_sync_word = mpd::default_sync_word; // NOLINT(build/unsigned)
+  bool m_frame_has_error = false;
+  bool m_recording_enabled = false;
+  CompressedRecorder m_recorder;
+  latency::LogLinearHistogram m_preprocess_latency;
+
+  // Data quality counters, reset at every get_info
+  std::atomic<uint64_t> m_frames_checked{ 0 };     // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_frames_with_errors{ 0 }; // NOLINT(build/unsigned)
+  std::array<std::atomic<uint64_t>, kNumFrameErrors> m_error_counters{}; // NOLINT(build/unsigned)
 };
 
+using MPDFrameProcessor = MPDFrameProcessorModel<types::NDReadoutMPDTypeAdapter>;
+using MPDInlineFrameProcessor = MPDFrameProcessorModel<types::NDReadoutMPDInlineTypeAdapter>;
+
 } // namespace ndreadoutlibs
 } // namespace dunedaq
 
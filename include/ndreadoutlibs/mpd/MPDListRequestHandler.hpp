@@ -15,7 +15,10 @@
 
 #include "nddetdataformats/MPDFrame.hpp"
 #include "logging/Logging.hpp"
+#include "ndreadoutlibs/NDReadoutMPDInlineTypeAdapter.hpp"
 #include "ndreadoutlibs/NDReadoutMPDTypeAdapter.hpp"
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/models/NDListRequestHandlerModel.hpp"
 #include "readoutlibs/ReadoutLogging.hpp"
 
 #include <atomic>
@@ -35,26 +38,31 @@ namespace dunedaq {
 namespace ndreadoutlibs {
   
 class MPDListRequestHandler
-  : public readoutlibs::DefaultRequestHandlerModel<types::NDReadoutMPDTypeAdapter, readoutlibs::SkipListLatencyBufferModel<types::NDReadoutMPDTypeAdapter>>
+  : public NDListRequestHandlerModel<types::NDReadoutMPDTypeAdapter,
+                                     NDLatencyBufferModel<types::NDReadoutMPDTypeAdapter>>
 {
 public:
   using inherited =
-    readoutlibs::DefaultRequestHandlerModel<types::NDReadoutMPDTypeAdapter, readoutlibs::SkipListLatencyBufferModel<types::NDReadoutMPDTypeAdapter>>;
+    NDListRequestHandlerModel<types::NDReadoutMPDTypeAdapter, NDLatencyBufferModel<types::NDReadoutMPDTypeAdapter>>;
   using SkipListAcc = typename folly::ConcurrentSkipList<types::NDReadoutMPDTypeAdapter>::Accessor;
   using SkipListSkip = typename folly::ConcurrentSkipList<types::NDReadoutMPDTypeAdapter>::Skipper;
 
   MPDListRequestHandler(
-    std::unique_ptr<readoutlibs::SkipListLatencyBufferModel<types::NDReadoutMPDTypeAdapter>>& latency_buffer,
+    std::unique_ptr<NDLatencyBufferModel<types::NDReadoutMPDTypeAdapter>>& latency_buffer,
     std::unique_ptr<readoutlibs::FrameErrorRegistry>& error_registry)
-    : DefaultRequestHandlerModel<types::NDReadoutMPDTypeAdapter, readoutlibs::SkipListLatencyBufferModel<types::NDReadoutMPDTypeAdapter>>(latency_buffer, error_registry)
+    : inherited(latency_buffer, error_registry)
   {
-    TLOG_DEBUG(TLVL_WORK_STEPS) << "MPDistRequestHandler created...";
+    TLOG_DEBUG(TLVL_WORK_STEPS) << "MPDListRequestHandler created...";
   }
 
 protected:
 private:
 };
 
+// Request handling on MPD frames stored inline in the latency buffer entries
+using MPDInlineListRequestHandler =
+  NDListRequestHandlerModel<types::NDReadoutMPDInlineTypeAdapter, NDLatencyBufferModel<types::NDReadoutMPDInlineTypeAdapter>>;
+
 } // namespace ndreadoutlibs
 } // namespace dunedaq
 
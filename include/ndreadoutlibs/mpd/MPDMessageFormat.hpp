@@ -0,0 +1,68 @@
+/**
+ * @file MPDMessageFormat.hpp Raw layout of the MPD (MStream) device header
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MPD_MPDMESSAGEFORMAT_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MPD_MPDMESSAGEFORMAT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace mpd {
+
+/**
+ * Every MPD frame starts with the MStream device header: a 32 bit sync word, then a
+ * 32 bit word holding the length in bytes of the data following the device header
+ * (24 LSBs) and the device id (8 MSBs). Checks work on these offsets so that they
+ * do not depend on the rest of nddetdataformats::MPDFrame.
+ * */
+const constexpr std::size_t device_header_size = 8;
+const constexpr std::size_t sync_offset = 0;
+const constexpr std::size_t length_offset = 4;
+const constexpr uint32_t length_mask = 0xffffff; // NOLINT(build/unsigned)
+const constexpr unsigned device_id_shift = 24;
+
+const constexpr uint32_t default_sync_word = 0x2A502A50; // NOLINT(build/unsigned)
+
+// Sample bytes after the MPDFrame header kept inline by NDReadoutMPDInlineTypeAdapter:
+// 64 channels of 32 samples of 16 bits
+const constexpr std::size_t max_inline_sample_bytes = 64 * 32 * 2;
+
+inline uint32_t // NOLINT(build/unsigned)
+load_word(const char* frame, std::size_t offset)
+{
+  uint32_t word; // NOLINT(build/unsigned)
+  std::memcpy(&word, frame + offset, sizeof(word));
+  return word;
+}
+
+inline uint32_t // NOLINT(build/unsigned)
+load_sync_word(const char* frame)
+{
+  return load_word(frame, sync_offset);
+}
+
+// Frame size declared by the device header, device header included
+inline std::size_t
+declared_frame_size(const char* frame)
+{
+  return device_header_size + (load_word(frame, length_offset) & length_mask);
+}
+
+inline uint8_t // NOLINT(build/unsigned)
+load_device_id(const char* frame)
+{
+  return load_word(frame, length_offset) >> device_id_shift;
+}
+
+} // namespace mpd
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_MPD_MPDMESSAGEFORMAT_HPP_
@@ -3,36 +3,137 @@
 namespace dunedaq {
 namespace ndreadoutlibs {
 
-void 
-MPDFrameProcessor::conf(const nlohmann::json& args)
+template<class ReadoutType>
+void
+MPDFrameProcessorModel<ReadoutType>::conf(const nlohmann::json& args)
 {
   auto config = args["rawdataprocessorconf"].get<readoutlibs::readoutconfig::RawDataProcessorConf>();
   m_clock_frequency = config.clock_speed_hz;
 
-  readoutlibs::TaskRawDataProcessorModel<types::NDReadoutMPDTypeAdapter>::add_preprocess_task(
-    std::bind(&MPDFrameProcessor::timestamp_check, this, std::placeholders::_1));
-  // m_tasklist.push_back( std::bind(&MPDFrameProcessor::frame_error_check, this, std::placeholders::_1) );
-  TaskRawDataProcessorModel<types::NDReadoutMPDTypeAdapter>::conf(args);
+  if (args.contains("ndreadoutconf")) {
+    auto ndconf = args["ndreadoutconf"].get<ndreadoutconfig::Conf>();
+    m_frame_check_enabled = ndconf.mpd_frame_check;
+    m_sync_word = ndconf.mpd_sync_word;
+    m_continuity.set_gap_threshold(ndconf.timestamp_gap_threshold);
+    m_emulator_ts_step = ndconf.emulator_timestamp_step_ticks;
+    latency::set_sample_period(ndconf.latency_sample_period);
+    m_recording_enabled = !ndconf.record_output_file.empty();
+    if (m_recording_enabled) {
+      m_recorder.conf(ndconf.record_output_file,
+                      ndconf.record_compression,
+                      ndconf.record_compression_level,
+                      ndconf.record_block_size);
+    }
+  }
+
+  readoutlibs::TaskRawDataProcessorModel<ReadoutType>::add_preprocess_task(
+    std::bind(&MPDFrameProcessorModel<ReadoutType>::timestamp_check, this, std::placeholders::_1));
+  if (m_frame_check_enabled) {
+    readoutlibs::TaskRawDataProcessorModel<ReadoutType>::add_preprocess_task(
+      std::bind(&MPDFrameProcessorModel<ReadoutType>::frame_error_check, this, std::placeholders::_1));
+  }
+  if constexpr (latency::enabled) {
+    readoutlibs::TaskRawDataProcessorModel<ReadoutType>::add_preprocess_task(
+      std::bind(&MPDFrameProcessorModel<ReadoutType>::preprocess_done, this, std::placeholders::_1));
+  }
+  if (m_recording_enabled) {
+    readoutlibs::TaskRawDataProcessorModel<ReadoutType>::add_postprocess_task(
+      std::bind(&MPDFrameProcessorModel<ReadoutType>::record_message, this, std::placeholders::_1));
+  }
+  inherited::conf(args);
+}
+
+template<class ReadoutType>
+void
+MPDFrameProcessorModel<ReadoutType>::start(const nlohmann::json& args)
+{
+  // The last timestamp of a previous run is no reference for the first one of this run
+  m_continuity.reset_previous();
+  if (m_recording_enabled) {
+    // Each run goes into files of its own, named after the run number
+    m_recorder.start(args.value<daqdataformats::run_number_t>("run", 1));
+  }
+  inherited::start(args);
+}
+
+template<class ReadoutType>
+void
+MPDFrameProcessorModel<ReadoutType>::stop(const nlohmann::json& args)
+{
+  inherited::stop(args);
+  m_recorder.stop();
+}
+
+template<class ReadoutType>
+void
+MPDFrameProcessorModel<ReadoutType>::get_info(opmonlib::InfoCollector& ci, int level)
+{
+  ndreadoutinfo::MPDFrameProcessorInfo info;
+  info.frames_checked = m_frames_checked.exchange(0);
+  info.frames_with_errors = m_frames_with_errors.exchange(0);
+  info.truncated_frames = m_error_counters[kTruncated].exchange(0);
+  info.sync_errors = m_error_counters[kSyncError].exchange(0);
+  info.length_errors = m_error_counters[kLengthError].exchange(0);
+  info.zero_timestamps = m_error_counters[kZeroTimestamp].exchange(0);
+  info.timestamp_regressions = m_error_counters[kTimestampRegression].exchange(0);
+  info.duplicate_timestamps = m_error_counters[kDuplicateTimestamp].exchange(0);
+  ci.add(info);
+  if (m_recording_enabled) {
+    m_recorder.get_info(ci, level);
+  }
+  auto continuity_info = m_continuity.get_info();
+  ci.add(continuity_info);
+  if constexpr (latency::enabled) {
+    auto preprocess = m_preprocess_latency.take();
+    ndreadoutinfo::ProcessingLatencyInfo linfo;
+    linfo.preprocess_count = preprocess.count;
+    linfo.preprocess_mean_ns = preprocess.mean_ns;
+    linfo.preprocess_p50_ns = preprocess.p50_ns;
+    linfo.preprocess_p99_ns = preprocess.p99_ns;
+    linfo.preprocess_p999_ns = preprocess.p999_ns;
+    linfo.preprocess_max_ns = preprocess.max_ns;
+    ci.add(linfo);
+  }
+
+  inherited::get_info(ci, level);
+}
+
+template<class ReadoutType>
+void
+MPDFrameProcessorModel<ReadoutType>::record_error(FrameError error, timestamp_t ts)
+{
+  m_error_counters[error].fetch_add(1, std::memory_order_relaxed);
+  inherited::m_error_registry->add_error(error_names[error], readoutlibs::FrameErrorRegistry::ErrorInterval(ts, ts));
+  m_frame_has_error = true;
 }
 
 /**
- * Pipeline Stage 1.: Check proper timestamp increments in DAPHNE frame
+ * Pipeline Stage 1.: Check proper timestamp increments in MPD frame
  * */
-void 
-MPDFrameProcessor::timestamp_check(frameptr fp)
+template<class ReadoutType>
+void
+MPDFrameProcessorModel<ReadoutType>::timestamp_check(frameptr fp)
 {
-  // If EMU data, emulate perfectly incrementing timestamp
-  if (inherited::m_emulator_mode) { // emulate perfectly incrementing timestamp
-    // FIX ME - add fake timestamp to MPD message struct
+  // If EMU data, keys not above the previous one continue an increasing sequence
+  if (inherited::m_emulator_mode && fp->get_timestamp() <= m_previous_ts) {
+    fp->set_first_timestamp(m_previous_ts + m_emulator_ts_step);
   }
 
   // Acquire timestamp
   m_current_ts = fp->get_timestamp();
-  TLOG_DEBUG(TLVL_FRAME_RECEIVED) << "Received MPD frame timestamp value of " << m_current_ts << " ticks (..." << std::fixed << std::setprecision(8) << (static_cast<double>(m_current_ts % (m_clock_frequency*1000)) / static_cast<double>(m_clock_frequency)) << " sec)"; // NOLINT
+  TLOG_DEBUG(TLVL_FRAME_RECEIVED) << "Received MPD frame timestamp value of " << m_current_ts << " ticks";
 
   // Check timestamp
   // RS warning : not fixed rate!
-  if (m_current_ts - m_previous_ts <= 0) {
+  m_frame_has_error = false;
+  auto result = m_continuity.check(m_current_ts);
+  if (m_current_ts == 0) {
+    record_error(kZeroTimestamp, m_current_ts);
+  } else if (TimestampContinuityChecker<ReadoutType>::is_error(result)) {
+    record_error(result == TimestampContinuityChecker<ReadoutType>::kRegression
+                   ? kTimestampRegression
+                   : kDuplicateTimestamp,
+                 m_current_ts);
     ++m_ts_error_ctr;
     TLOG_DEBUG(TLVL_BOOKKEEPING) << "Timestamp continuity MISSMATCH! -> | previous: " << std::to_string(m_previous_ts)
                                  << " current: " + std::to_string(m_current_ts);
@@ -47,18 +148,48 @@ MPDFrameProcessor::timestamp_check(frameptr fp)
   }
 
   m_previous_ts = m_current_ts;
-  m_last_processed_daq_ts = m_current_ts;
+  inherited::m_last_processed_daq_ts = m_current_ts;
 }
 
 /**
- * Pipeline Stage 2.: Check headers for error flags
+ * Pipeline Stage 2.: Check frame size and device header against the expected MPD format
  * */
-void MPDFrameProcessor::frame_error_check(frameptr /*fp*/)
+template<class ReadoutType>
+void
+MPDFrameProcessorModel<ReadoutType>::frame_error_check(frameptr fp)
 {
-  // check error fields
-  // FIX ME - to be implemented
+  m_frames_checked.fetch_add(1, std::memory_order_relaxed);
+  // The received size, as get_message_size() is itself derived from the device header
+  auto size = fp->get_received_size();
+  if (size < sizeof(dunedaq::nddetdataformats::MPDFrame)) {
+    record_error(kTruncated, m_current_ts);
+  } else {
+    const char* frame = fp->message_data();
+    if (m_sync_word != 0 && mpd::load_sync_word(frame) != m_sync_word) {
+      record_error(kSyncError, m_current_ts);
+    }
+    if (mpd::declared_frame_size(frame) != size) {
+      record_error(kLengthError, m_current_ts);
+    }
+  }
+  // Includes the timestamp errors found by stage 1 for this frame
+  if (m_frame_has_error) {
+    m_frames_with_errors.fetch_add(1, std::memory_order_relaxed);
+  }
+}
 
-  // fp->inspect_message();
+template<class ReadoutType>
+void
+MPDFrameProcessorModel<ReadoutType>::preprocess_done(frameptr fp)
+{
+  m_preprocess_latency.record_since_load(*fp);
+}
+
+template<class ReadoutType>
+void
+MPDFrameProcessorModel<ReadoutType>::record_message(constframeptr fp)
+{
+  m_recorder.record(fp->message_data(), fp->get_message_size(), fp->get_first_timestamp());
 }
 
 } // namespace ndreadoutlibs
@@ -0,0 +1,98 @@
+/**
+ * @file LArPixHitExtractor.hpp Extraction of LArPix hits from PACMAN messages
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_LARPIXHITEXTRACTOR_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_LARPIXHITEXTRACTOR_HPP_
+
+#include "ndreadoutlibs/pacman/PACMANMessageFormat.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace pacman {
+
+/**
+ * Hits of one PACMAN message, packed as a struct of arrays in a single allocation: the
+ * timestamps followed by the chip id, channel id, I/O channel and ADC byte arrays. Entry i
+ * of every array belongs to hit i. Hit timestamps are in DAQ ticks, from the message unix
+ * time and the LArPix packet timestamp.
+ * */
+class LArPixHits
+{
+public:
+  uint64_t message_timestamp = 0; // NOLINT(build/unsigned) latency buffer key of the message
+
+  // Drop all hits and make room for capacity hits
+  void reset(std::size_t capacity);
+  // Keep the first num_hits hits and move the byte arrays behind them
+  void shrink(std::size_t num_hits);
+
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  // Bytes of the packed arrays
+  std::size_t packed_size() const { return m_size * (sizeof(uint64_t) + 4); } // NOLINT(build/unsigned)
+
+  uint64_t* timestamp() { return m_storage.get(); }                                   // NOLINT(build/unsigned)
+  const uint64_t* timestamp() const { return m_storage.get(); }                       // NOLINT(build/unsigned)
+  uint8_t* chip_id() { return byte_array(0); }                                        // NOLINT(build/unsigned)
+  const uint8_t* chip_id() const { return const_cast<LArPixHits*>(this)->byte_array(0); }    // NOLINT
+  uint8_t* channel_id() { return byte_array(1); }                                     // NOLINT(build/unsigned)
+  const uint8_t* channel_id() const { return const_cast<LArPixHits*>(this)->byte_array(1); } // NOLINT
+  uint8_t* io_channel() { return byte_array(2); }                                     // NOLINT(build/unsigned)
+  const uint8_t* io_channel() const { return const_cast<LArPixHits*>(this)->byte_array(2); } // NOLINT
+  uint8_t* adc() { return byte_array(3); }                                            // NOLINT(build/unsigned)
+  const uint8_t* adc() const { return const_cast<LArPixHits*>(this)->byte_array(3); }        // NOLINT
+
+private:
+  // The byte arrays are laid out for m_stride hits
+  uint8_t* byte_array(std::size_t index) // NOLINT(build/unsigned)
+  {
+    return reinterpret_cast<uint8_t*>(m_storage.get() + m_stride) + index * m_stride; // NOLINT
+  }
+
+  std::unique_ptr<uint64_t[]> m_storage; // NOLINT(build/unsigned, modernize-avoid-c-arrays)
+  std::size_t m_size = 0;
+  std::size_t m_stride = 0;
+};
+
+/**
+ * Decodes the LArPix data packets carried in PACMAN data words. Words of other types,
+ * packets of other types and packets failing the parity check are skipped, as in
+ * PACMANWordDecoder.
+ * */
+class LArPixHitExtractor
+{
+public:
+  LArPixHitExtractor() = default;
+  LArPixHitExtractor(uint64_t clock_frequency, uint64_t subsecond_clock_frequency); // NOLINT(build/unsigned)
+
+  // Replace the content of hits by the hits of the message (header included) of the given size
+  std::size_t extract(const char* msg, std::size_t size, LArPixHits& hits) const;
+  // Same for num_words words of a message sent at unix_ts, without the message header
+  std::size_t extract_words(const char* words,
+                            std::size_t num_words,
+                            uint32_t unix_ts, // NOLINT(build/unsigned)
+                            LArPixHits& hits) const;
+
+private:
+  uint64_t m_clock_frequency = 50000000;          // NOLINT(build/unsigned)
+  uint64_t m_subsecond_clock_frequency = 50000000; // NOLINT(build/unsigned)
+  // Ticks per sub-second count when the clocks divide evenly, 0 otherwise
+  uint64_t m_ticks_per_count = 1; // NOLINT(build/unsigned)
+};
+
+} // namespace pacman
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+// Declarations
+#include "detail/LArPixHitExtractor.hxx"
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_LARPIXHITEXTRACTOR_HPP_
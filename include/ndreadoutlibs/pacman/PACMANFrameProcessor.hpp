@@ -12,14 +12,28 @@
 #include "readoutlibs/models/TaskRawDataProcessorModel.hpp"
 
 #include "nddetdataformats/PACMANFrame.hpp"
+#include "daqdataformats/Types.hpp"
 #include "logging/Logging.hpp"
+#include "ndreadoutlibs/NDReadoutIssues.hpp"
 #include "ndreadoutlibs/NDReadoutPACMANTypeAdapter.hpp"
+#include "ndreadoutlibs/ndreadoutconfig/Nljs.hpp"
+#include "ndreadoutlibs/ndreadoutinfo/InfoNljs.hpp"
+#include "ndreadoutlibs/pacman/LArPixHitExtractor.hpp"
+#include "ndreadoutlibs/pacman/PACMANWordDecoder.hpp"
+#include "ndreadoutlibs/utils/PayloadPool.hpp"
+#include "ndreadoutlibs/utils/CompressedRecorder.hpp"
+#include "ndreadoutlibs/utils/LatencyStamps.hpp"
+#include "ndreadoutlibs/utils/SPSCWorkerPool.hpp"
+#include <folly/ProducerConsumerQueue.h>
+#include "ndreadoutlibs/utils/TimestampContinuityChecker.hpp"
 #include "readoutlibs/ReadoutLogging.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 using dunedaq::readoutlibs::logging::TLVL_BOOKKEEPING;
 using dunedaq::readoutlibs::logging::TLVL_FRAME_RECEIVED;
@@ -32,36 +46,182 @@ class PACMANFrameProcessor : public readoutlibs::TaskRawDataProcessorModel<types
 public:
   using inherited = readoutlibs::TaskRawDataProcessorModel<types::NDReadoutPACMANTypeAdapter>;
   using frameptr = types::NDReadoutPACMANTypeAdapter*;
+  using constframeptr = const types::NDReadoutPACMANTypeAdapter*;
   using pacmanframeptr = dunedaq::nddetdataformats::PACMANFrame*;
   using timestamp_t = std::uint64_t; // NOLINT(build/unsigned)
+  // Returns false if it could not take the hits, which are then counted as discarded
+  using HitSink = std::function<bool(pacman::LArPixHits&&)>;
 
   explicit PACMANFrameProcessor(std::unique_ptr<readoutlibs::FrameErrorRegistry>& error_registry)
     : readoutlibs::TaskRawDataProcessorModel<types::NDReadoutPACMANTypeAdapter>(error_registry)
   {}
+  ~PACMANFrameProcessor()
+  {
+    if (m_holds_adapter_config) {
+      types::NDReadoutPACMANTypeAdapter::release_config();
+    }
+  }
 
   // Custom pipeline registration
   void conf(const nlohmann::json& args) override;
+  void scrap(const nlohmann::json& args) override;
+  void start(const nlohmann::json& args) override;
+  void stop(const nlohmann::json& args) override;
+
+  // Output of the hit extraction stage, called from the PACMAN workers concurrently. Must be
+  // installed before start() when pacman_hit_extraction is enabled.
+  void set_hit_sink(HitSink sink) { m_hit_sink = std::move(sink); }
+
+  void get_info(opmonlib::InfoCollector& ci, int level) override;
 
 protected:
   // Internals
   timestamp_t m_previous_ts = 0;
   timestamp_t m_current_ts = 0;
+  timestamp_t m_emulator_ts_step = 2500;
   bool m_first_ts_fake = true;
   bool m_first_ts_missmatch = true;
   bool m_problem_reported = false;
   std::atomic<int> m_ts_error_ctr{ 0 };
+  TimestampContinuityChecker<types::NDReadoutPACMANTypeAdapter> m_continuity;
+  // Whether this processor holds the process wide adapter settings, see acquire_config()
+  bool m_holds_adapter_config = false;
 
   /**
-   * Pipeline Stage 1.: Check proper timestamp increments in DAPHNE frame
+   * Pipeline Stage 1.: Check proper timestamp increments in PACMAN messages
    * */
   void timestamp_check(frameptr fp);
 
   /**
-   * Pipeline Stage 2.: Check headers for error flags
+   * Pipeline Stage 2.: Decode all message words, count word types, parity and format errors
+   * */
+  void frame_error_check(frameptr fp);
+
+  /**
+   * Last stage with NDREADOUTLIBS_LATENCY_STAMPS: time since load_message()
+   * */
+  void preprocess_done(frameptr fp);
+
+  /**
+   * Post-processing stage: hand the message words to the PACMAN workers
+   * */
+  void dispatch_words(constframeptr fp);
+
+  /**
+   * Post-processing stage: record the message bytes
    * */
-  void frame_error_check(frameptr /*fp*/);
+  void record_message(constframeptr fp);
+
+  // Word storage handed back and forth between the dispatching thread and one worker
+  struct WordBuffer
+  {
+    std::unique_ptr<char[]> data; // NOLINT(modernize-avoid-c-arrays)
+    std::size_t capacity = 0;
+    void reserve(std::size_t size)
+    {
+      if (size > capacity) {
+        data.reset(new char[size]); // NOLINT(modernize-avoid-c-arrays)
+        capacity = size;
+      }
+    }
+  };
+
+  // Words of one message for one worker, without the message header
+  struct WordJob
+  {
+    WordBuffer words;
+    uint32_t num_words = 0; // NOLINT(build/unsigned)
+    uint32_t unix_ts = 0;   // NOLINT(build/unsigned)
+    timestamp_t timestamp = 0;
+  };
+
+  // PACMAN worker: word check in sharded mode and LArPix hit extraction
+  void process_words(std::size_t worker, WordJob& job);
+
+  // Word check counters of one thread, reset and summed at every get_info
+  struct alignas(64) WordCheckCounters
+  {
+    std::atomic<uint64_t> messages_checked{ 0 };     // NOLINT(build/unsigned)
+    std::atomic<uint64_t> messages_with_errors{ 0 }; // NOLINT(build/unsigned)
+    std::atomic<uint64_t> words_decoded{ 0 };        // NOLINT(build/unsigned)
+    std::atomic<uint64_t> data_words{ 0 };           // NOLINT(build/unsigned)
+    std::atomic<uint64_t> trigger_words{ 0 };        // NOLINT(build/unsigned)
+    std::atomic<uint64_t> sync_words{ 0 };           // NOLINT(build/unsigned)
+    std::atomic<uint64_t> control_words{ 0 };        // NOLINT(build/unsigned)
+    std::atomic<uint64_t> error_words{ 0 };          // NOLINT(build/unsigned)
+    std::atomic<uint64_t> data_packets{ 0 };         // NOLINT(build/unsigned)
+    std::atomic<uint64_t> parity_errors{ 0 };        // NOLINT(build/unsigned)
+    std::atomic<uint64_t> unknown_word_types{ 0 };   // NOLINT(build/unsigned)
+    std::atomic<uint64_t> size_errors{ 0 };          // NOLINT(build/unsigned)
+
+    // Count the words of summary; messages_checked and size_errors are left to the caller
+    void add(const pacman::PACMANMessageSummary& summary);
+    void collect(ndreadoutinfo::PACMANFrameProcessorInfo& info);
+    void reset();
+  };
+
+  // State owned by one PACMAN worker
+  struct alignas(64) Shard
+  {
+    pacman::PACMANMessageSummary summary;
+    WordCheckCounters counters;
+    std::atomic<uint64_t> jobs_processed{ 0 }; // NOLINT(build/unsigned)
+    std::atomic<uint64_t> hits_extracted{ 0 }; // NOLINT(build/unsigned)
+    std::atomic<uint64_t> hits_discarded{ 0 }; // NOLINT(build/unsigned)
+
+    void reset()
+    {
+      counters.reset();
+      jobs_processed.store(0);
+      hits_extracted.store(0);
+      hits_discarded.store(0);
+    }
+  };
+
+  // Summary of the last message seen by frame_error_check
+  pacman::PACMANMessageSummary m_summary;
 
 private:
+  enum class ShardKey
+  {
+    kIOChannel,
+    kChip
+  };
+
+  std::size_t shard_of(const char* word, std::size_t num_shards) const;
+  WordBuffer take_buffer(std::size_t worker, std::size_t size);
+  void dispatch_job(std::size_t worker, WordJob&& job);
+  void report_word_errors(const pacman::PACMANMessageSummary& summary, timestamp_t ts);
+
+  uint64_t m_clock_frequency; // NOLINT(build/unsigned)
+  bool m_word_check_enabled = true;
+  bool m_hit_extraction_enabled = false;
+  bool m_sharded = false;
+  ShardKey m_shard_key = ShardKey::kIOChannel;
+  std::size_t m_worker_threads = 2;
+  std::size_t m_worker_queue_size = 4096;
+  std::vector<int> m_worker_cpus;
+  std::size_t m_next_worker = 0;
+  std::vector<uint32_t> m_shard_word_counts; // NOLINT(build/unsigned)
+  std::vector<char*> m_shard_cursors;
+  std::vector<WordJob> m_shard_jobs;
+  pacman::LArPixHitExtractor m_hit_extractor;
+  HitSink m_hit_sink;
+  std::vector<std::unique_ptr<Shard>> m_shards;
+  // Processed word buffers, returned by each worker for reuse without locking
+  std::vector<std::unique_ptr<folly::ProducerConsumerQueue<WordBuffer>>> m_free_buffers;
+  SPSCWorkerPool<WordJob> m_workers;
+  bool m_recording_enabled = false;
+  CompressedRecorder m_recorder;
+  latency::LogLinearHistogram m_preprocess_latency;
+
+  // Serial word check counters
+  WordCheckCounters m_word_counters;
+
+  // Worker counters, reset at every get_info
+  std::atomic<uint64_t> m_jobs_queued{ 0 };   // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_jobs_dropped{ 0 };  // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_words_dropped{ 0 }; // NOLINT(build/unsigned)
 };
 
 } // namespace ndreadoutlibs
@@ -16,6 +16,11 @@
 #include "nddetdataformats/PACMANFrame.hpp"
 #include "logging/Logging.hpp"
 #include "ndreadoutlibs/NDReadoutPACMANTypeAdapter.hpp"
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/models/NDListRequestHandlerModel.hpp"
+#include "ndreadoutlibs/ndreadoutconfig/Nljs.hpp"
+#include "ndreadoutlibs/ndreadoutinfo/InfoNljs.hpp"
+#include "ndreadoutlibs/pacman/PACMANMessageFormat.hpp"
 #include "readoutlibs/ReadoutLogging.hpp"
 
 #include <atomic>
@@ -34,33 +39,47 @@ using dunedaq::readoutlibs::logging::TLVL_WORK_STEPS;
 namespace dunedaq {
 namespace ndreadoutlibs {
 
+/**
+ * In the "range" PACMAN timestamp mode messages are matched on their earliest to latest
+ * data packet range: entries are keyed by range start, and NDListRequestHandlerModel looks
+ * back by the widest range written to the latency buffer. With pacman_trim_to_window,
+ * messages not fully inside the window are shipped as a copy holding only the data words
+ * inside it (and all other words).
+ * */
 class PACMANListRequestHandler
-  : public readoutlibs::DefaultRequestHandlerModel<
-      types::NDReadoutPACMANTypeAdapter,
-      readoutlibs::SkipListLatencyBufferModel<types::NDReadoutPACMANTypeAdapter>>
+  : public NDListRequestHandlerModel<types::NDReadoutPACMANTypeAdapter,
+                                     NDLatencyBufferModel<types::NDReadoutPACMANTypeAdapter>>
 {
 public:
   using inherited =
-    readoutlibs::DefaultRequestHandlerModel<types::NDReadoutPACMANTypeAdapter,
-                                            readoutlibs::SkipListLatencyBufferModel<types::NDReadoutPACMANTypeAdapter>>;
+    NDListRequestHandlerModel<types::NDReadoutPACMANTypeAdapter, NDLatencyBufferModel<types::NDReadoutPACMANTypeAdapter>>;
   using SkipListAcc = typename folly::ConcurrentSkipList<types::NDReadoutPACMANTypeAdapter>::Accessor;
   using SkipListSkip = typename folly::ConcurrentSkipList<types::NDReadoutPACMANTypeAdapter>::Skipper;
 
   PACMANListRequestHandler(
-    std::unique_ptr<readoutlibs::SkipListLatencyBufferModel<types::NDReadoutPACMANTypeAdapter>>& latency_buffer,
+    std::unique_ptr<NDLatencyBufferModel<types::NDReadoutPACMANTypeAdapter>>& latency_buffer,
     std::unique_ptr<readoutlibs::FrameErrorRegistry>& error_registry)
-    : DefaultRequestHandlerModel<types::NDReadoutPACMANTypeAdapter,
-                                 readoutlibs::SkipListLatencyBufferModel<types::NDReadoutPACMANTypeAdapter>>(latency_buffer,
-													     error_registry)
+    : inherited(latency_buffer, error_registry)
   {
-    TLOG_DEBUG(TLVL_WORK_STEPS) << "PACMANistRequestHandler created...";
+    TLOG_DEBUG(TLVL_WORK_STEPS) << "PACMANListRequestHandler created...";
   }
 
+  void conf(const nlohmann::json& args) override;
+  void get_info(opmonlib::InfoCollector& ci, int level) override;
+
 protected:
+  using FragmentContext = typename inherited::FragmentContext;
+
+  std::size_t add_fragment_pieces(types::NDReadoutPACMANTypeAdapter& element, FragmentContext& context) override;
+
 private:
+  bool m_trim_to_window = false;
 };
 
 } // namespace ndreadoutlibs
 } // namespace dunedaq
 
+// Declarations
+#include "detail/PACMANListRequestHandler.hxx"
+
 #endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_PACMANLISTREQUESTHANDLER_HPP_
@@ -0,0 +1,112 @@
+/**
+ * @file PACMANMessageFormat.hpp Raw layout of PACMAN words and LArPix packets
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_PACMANMESSAGEFORMAT_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_PACMANMESSAGEFORMAT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace pacman {
+
+// The 8 byte message header: type, 32 bit unix timestamp, 1 reserved byte, 16 bit word count
+const constexpr std::size_t header_size = 8;
+const constexpr std::size_t header_unix_ts_offset = 1;
+const constexpr std::size_t header_words_offset = 6;
+const constexpr std::size_t word_size = 16;
+
+/**
+ * A PACMAN word is 16 bytes: word type, I/O channel, 2 reserved bytes, 32 bit receipt
+ * timestamp and the 64 bit LArPix packet. Bulk decoders work on these offsets rather than
+ * on the bitfield structs of nddetdataformats::PACMANFrame.
+ * */
+const constexpr std::size_t word_type_offset = 0;
+const constexpr std::size_t word_channel_offset = 1;
+const constexpr std::size_t word_timestamp_offset = 4;
+const constexpr std::size_t word_packet_offset = 8;
+
+// LArPix v2 packet, bit positions counted from the LSB of the little endian 64 bit word
+const constexpr unsigned packet_type_shift = 0;
+const constexpr uint64_t packet_type_mask = 0x3; // NOLINT(build/unsigned)
+const constexpr unsigned chip_id_shift = 2;
+const constexpr uint64_t chip_id_mask = 0xff; // NOLINT(build/unsigned)
+const constexpr unsigned channel_id_shift = 10;
+const constexpr uint64_t channel_id_mask = 0x3f; // NOLINT(build/unsigned)
+const constexpr unsigned timestamp_shift = 16;
+const constexpr uint64_t timestamp_mask = 0x7fffffff; // NOLINT(build/unsigned)
+const constexpr unsigned adc_shift = 48;
+const constexpr uint64_t adc_mask = 0xff; // NOLINT(build/unsigned)
+const constexpr unsigned parity_shift = 63;
+
+// Word types (ASCII) carried in byte 0 of a PACMAN word
+const constexpr uint8_t data_word_type = 'D';    // NOLINT(build/unsigned)
+const constexpr uint8_t trigger_word_type = 'T'; // NOLINT(build/unsigned)
+const constexpr uint8_t sync_word_type = 'S';    // NOLINT(build/unsigned)
+const constexpr uint8_t ping_word_type = 'P';    // NOLINT(build/unsigned)
+const constexpr uint8_t write_word_type = 'W';   // NOLINT(build/unsigned)
+const constexpr uint8_t read_word_type = 'R';    // NOLINT(build/unsigned)
+const constexpr uint8_t error_word_type = 'E';   // NOLINT(build/unsigned)
+
+inline uint16_t // NOLINT(build/unsigned)
+load_header_words(const char* msg)
+{
+  uint16_t words; // NOLINT(build/unsigned)
+  std::memcpy(&words, msg + header_words_offset, sizeof(words));
+  return words;
+}
+
+inline uint32_t // NOLINT(build/unsigned)
+load_header_unix_ts(const char* msg)
+{
+  uint32_t unix_ts; // NOLINT(build/unsigned)
+  std::memcpy(&unix_ts, msg + header_unix_ts_offset, sizeof(unix_ts));
+  return unix_ts;
+}
+
+inline uint64_t // NOLINT(build/unsigned)
+load_packet(const char* word)
+{
+  uint64_t packet; // NOLINT(build/unsigned)
+  std::memcpy(&packet, word + word_packet_offset, sizeof(packet));
+  return packet;
+}
+
+inline uint32_t // NOLINT(build/unsigned)
+load_receipt_timestamp(const char* word)
+{
+  uint32_t ts; // NOLINT(build/unsigned)
+  std::memcpy(&ts, word + word_timestamp_offset, sizeof(ts));
+  return ts;
+}
+
+// LArPix packets carry odd parity over all 64 bits
+inline bool
+parity_ok(uint64_t packet) // NOLINT(build/unsigned)
+{
+  return (__builtin_popcountll(packet) & 1) == 1;
+}
+
+inline uint64_t // NOLINT(build/unsigned)
+encode_data_packet(uint64_t chip_id, uint64_t channel_id, uint64_t timestamp, uint64_t adc) // NOLINT(build/unsigned)
+{
+  uint64_t packet = ((chip_id & chip_id_mask) << chip_id_shift) | // NOLINT(build/unsigned)
+                    ((channel_id & channel_id_mask) << channel_id_shift) |
+                    ((timestamp & timestamp_mask) << timestamp_shift) | ((adc & adc_mask) << adc_shift);
+  if (!parity_ok(packet)) {
+    packet |= uint64_t(1) << parity_shift; // NOLINT(build/unsigned)
+  }
+  return packet;
+}
+
+} // namespace pacman
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_PACMANMESSAGEFORMAT_HPP_
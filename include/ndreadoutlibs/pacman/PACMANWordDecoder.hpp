@@ -0,0 +1,101 @@
+/**
+ * @file PACMANWordDecoder.hpp Single pass bulk decoder of PACMAN message words
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_PACMANWORDDECODER_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_PACMANWORDDECODER_HPP_
+
+#include "ndreadoutlibs/pacman/PACMANMessageFormat.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// The AVX2 path is compiled for any x86-64 target and selected at run time
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NDREADOUTLIBS_PACMAN_DECODER_AVX2 1
+#endif
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace pacman {
+
+// Histogram bins of the word type byte
+enum WordTypeBin : std::size_t
+{
+  kDataWord = 0,
+  kTriggerWord,
+  kSyncWord,
+  kPingWord,
+  kWriteWord,
+  kReadWord,
+  kErrorWord,
+  kUnknownWord,
+  kNumWordTypeBins
+};
+
+/**
+ * Data quality summary of one PACMAN message.
+ * Hit counts and the packet timestamp range only include LArPix data packets with
+ * correct parity carried in data words.
+ * */
+struct PACMANMessageSummary
+{
+  static const constexpr std::size_t max_io_channels = 256;
+  static const constexpr std::size_t max_chips = 256;
+
+  uint32_t num_words = 0;          // NOLINT(build/unsigned)
+  uint32_t data_packets = 0;       // NOLINT(build/unsigned)
+  uint32_t parity_errors = 0;      // NOLINT(build/unsigned)
+  uint32_t unknown_word_types = 0; // NOLINT(build/unsigned)
+  uint32_t size_errors = 0;        // NOLINT(build/unsigned)
+  uint32_t min_packet_timestamp = std::numeric_limits<uint32_t>::max(); // NOLINT(build/unsigned)
+  uint32_t max_packet_timestamp = 0;                                    // NOLINT(build/unsigned)
+  std::array<uint32_t, kNumWordTypeBins> word_type_counts{};            // NOLINT(build/unsigned)
+  std::array<uint16_t, max_io_channels> io_channel_hits{};              // NOLINT(build/unsigned)
+  std::array<uint16_t, max_chips> chip_hits{};                          // NOLINT(build/unsigned)
+
+  bool has_packets() const { return data_packets > 0; }
+  uint32_t format_errors() const { return unknown_word_types + size_errors; } // NOLINT(build/unsigned)
+  bool has_errors() const { return parity_errors + format_errors() > 0; }
+  void reset() { *this = PACMANMessageSummary(); }
+};
+
+/**
+ * Walks all words of a PACMAN message once. On CPUs with AVX2 four words are validated
+ * per iteration (word type, packet type, parity and timestamp range) and the hit
+ * histograms are filled from the resulting masks. Otherwise a scalar loop does the same work.
+ * */
+class PACMANWordDecoder
+{
+public:
+  // Decode the message (header included) of the given size into summary, which is reset first
+  static void decode(const char* msg, std::size_t size, PACMANMessageSummary& summary);
+
+  // Decode num_words words starting at words, accumulating into summary
+  static void decode_words(const char* words, std::size_t num_words, PACMANMessageSummary& summary);
+  static void decode_words_scalar(const char* words, std::size_t num_words, PACMANMessageSummary& summary);
+#ifdef NDREADOUTLIBS_PACMAN_DECODER_AVX2
+  __attribute__((target("avx2,popcnt,bmi"))) static void decode_words_avx2(const char* words,
+                                                                           std::size_t num_words,
+                                                                           PACMANMessageSummary& summary);
+#endif
+
+  static WordTypeBin word_type_bin(uint8_t type); // NOLINT(build/unsigned)
+
+  // Whether decode() takes the vectorized path on this CPU
+  static bool vectorized();
+};
+
+} // namespace pacman
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+// Declarations
+#include "detail/PACMANWordDecoder.hxx"
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_PACMAN_PACMANWORDDECODER_HPP_
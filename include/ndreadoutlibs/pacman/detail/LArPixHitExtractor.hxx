@@ -0,0 +1,93 @@
+// Declarations for LArPixHitExtractor
+
+#include <algorithm>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace pacman {
+
+inline void
+LArPixHits::reset(std::size_t capacity)
+{
+  // Not zero filled, every hit is written before it is counted
+  m_storage.reset(new uint64_t[capacity + (4 * capacity + sizeof(uint64_t) - 1) / sizeof(uint64_t)]); // NOLINT
+  m_stride = capacity;
+  m_size = 0;
+}
+
+inline void
+LArPixHits::shrink(std::size_t num_hits)
+{
+  num_hits = std::min(num_hits, m_stride);
+  if (num_hits != m_stride) {
+    uint8_t* packed = reinterpret_cast<uint8_t*>(m_storage.get() + num_hits); // NOLINT
+    for (std::size_t i = 0; i < 4; ++i) {
+      std::memmove(packed + i * num_hits, byte_array(i), num_hits);
+    }
+  }
+  m_stride = num_hits;
+  m_size = num_hits;
+}
+
+inline LArPixHitExtractor::LArPixHitExtractor(uint64_t clock_frequency,           // NOLINT(build/unsigned)
+                                              uint64_t subsecond_clock_frequency) // NOLINT(build/unsigned)
+  : m_clock_frequency(clock_frequency)
+  , m_subsecond_clock_frequency(subsecond_clock_frequency)
+  , m_ticks_per_count(clock_frequency % subsecond_clock_frequency == 0 ? clock_frequency / subsecond_clock_frequency
+                                                                       : 0)
+{}
+
+inline std::size_t
+LArPixHitExtractor::extract(const char* msg, std::size_t size, LArPixHits& hits) const
+{
+  if (size < header_size) {
+    hits.reset(0);
+    return 0;
+  }
+  std::size_t num_words = std::min<std::size_t>(load_header_words(msg), (size - header_size) / word_size);
+  return extract_words(msg + header_size, num_words, load_header_unix_ts(msg), hits);
+}
+
+inline std::size_t
+LArPixHitExtractor::extract_words(const char* words,
+                                  std::size_t num_words,
+                                  uint32_t unix_ts, // NOLINT(build/unsigned)
+                                  LArPixHits& hits) const
+{
+  const uint64_t second_ticks = static_cast<uint64_t>(unix_ts) * m_clock_frequency; // NOLINT(build/unsigned)
+
+  // Sized for the worst case, packed once the hit count is known
+  hits.reset(num_words);
+  uint64_t* timestamps = hits.timestamp(); // NOLINT(build/unsigned)
+  uint8_t* chip_ids = hits.chip_id();      // NOLINT(build/unsigned)
+  uint8_t* channel_ids = hits.channel_id(); // NOLINT(build/unsigned)
+  uint8_t* io_channels = hits.io_channel(); // NOLINT(build/unsigned)
+  uint8_t* adcs = hits.adc();              // NOLINT(build/unsigned)
+  std::size_t num_hits = 0;
+  for (std::size_t i = 0; i < num_words; ++i) {
+    const char* word = words + i * word_size;
+    uint64_t packet = load_packet(word); // NOLINT(build/unsigned)
+    if (static_cast<uint8_t>(word[word_type_offset]) != data_word_type || // NOLINT(build/unsigned)
+        ((packet >> packet_type_shift) & packet_type_mask) != 0 || !parity_ok(packet)) {
+      continue;
+    }
+    uint64_t count = (packet >> timestamp_shift) & timestamp_mask; // NOLINT(build/unsigned)
+    if (count >= m_subsecond_clock_frequency) {
+      count %= m_subsecond_clock_frequency;
+    }
+    chip_ids[num_hits] = (packet >> chip_id_shift) & chip_id_mask;
+    channel_ids[num_hits] = (packet >> channel_id_shift) & channel_id_mask;
+    io_channels[num_hits] = static_cast<uint8_t>(word[word_channel_offset]); // NOLINT(build/unsigned)
+    timestamps[num_hits] = second_ticks + (m_ticks_per_count != 0
+                                             ? count * m_ticks_per_count
+                                             : count * m_clock_frequency / m_subsecond_clock_frequency);
+    adcs[num_hits] = (packet >> adc_shift) & adc_mask;
+    ++num_hits;
+  }
+  hits.shrink(num_hits);
+  return num_hits;
+}
+
+} // namespace pacman
+} // namespace ndreadoutlibs
+} // namespace dunedaq
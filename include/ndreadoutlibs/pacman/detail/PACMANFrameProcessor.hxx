@@ -1,36 +1,261 @@
 // Declarations for PACMANFrameProcessor
 
+#include <sstream>
+
 namespace dunedaq {
 namespace ndreadoutlibs {
 
 void 
 PACMANFrameProcessor::conf(const nlohmann::json& args)
 {
+  auto config = args["rawdataprocessorconf"].get<readoutlibs::readoutconfig::RawDataProcessorConf>();
+  m_clock_frequency = config.clock_speed_hz;
+  types::PACMANTypeAdapterConfig adapter_config;
+  adapter_config.clock_frequency = m_clock_frequency;
+
+  if (args.contains("ndreadoutconf")) {
+    auto ndconf = args["ndreadoutconf"].get<ndreadoutconfig::Conf>();
+    if (ndconf.pacman_storage_mode == "fixed") {
+      adapter_config.storage_mode = types::PACMANStorageMode::kFixedFrame;
+    } else if (ndconf.pacman_storage_mode == "pooled") {
+      adapter_config.storage_mode = types::PACMANStorageMode::kPooled;
+    } else {
+      throw ConfigurationError(ERS_HERE, "unknown pacman_storage_mode " + ndconf.pacman_storage_mode);
+    }
+    // In fixed frame mode every message takes a PACMAN_FRAME_SIZE block
+    auto block_size = adapter_config.storage_mode == types::PACMANStorageMode::kFixedFrame
+                        ? types::PACMAN_FRAME_SIZE
+                        : ndconf.payload_pool_block_size;
+    PayloadPool::instance().reserve(block_size, ndconf.payload_pool_preallocation);
+
+    if (ndconf.pacman_timestamp_mode == "unix") {
+      adapter_config.timestamp_mode = types::PACMANTimestampMode::kUnixSeconds;
+    } else if (ndconf.pacman_timestamp_mode == "receipt") {
+      adapter_config.timestamp_mode = types::PACMANTimestampMode::kReceiptTimestamp;
+    } else if (ndconf.pacman_timestamp_mode == "packet") {
+      adapter_config.timestamp_mode = types::PACMANTimestampMode::kPacketTimestamp;
+    } else if (ndconf.pacman_timestamp_mode == "range") {
+      adapter_config.timestamp_mode = types::PACMANTimestampMode::kPacketRange;
+    } else {
+      throw ConfigurationError(ERS_HERE, "unknown pacman_timestamp_mode " + ndconf.pacman_timestamp_mode);
+    }
+    if (ndconf.pacman_subsecond_clock_hz == 0) {
+      throw ConfigurationError(ERS_HERE, "pacman_subsecond_clock_hz must be non-zero");
+    }
+    adapter_config.subsecond_clock_frequency = ndconf.pacman_subsecond_clock_hz;
+    m_word_check_enabled = ndconf.pacman_word_check;
+    m_continuity.set_gap_threshold(ndconf.timestamp_gap_threshold);
+    m_emulator_ts_step = ndconf.emulator_timestamp_step_ticks;
+    latency::set_sample_period(ndconf.latency_sample_period);
+    m_hit_extraction_enabled = ndconf.pacman_hit_extraction;
+    if (ndconf.pacman_processing_mode == "serial") {
+      m_sharded = false;
+    } else if (ndconf.pacman_processing_mode == "sharded") {
+      m_sharded = true;
+    } else {
+      throw ConfigurationError(ERS_HERE, "unknown pacman_processing_mode " + ndconf.pacman_processing_mode);
+    }
+    if (ndconf.pacman_shard_key == "io_channel") {
+      m_shard_key = ShardKey::kIOChannel;
+    } else if (ndconf.pacman_shard_key == "chip") {
+      m_shard_key = ShardKey::kChip;
+    } else {
+      throw ConfigurationError(ERS_HERE, "unknown pacman_shard_key " + ndconf.pacman_shard_key);
+    }
+    m_worker_threads = std::max<std::size_t>(ndconf.pacman_worker_threads, 1);
+    m_worker_queue_size = std::max<std::size_t>(ndconf.pacman_worker_queue_size, 2);
+    m_worker_cpus.clear();
+    std::stringstream cpus(ndconf.pacman_worker_cpus);
+    for (std::string cpu; std::getline(cpus, cpu, ',');) {
+      if (!cpu.empty()) {
+        m_worker_cpus.push_back(std::stoi(cpu));
+      }
+    }
+    m_recording_enabled = !ndconf.record_output_file.empty();
+    if (m_recording_enabled) {
+      m_recorder.conf(ndconf.record_output_file,
+                      ndconf.record_compression,
+                      ndconf.record_compression_level,
+                      ndconf.record_block_size);
+    }
+  }
+  // The adapter settings are shared by every PACMAN link of the process
+  if (m_holds_adapter_config) {
+    types::NDReadoutPACMANTypeAdapter::release_config();
+    m_holds_adapter_config = false;
+  }
+  if (!types::NDReadoutPACMANTypeAdapter::acquire_config(adapter_config)) {
+    throw ConfigurationError(ERS_HERE,
+                             "PACMAN storage, timestamp mode or clocks differ from another PACMAN link of this process");
+  }
+  m_holds_adapter_config = true;
+  m_hit_extractor = pacman::LArPixHitExtractor(m_clock_frequency, adapter_config.subsecond_clock_frequency);
+
+  // Shards and worker queues are only sized here, get_info() walks them from another thread
+  m_shards.clear();
+  m_free_buffers.clear();
+  if (m_hit_extraction_enabled || (m_word_check_enabled && m_sharded)) {
+    for (std::size_t i = 0; i < m_worker_threads; ++i) {
+      m_shards.emplace_back(std::make_unique<Shard>());
+      m_free_buffers.emplace_back(std::make_unique<folly::ProducerConsumerQueue<WordBuffer>>(m_worker_queue_size + 1));
+    }
+    m_workers.allocate(m_worker_threads, m_worker_queue_size);
+  } else {
+    m_workers.allocate(0, 0);
+  }
+  m_shard_word_counts.assign(m_shards.size(), 0);
+  m_shard_cursors.assign(m_shards.size(), nullptr);
+  m_shard_jobs.clear();
+  m_shard_jobs.resize(m_shards.size());
+
   readoutlibs::TaskRawDataProcessorModel<types::NDReadoutPACMANTypeAdapter>::add_preprocess_task(
     std::bind(&PACMANFrameProcessor::timestamp_check, this, std::placeholders::_1));
-  // m_tasklist.push_back( std::bind(&PACMANFrameProcessor::frame_error_check, this, std::placeholders::_1) );
+  if (m_word_check_enabled) {
+    TLOG_DEBUG(TLVL_BOOKKEEPING) << "PACMAN word check enabled, vectorized decoder: "
+                                 << pacman::PACMANWordDecoder::vectorized() << ", sharded: " << m_sharded;
+  }
+  if (m_word_check_enabled && !m_sharded) {
+    readoutlibs::TaskRawDataProcessorModel<types::NDReadoutPACMANTypeAdapter>::add_preprocess_task(
+      std::bind(&PACMANFrameProcessor::frame_error_check, this, std::placeholders::_1));
+  }
+  if constexpr (latency::enabled) {
+    readoutlibs::TaskRawDataProcessorModel<types::NDReadoutPACMANTypeAdapter>::add_preprocess_task(
+      std::bind(&PACMANFrameProcessor::preprocess_done, this, std::placeholders::_1));
+  }
+  if (m_hit_extraction_enabled || (m_word_check_enabled && m_sharded)) {
+    TLOG_DEBUG(TLVL_BOOKKEEPING) << "PACMAN workers: " << m_worker_threads << ", hit extraction: "
+                                 << m_hit_extraction_enabled;
+    readoutlibs::TaskRawDataProcessorModel<types::NDReadoutPACMANTypeAdapter>::add_postprocess_task(
+      std::bind(&PACMANFrameProcessor::dispatch_words, this, std::placeholders::_1));
+  }
+  if (m_recording_enabled) {
+    readoutlibs::TaskRawDataProcessorModel<types::NDReadoutPACMANTypeAdapter>::add_postprocess_task(
+      std::bind(&PACMANFrameProcessor::record_message, this, std::placeholders::_1));
+  }
   TaskRawDataProcessorModel<types::NDReadoutPACMANTypeAdapter>::conf(args);
 }
 
+void
+PACMANFrameProcessor::scrap(const nlohmann::json& args)
+{
+  if (m_holds_adapter_config) {
+    types::NDReadoutPACMANTypeAdapter::release_config();
+    m_holds_adapter_config = false;
+  }
+  inherited::scrap(args);
+}
+
+void
+PACMANFrameProcessor::start(const nlohmann::json& args)
+{
+  // Hits would be decoded only to be thrown away
+  if (m_hit_extraction_enabled && !m_hit_sink) {
+    throw ConfigurationError(ERS_HERE, "pacman_hit_extraction is enabled but no hit sink is installed");
+  }
+  // The last timestamp of a previous run is no reference for the first one of this run
+  m_continuity.reset_previous();
+  if (m_workers.num_workers() != 0) {
+    // Counters of a previous run are not reported in this one
+    for (auto& shard : m_shards) {
+      shard->reset();
+    }
+    m_next_worker = 0;
+    m_workers.start(
+      "pacman-work", [this](std::size_t worker, WordJob& job) { process_words(worker, job); }, m_worker_cpus);
+  }
+  if (m_recording_enabled) {
+    // Each run goes into files of its own, named after the run number
+    m_recorder.start(args.value<daqdataformats::run_number_t>("run", 1));
+  }
+  inherited::start(args);
+}
+
+void
+PACMANFrameProcessor::stop(const nlohmann::json& args)
+{
+  inherited::stop(args);
+  // Words already handed to the workers are still processed
+  m_workers.stop();
+  m_recorder.stop();
+}
+
+void
+PACMANFrameProcessor::get_info(opmonlib::InfoCollector& ci, int level)
+{
+  auto stats = PayloadPool::instance().get_stats();
+  ndreadoutinfo::PayloadPoolInfo info;
+  info.bytes_in_use = stats.bytes_in_use;
+  info.bytes_acquired = stats.bytes_acquired;
+  info.bytes_reserved = stats.bytes_reserved;
+  info.blocks_in_use = stats.blocks_in_use;
+  info.blocks_total = stats.blocks_total;
+  info.occupancy = stats.blocks_total ? static_cast<double>(stats.blocks_in_use) / stats.blocks_total : 0.;
+  info.slab_allocations = stats.slab_allocations;
+  info.payload_copies = stats.payload_copies;
+  info.payload_adoptions = stats.payload_adoptions;
+  info.oversized_copies = stats.oversized_copies;
+  ci.add(info);
+
+  if (m_word_check_enabled) {
+    ndreadoutinfo::PACMANFrameProcessorInfo pinfo;
+    m_word_counters.collect(pinfo);
+    for (auto& shard : m_shards) {
+      shard->counters.collect(pinfo);
+    }
+    ci.add(pinfo);
+  }
+  if (m_workers.num_workers() != 0) {
+    ndreadoutinfo::PACMANWorkerInfo winfo;
+    winfo.jobs_queued = m_jobs_queued.exchange(0);
+    winfo.jobs_dropped = m_jobs_dropped.exchange(0);
+    winfo.words_dropped = m_words_dropped.exchange(0);
+    for (auto& shard : m_shards) {
+      winfo.jobs_processed += shard->jobs_processed.exchange(0);
+      winfo.hits_extracted += shard->hits_extracted.exchange(0);
+      winfo.hits_discarded += shard->hits_discarded.exchange(0);
+    }
+    winfo.queue_occupancy = m_workers.get_queued();
+    ci.add(winfo);
+  }
+  if (m_recording_enabled) {
+    m_recorder.get_info(ci, level);
+  }
+  auto continuity_info = m_continuity.get_info();
+  ci.add(continuity_info);
+  if constexpr (latency::enabled) {
+    auto preprocess = m_preprocess_latency.take();
+    ndreadoutinfo::ProcessingLatencyInfo linfo;
+    linfo.preprocess_count = preprocess.count;
+    linfo.preprocess_mean_ns = preprocess.mean_ns;
+    linfo.preprocess_p50_ns = preprocess.p50_ns;
+    linfo.preprocess_p99_ns = preprocess.p99_ns;
+    linfo.preprocess_p999_ns = preprocess.p999_ns;
+    linfo.preprocess_max_ns = preprocess.max_ns;
+    ci.add(linfo);
+  }
+
+  inherited::get_info(ci, level);
+}
+
 /**
- * Pipeline Stage 1.: Check proper timestamp increments in DAPHNE frame
+ * Pipeline Stage 1.: Check proper timestamp increments in PACMAN messages
  * */
 void 
 PACMANFrameProcessor::timestamp_check(frameptr fp)
 {
-  // If EMU data, emulate perfectly incrementing timestamp
-  if (inherited::m_emulator_mode) { // emulate perfectly incrementing timestamp
-    // FIX ME - add fake timestamp to PACMAN message struct
+  // If EMU data, keys not above the previous one continue an increasing sequence. Only the
+  // key is replaced, the message header holds whole seconds.
+  if (inherited::m_emulator_mode && fp->get_timestamp() <= m_previous_ts) {
+    fp->set_first_timestamp(m_previous_ts + m_emulator_ts_step);
   }
 
   // Acquire timestamp
   m_current_ts = fp->get_timestamp();
-  TLOG_DEBUG(TLVL_FRAME_RECEIVED) << "Received PACMAN frame timestamp value of " << m_current_ts << " ticks (..." << std::fixed
-                                  << std::setprecision(8) << (static_cast<double>(m_current_ts % (50000000000)) / 50000000.0) << " sec)";
+  TLOG_DEBUG(TLVL_FRAME_RECEIVED) << "Received PACMAN frame timestamp value of " << m_current_ts << " ticks";
 
   // Check timestamp
   // RS warning : not fixed rate!
-  if (m_current_ts - m_previous_ts <= 0) {
+  if (TimestampContinuityChecker<types::NDReadoutPACMANTypeAdapter>::is_error(m_continuity.check(m_current_ts))) {
     ++m_ts_error_ctr;
     TLOG_DEBUG(TLVL_BOOKKEEPING) << "Timestamp continuity MISSMATCH! -> | previous: " << std::to_string(m_previous_ts)
                                  << " current: " + std::to_string(m_current_ts);
@@ -49,15 +274,218 @@ PACMANFrameProcessor::timestamp_check(frameptr fp)
 }
 
 /**
- * Pipeline Stage 2.: Check headers for error flags
+ * Pipeline Stage 2.: Decode all message words, count word types, parity and format errors
  * */
 void 
-PACMANFrameProcessor::frame_error_check(frameptr /*fp*/)
+PACMANFrameProcessor::frame_error_check(frameptr fp)
 {
-  // check error fields
-  // FIX ME - to be implemented
+  pacman::PACMANWordDecoder::decode(reinterpret_cast<const char*>(fp->begin()), fp->get_message_size(), m_summary); // NOLINT
 
-  // fp->inspect_message();
+  m_word_counters.messages_checked.fetch_add(1, std::memory_order_relaxed);
+  m_word_counters.size_errors.fetch_add(m_summary.size_errors, std::memory_order_relaxed);
+  m_word_counters.add(m_summary);
+  if (m_summary.has_errors()) {
+    report_word_errors(m_summary, fp->get_timestamp());
+  }
+}
+
+void
+PACMANFrameProcessor::report_word_errors(const pacman::PACMANMessageSummary& summary, timestamp_t ts)
+{
+  if (summary.parity_errors) {
+    m_error_registry->add_error("PACMANParity", readoutlibs::FrameErrorRegistry::ErrorInterval(ts, ts));
+  }
+  if (summary.format_errors()) {
+    m_error_registry->add_error("PACMANFormat", readoutlibs::FrameErrorRegistry::ErrorInterval(ts, ts));
+  }
+}
+
+void
+PACMANFrameProcessor::WordCheckCounters::add(const pacman::PACMANMessageSummary& summary)
+{
+  const auto& counts = summary.word_type_counts;
+  words_decoded.fetch_add(summary.num_words, std::memory_order_relaxed);
+  data_words.fetch_add(counts[pacman::kDataWord], std::memory_order_relaxed);
+  trigger_words.fetch_add(counts[pacman::kTriggerWord], std::memory_order_relaxed);
+  sync_words.fetch_add(counts[pacman::kSyncWord], std::memory_order_relaxed);
+  control_words.fetch_add(counts[pacman::kPingWord] + counts[pacman::kWriteWord] + counts[pacman::kReadWord],
+                          std::memory_order_relaxed);
+  error_words.fetch_add(counts[pacman::kErrorWord], std::memory_order_relaxed);
+  data_packets.fetch_add(summary.data_packets, std::memory_order_relaxed);
+  if (summary.has_errors()) {
+    messages_with_errors.fetch_add(1, std::memory_order_relaxed);
+    parity_errors.fetch_add(summary.parity_errors, std::memory_order_relaxed);
+    unknown_word_types.fetch_add(summary.unknown_word_types, std::memory_order_relaxed);
+  }
+}
+
+void
+PACMANFrameProcessor::WordCheckCounters::collect(ndreadoutinfo::PACMANFrameProcessorInfo& info)
+{
+  info.messages_checked += messages_checked.exchange(0);
+  info.messages_with_errors += messages_with_errors.exchange(0);
+  info.words_decoded += words_decoded.exchange(0);
+  info.data_words += data_words.exchange(0);
+  info.trigger_words += trigger_words.exchange(0);
+  info.sync_words += sync_words.exchange(0);
+  info.control_words += control_words.exchange(0);
+  info.error_words += error_words.exchange(0);
+  info.data_packets += data_packets.exchange(0);
+  info.parity_errors += parity_errors.exchange(0);
+  info.unknown_word_types += unknown_word_types.exchange(0);
+  info.size_errors += size_errors.exchange(0);
+}
+
+void
+PACMANFrameProcessor::WordCheckCounters::reset()
+{
+  ndreadoutinfo::PACMANFrameProcessorInfo discarded;
+  collect(discarded);
+}
+
+void
+PACMANFrameProcessor::preprocess_done(frameptr fp)
+{
+  m_preprocess_latency.record_since_load(*fp);
+}
+
+void
+PACMANFrameProcessor::record_message(constframeptr fp)
+{
+  m_recorder.record(fp->data.data(), fp->get_message_size(), fp->get_first_timestamp());
+}
+
+/**
+ * Post-processing stage: hand the message words to the PACMAN workers
+ * */
+void
+PACMANFrameProcessor::dispatch_words(constframeptr fp)
+{
+  if (!m_workers.is_running()) {
+    m_jobs_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // The latency buffer entry may be evicted before a worker gets to it, so the words are
+  // copied into buffers recycled by the workers
+  const char* msg = fp->data.data();
+  std::size_t size = fp->get_message_size();
+  std::size_t declared = size < pacman::header_size ? 0 : pacman::load_header_words(msg);
+  std::size_t available = size < pacman::header_size ? 0 : (size - pacman::header_size) / pacman::word_size;
+  if (m_sharded && m_word_check_enabled) {
+    // The message level part of the word check stays on this thread
+    m_word_counters.messages_checked.fetch_add(1, std::memory_order_relaxed);
+    if (size < pacman::header_size || declared != available ||
+        (size - pacman::header_size) % pacman::word_size != 0) {
+      auto ts = fp->get_timestamp();
+      m_word_counters.size_errors.fetch_add(1, std::memory_order_relaxed);
+      m_error_registry->add_error("PACMANFormat", readoutlibs::FrameErrorRegistry::ErrorInterval(ts, ts));
+    }
+  }
+  std::size_t num_words = std::min(declared, available);
+  if (num_words == 0) {
+    return;
+  }
+  const char* words = msg + pacman::header_size;
+  const uint32_t unix_ts = pacman::load_header_unix_ts(msg); // NOLINT(build/unsigned)
+  const std::size_t num_shards = m_workers.num_workers();
+
+  // Serial mode or a single worker: whole messages, round robin
+  if (!m_sharded || num_shards == 1) {
+    std::size_t worker = m_next_worker;
+    m_next_worker = (m_next_worker + 1) % num_shards;
+    WordJob job;
+    job.words = take_buffer(worker, num_words * pacman::word_size);
+    std::memcpy(job.words.data.get(), words, num_words * pacman::word_size);
+    job.num_words = num_words;
+    job.unix_ts = unix_ts;
+    job.timestamp = fp->get_timestamp();
+    dispatch_job(worker, std::move(job));
+    return;
+  }
+
+  // Sharded mode: one pass to size the per shard word arrays, one to scatter the words
+  std::fill(m_shard_word_counts.begin(), m_shard_word_counts.end(), 0);
+  for (std::size_t i = 0; i < num_words; ++i) {
+    ++m_shard_word_counts[shard_of(words + i * pacman::word_size, num_shards)];
+  }
+  for (std::size_t shard = 0; shard < num_shards; ++shard) {
+    auto& job = m_shard_jobs[shard];
+    if (m_shard_word_counts[shard] == 0) {
+      continue;
+    }
+    job.words = take_buffer(shard, m_shard_word_counts[shard] * pacman::word_size);
+    m_shard_cursors[shard] = job.words.data.get();
+    job.num_words = m_shard_word_counts[shard];
+    job.unix_ts = unix_ts;
+    job.timestamp = fp->get_timestamp();
+  }
+  for (std::size_t i = 0; i < num_words; ++i) {
+    const char* word = words + i * pacman::word_size;
+    char*& cursor = m_shard_cursors[shard_of(word, num_shards)];
+    std::memcpy(cursor, word, pacman::word_size);
+    cursor += pacman::word_size;
+  }
+  for (std::size_t shard = 0; shard < num_shards; ++shard) {
+    if (m_shard_word_counts[shard] != 0) {
+      dispatch_job(shard, std::move(m_shard_jobs[shard]));
+    }
+  }
+}
+
+std::size_t
+PACMANFrameProcessor::shard_of(const char* word, std::size_t num_shards) const
+{
+  if (m_shard_key == ShardKey::kIOChannel) {
+    return static_cast<uint8_t>(word[pacman::word_channel_offset]) % num_shards; // NOLINT(build/unsigned)
+  }
+  return ((pacman::load_packet(word) >> pacman::chip_id_shift) & pacman::chip_id_mask) % num_shards;
+}
+
+PACMANFrameProcessor::WordBuffer
+PACMANFrameProcessor::take_buffer(std::size_t worker, std::size_t size)
+{
+  WordBuffer buffer;
+  m_free_buffers[worker]->read(buffer);
+  buffer.reserve(size);
+  return buffer;
+}
+
+void
+PACMANFrameProcessor::dispatch_job(std::size_t worker, WordJob&& job)
+{
+  auto num_words = job.num_words;
+  if (m_workers.dispatch(worker, std::move(job))) {
+    m_jobs_queued.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    m_jobs_dropped.fetch_add(1, std::memory_order_relaxed);
+    m_words_dropped.fetch_add(num_words, std::memory_order_relaxed);
+  }
+}
+
+void
+PACMANFrameProcessor::process_words(std::size_t worker, WordJob& job)
+{
+  auto& shard = *m_shards[worker];
+  if (m_sharded && m_word_check_enabled) {
+    shard.summary.reset();
+    shard.summary.num_words = job.num_words;
+    pacman::PACMANWordDecoder::decode_words(job.words.data.get(), job.num_words, shard.summary);
+    shard.counters.add(shard.summary);
+    if (shard.summary.has_errors()) {
+      report_word_errors(shard.summary, job.timestamp);
+    }
+  }
+  if (m_hit_extraction_enabled) {
+    pacman::LArPixHits hits;
+    hits.message_timestamp = job.timestamp;
+    auto num_hits = m_hit_extractor.extract_words(job.words.data.get(), job.num_words, job.unix_ts, hits);
+    shard.hits_extracted.fetch_add(num_hits, std::memory_order_relaxed);
+    if (num_hits != 0 && !m_hit_sink(std::move(hits))) {
+      shard.hits_discarded.fetch_add(num_hits, std::memory_order_relaxed);
+    }
+  }
+  m_free_buffers[worker]->write(std::move(job.words));
+  shard.jobs_processed.fetch_add(1, std::memory_order_relaxed);
 }
 
 } // namespace ndreadoutlibs
@@ -0,0 +1,70 @@
+// Declarations for PACMANListRequestHandler
+
+#include <algorithm>
+#include <cstring>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+inline void
+PACMANListRequestHandler::conf(const nlohmann::json& args)
+{
+  inherited::conf(args);
+  ndreadoutconfig::Conf ndconf;
+  if (args.contains("ndreadoutconf")) {
+    ndconf = args["ndreadoutconf"].get<ndreadoutconfig::Conf>();
+  }
+  m_trim_to_window = ndconf.pacman_trim_to_window;
+}
+
+inline void
+PACMANListRequestHandler::get_info(opmonlib::InfoCollector& ci, int level)
+{
+  ndreadoutinfo::PACMANRangeInfo info;
+  info.max_range_span = inherited::m_latency_buffer->get_max_span();
+  info.spans_capped = inherited::m_latency_buffer->get_capped_spans();
+  ci.add(info);
+  inherited::get_info(ci, level);
+}
+
+inline std::size_t
+PACMANListRequestHandler::add_fragment_pieces(types::NDReadoutPACMANTypeAdapter& element, FragmentContext& context)
+{
+  auto size = element.get_message_size();
+  if (!m_trim_to_window || size < types::PACMAN_MSG_HEADER_SIZE ||
+      (element.get_first_timestamp() >= context.begin_ts && element.get_end_timestamp() < context.end_ts)) {
+    return inherited::add_fragment_pieces(element, context);
+  }
+
+  const char* msg = reinterpret_cast<const char*>(element.begin()); // NOLINT
+  std::size_t num_words =
+    std::min<std::size_t>(pacman::load_header_words(msg), (size - pacman::header_size) / pacman::word_size);
+  uint64_t second_ticks = // NOLINT(build/unsigned)
+    static_cast<uint64_t>(pacman::load_header_unix_ts(msg)) * types::NDReadoutPACMANTypeAdapter::config().clock_frequency; // NOLINT
+  auto& trimmed = context.storage.emplace_back(size);
+  std::memcpy(trimmed.data(), msg, pacman::header_size);
+  uint16_t kept = 0; // NOLINT(build/unsigned)
+  for (std::size_t i = 0; i < num_words; ++i) {
+    const char* word = msg + pacman::header_size + i * pacman::word_size;
+    uint64_t packet = pacman::load_packet(word); // NOLINT(build/unsigned)
+    if (types::NDReadoutPACMANTypeAdapter::is_data_packet(word, packet)) {
+      auto ticks = types::NDReadoutPACMANTypeAdapter::packet_ticks(second_ticks, packet);
+      if (ticks < context.begin_ts || ticks >= context.end_ts) {
+        continue;
+      }
+    }
+    std::memcpy(trimmed.data() + pacman::header_size + kept * pacman::word_size, word, pacman::word_size);
+    ++kept;
+  }
+  if (kept == 0) {
+    context.storage.pop_back();
+    return 0;
+  }
+  std::memcpy(trimmed.data() + pacman::header_words_offset, &kept, sizeof(kept));
+  trimmed.resize(pacman::header_size + kept * pacman::word_size);
+  context.pieces.emplace_back(static_cast<void*>(trimmed.data()), trimmed.size());
+  return trimmed.size();
+}
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
@@ -0,0 +1,195 @@
+// Declarations for PACMANWordDecoder
+
+#ifdef NDREADOUTLIBS_PACMAN_DECODER_AVX2
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace pacman {
+
+inline WordTypeBin
+PACMANWordDecoder::word_type_bin(uint8_t type) // NOLINT(build/unsigned)
+{
+  switch (type) {
+    case data_word_type:
+      return kDataWord;
+    case trigger_word_type:
+      return kTriggerWord;
+    case sync_word_type:
+      return kSyncWord;
+    case ping_word_type:
+      return kPingWord;
+    case write_word_type:
+      return kWriteWord;
+    case read_word_type:
+      return kReadWord;
+    case error_word_type:
+      return kErrorWord;
+    default:
+      return kUnknownWord;
+  }
+}
+
+inline bool
+PACMANWordDecoder::vectorized()
+{
+#ifdef NDREADOUTLIBS_PACMAN_DECODER_AVX2
+  static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+inline void
+PACMANWordDecoder::decode(const char* msg, std::size_t size, PACMANMessageSummary& summary)
+{
+  summary.reset();
+  if (size < header_size) {
+    summary.size_errors = 1;
+    return;
+  }
+  std::size_t declared = load_header_words(msg);
+  std::size_t available = (size - header_size) / word_size;
+  if (declared != available || (size - header_size) % word_size != 0) {
+    summary.size_errors = 1;
+  }
+  std::size_t num_words = std::min(declared, available);
+  summary.num_words = num_words;
+  decode_words(msg + header_size, num_words, summary);
+}
+
+inline void
+PACMANWordDecoder::decode_words(const char* words, std::size_t num_words, PACMANMessageSummary& summary)
+{
+#ifdef NDREADOUTLIBS_PACMAN_DECODER_AVX2
+  if (vectorized()) {
+    decode_words_avx2(words, num_words, summary);
+    return;
+  }
+#endif
+  decode_words_scalar(words, num_words, summary);
+}
+
+inline void
+PACMANWordDecoder::decode_words_scalar(const char* words, std::size_t num_words, PACMANMessageSummary& summary)
+{
+  for (std::size_t i = 0; i < num_words; ++i) {
+    const char* word = words + i * word_size;
+    auto bin = word_type_bin(static_cast<uint8_t>(word[word_type_offset])); // NOLINT(build/unsigned)
+    ++summary.word_type_counts[bin];
+    if (bin == kUnknownWord) {
+      ++summary.unknown_word_types;
+      continue;
+    }
+    if (bin != kDataWord) {
+      continue;
+    }
+    uint64_t packet = load_packet(word); // NOLINT(build/unsigned)
+    if (!parity_ok(packet)) {
+      ++summary.parity_errors;
+      continue;
+    }
+    if (((packet >> packet_type_shift) & packet_type_mask) != 0) {
+      continue;
+    }
+    uint32_t ts = (packet >> timestamp_shift) & timestamp_mask; // NOLINT(build/unsigned)
+    summary.min_packet_timestamp = std::min(summary.min_packet_timestamp, ts);
+    summary.max_packet_timestamp = std::max(summary.max_packet_timestamp, ts);
+    ++summary.io_channel_hits[static_cast<uint8_t>(word[word_channel_offset])]; // NOLINT(build/unsigned)
+    ++summary.chip_hits[(packet >> chip_id_shift) & chip_id_mask];
+    ++summary.data_packets;
+  }
+}
+
+#ifdef NDREADOUTLIBS_PACMAN_DECODER_AVX2
+__attribute__((target("avx2,popcnt,bmi"))) inline void
+PACMANWordDecoder::decode_words_avx2(const char* words, std::size_t num_words, PACMANMessageSummary& summary)
+{
+  // unpack{lo,hi}_epi64 of words (i, i+1) and (i+2, i+3) leave the 64 bit lanes in this word order
+  static const constexpr std::size_t lane_word[4] = { 0, 2, 1, 3 };
+
+  const __m256i byte_mask = _mm256_set1_epi64x(0xff);
+  const __m256i data_type = _mm256_set1_epi64x(data_word_type);
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i type_mask = _mm256_set1_epi64x(packet_type_mask << packet_type_shift);
+  const __m256i ts_mask = _mm256_set1_epi64x(timestamp_mask);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i vmin = _mm256_set1_epi64x(std::numeric_limits<uint32_t>::max()); // NOLINT(build/unsigned)
+  __m256i vmax = zero;
+  // Kept in registers, summary is only updated for the sparse histograms
+  uint32_t data_words = 0;    // NOLINT(build/unsigned)
+  uint32_t parity_errors = 0; // NOLINT(build/unsigned)
+  uint32_t data_packets = 0;  // NOLINT(build/unsigned)
+
+  std::size_t i = 0;
+  for (; i + 4 <= num_words; i += 4) {
+    const char* block = words + i * word_size;
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));                 // NOLINT
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 2 * word_size)); // NOLINT
+    __m256i head = _mm256_unpacklo_epi64(a, b);
+    __m256i packet = _mm256_unpackhi_epi64(a, b);
+
+    __m256i is_data = _mm256_cmpeq_epi64(_mm256_and_si256(head, byte_mask), data_type);
+
+    // Odd parity: fold the 64 bits down to one with xor
+    __m256i par = _mm256_xor_si256(packet, _mm256_srli_epi64(packet, 32));
+    par = _mm256_xor_si256(par, _mm256_srli_epi64(par, 16));
+    par = _mm256_xor_si256(par, _mm256_srli_epi64(par, 8));
+    par = _mm256_xor_si256(par, _mm256_srli_epi64(par, 4));
+    par = _mm256_xor_si256(par, _mm256_srli_epi64(par, 2));
+    par = _mm256_xor_si256(par, _mm256_srli_epi64(par, 1));
+    __m256i parity_good = _mm256_cmpeq_epi64(_mm256_and_si256(par, one), one);
+
+    __m256i is_packet = _mm256_cmpeq_epi64(_mm256_and_si256(packet, type_mask), zero);
+    __m256i good = _mm256_and_si256(_mm256_and_si256(is_data, parity_good), is_packet);
+
+    __m256i ts = _mm256_and_si256(_mm256_srli_epi64(packet, timestamp_shift), ts_mask);
+    vmin = _mm256_min_epu32(vmin, _mm256_blendv_epi8(vmin, ts, good));
+    vmax = _mm256_max_epu32(vmax, _mm256_blendv_epi8(zero, ts, good));
+
+    unsigned data_bits = _mm256_movemask_pd(_mm256_castsi256_pd(is_data));
+    unsigned good_bits = _mm256_movemask_pd(_mm256_castsi256_pd(good));
+    unsigned bad_parity_bits = data_bits & ~_mm256_movemask_pd(_mm256_castsi256_pd(parity_good));
+
+    data_words += __builtin_popcount(data_bits);
+    parity_errors += __builtin_popcount(bad_parity_bits);
+    data_packets += __builtin_popcount(good_bits);
+
+    // Rare in physics data: control words between the data words
+    for (unsigned lanes = ~data_bits & 0xf; lanes; lanes &= lanes - 1) {
+      auto bin = word_type_bin(static_cast<uint8_t>(block[lane_word[__builtin_ctz(lanes)] * word_size])); // NOLINT
+      ++summary.word_type_counts[bin];
+      summary.unknown_word_types += (bin == kUnknownWord);
+    }
+    for (unsigned lanes = good_bits; lanes; lanes &= lanes - 1) {
+      const char* word = block + lane_word[__builtin_ctz(lanes)] * word_size;
+      ++summary.io_channel_hits[static_cast<uint8_t>(word[word_channel_offset])]; // NOLINT(build/unsigned)
+      ++summary.chip_hits[(load_packet(word) >> chip_id_shift) & chip_id_mask];
+    }
+  }
+
+  summary.word_type_counts[kDataWord] += data_words;
+  summary.parity_errors += parity_errors;
+  summary.data_packets += data_packets;
+
+  // Timestamps sit in the low 32 bits of each lane, the high halves are zero in both accumulators
+  alignas(32) uint32_t mins[8]; // NOLINT
+  alignas(32) uint32_t maxs[8]; // NOLINT
+  _mm256_store_si256(reinterpret_cast<__m256i*>(mins), vmin); // NOLINT
+  _mm256_store_si256(reinterpret_cast<__m256i*>(maxs), vmax); // NOLINT
+  for (std::size_t lane = 0; lane < 8; lane += 2) {
+    summary.min_packet_timestamp = std::min(summary.min_packet_timestamp, mins[lane]);
+    summary.max_packet_timestamp = std::max(summary.max_packet_timestamp, maxs[lane]);
+  }
+
+  decode_words_scalar(words + i * word_size, num_words - i, summary);
+}
+#endif
+
+} // namespace pacman
+} // namespace ndreadoutlibs
+} // namespace dunedaq
@@ -0,0 +1,226 @@
+/**
+ * @file BenchmarkReport.hpp Timing, percentile and JSON reporting helpers for the ND benchmarks
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_BENCHMARKREPORT_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_BENCHMARKREPORT_HPP_
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace benchmark {
+
+/**
+ * Command line options of the form --key value.
+ * */
+class BenchmarkOptions
+{
+public:
+  BenchmarkOptions(int argc, char* argv[])
+  {
+    for (int i = 1; i < argc; ++i) {
+      std::string arg(argv[i]);
+      if (arg.rfind("--", 0) != 0) {
+        continue;
+      }
+      std::string value = (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) ? argv[++i] : "1";
+      m_options[arg.substr(2)] = value;
+    }
+  }
+
+  uint64_t get(const std::string& key, uint64_t def) const // NOLINT(build/unsigned)
+  {
+    auto it = m_options.find(key);
+    return it == m_options.end() ? def : std::stoull(it->second);
+  }
+
+  double get_double(const std::string& key, double def) const
+  {
+    auto it = m_options.find(key);
+    return it == m_options.end() ? def : std::stod(it->second);
+  }
+
+  std::string get_string(const std::string& key, const std::string& def) const
+  {
+    auto it = m_options.find(key);
+    return it == m_options.end() ? def : it->second;
+  }
+
+  // Comma separated list of numbers
+  std::vector<uint64_t> get_list(const std::string& key, const std::vector<uint64_t>& def) const // NOLINT(build/unsigned)
+  {
+    auto it = m_options.find(key);
+    if (it == m_options.end()) {
+      return def;
+    }
+    std::vector<uint64_t> values; // NOLINT(build/unsigned)
+    std::stringstream ss(it->second);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      values.push_back(std::stoull(item));
+    }
+    return values;
+  }
+
+private:
+  std::map<std::string, std::string> m_options;
+};
+
+/**
+ * Per operation latency samples. Fast operations are timed in batches and every batch
+ * contributes its mean, which keeps the clock overhead out of the measurement.
+ * */
+class LatencySampler
+{
+public:
+  void add(double ns) { m_samples.push_back(ns); }
+
+  double percentile(double pct)
+  {
+    if (m_samples.empty()) {
+      return 0.;
+    }
+    if (!m_sorted) {
+      std::sort(m_samples.begin(), m_samples.end());
+      m_sorted = true;
+    }
+    auto idx = static_cast<std::size_t>(pct / 100. * (m_samples.size() - 1) + 0.5);
+    return m_samples[std::min(idx, m_samples.size() - 1)];
+  }
+
+  std::size_t size() const { return m_samples.size(); }
+  void clear()
+  {
+    m_samples.clear();
+    m_sorted = false;
+  }
+
+private:
+  std::vector<double> m_samples;
+  bool m_sorted = false;
+};
+
+inline uint64_t // NOLINT(build/unsigned)
+read_proc_status_kb(const std::string& field)
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind(field + ":", 0) == 0) {
+      return std::stoull(line.substr(field.size() + 1));
+    }
+  }
+  return 0;
+}
+
+inline uint64_t resident_bytes() { return read_proc_status_kb("VmRSS") * 1024; }     // NOLINT(build/unsigned)
+inline uint64_t peak_resident_bytes() { return read_proc_status_kb("VmHWM") * 1024; } // NOLINT(build/unsigned)
+
+/**
+ * Run op(i) for i in [0, num_ops), timing batches of batch_size operations.
+ * Returns the total elapsed time in seconds.
+ * */
+template<class Op>
+double
+time_batches(uint64_t num_ops, uint64_t batch_size, LatencySampler& samples, Op&& op) // NOLINT(build/unsigned)
+{
+  double total = 0.;
+  for (uint64_t first = 0; first < num_ops; first += batch_size) { // NOLINT(build/unsigned)
+    auto last = std::min(num_ops, first + batch_size);
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint64_t i = first; i < last; ++i) { // NOLINT(build/unsigned)
+      op(i);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    samples.add(ns / (last - first));
+    total += ns;
+  }
+  return total * 1e-9;
+}
+
+/**
+ * Machine readable benchmark results: one record per measurement with msgs/s, ns/op,
+ * p50/p99 latency and memory footprint.
+ * */
+class BenchmarkReport
+{
+public:
+  explicit BenchmarkReport(std::string suite)
+    : m_suite(std::move(suite))
+  {}
+
+  nlohmann::json& add(const std::string& name,
+                      const nlohmann::json& parameters,
+                      uint64_t num_ops, // NOLINT(build/unsigned)
+                      double seconds,
+                      LatencySampler& samples)
+  {
+    nlohmann::json result;
+    result["name"] = name;
+    result["parameters"] = parameters;
+    result["operations"] = num_ops;
+    result["seconds"] = seconds;
+    result["msgs_per_s"] = seconds > 0. ? num_ops / seconds : 0.;
+    result["ns_per_op"] = num_ops > 0 ? seconds * 1e9 / num_ops : 0.;
+    result["p50_ns"] = samples.percentile(50.);
+    result["p99_ns"] = samples.percentile(99.);
+    result["rss_bytes"] = resident_bytes();
+    result["peak_rss_bytes"] = peak_resident_bytes();
+    m_results.push_back(result);
+    std::cerr << m_suite << " " << name << " " << parameters.dump() << ": " << result["msgs_per_s"].get<double>()
+              << " msgs/s, " << result["ns_per_op"].get<double>() << " ns/op, p99 " << result["p99_ns"].get<double>()
+              << " ns" << std::endl;
+    return m_results.back();
+  }
+
+  nlohmann::json to_json() const
+  {
+    char hostname[256] = { 0 }; // NOLINT(modernize-avoid-c-arrays)
+    gethostname(hostname, sizeof(hostname) - 1);
+    nlohmann::json report;
+    report["suite"] = m_suite;
+    report["host"] = hostname;
+    report["timestamp"] =
+      std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    report["results"] = m_results;
+    return report;
+  }
+
+  // Write to path, or to stdout if path is empty or "-"
+  void write(const std::string& path) const
+  {
+    if (path.empty() || path == "-") {
+      std::cout << to_json().dump(2) << std::endl;
+      return;
+    }
+    std::ofstream out(path);
+    out << to_json().dump(2) << std::endl;
+  }
+
+private:
+  std::string m_suite;
+  std::vector<nlohmann::json> m_results;
+};
+
+} // namespace benchmark
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_BENCHMARKREPORT_HPP_
@@ -0,0 +1,512 @@
+/**
+ * @file CompressedRecorder.hpp Compressed recording of raw ND messages with a timestamp index
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_COMPRESSEDRECORDER_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_COMPRESSEDRECORDER_HPP_
+
+#include "ndreadoutlibs/NDReadoutIssues.hpp"
+#include "ndreadoutlibs/ndreadoutinfo/InfoNljs.hpp"
+#include "opmonlib/InfoCollector.hpp"
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace recording {
+
+enum class Codec : uint32_t // NOLINT(build/unsigned)
+{
+  kNone = 0,
+  kGzip = 1,
+  kZlib = 2
+};
+
+inline Codec
+parse_codec(const std::string& name)
+{
+  if (name == "none") {
+    return Codec::kNone;
+  }
+  if (name == "gzip") {
+    return Codec::kGzip;
+  }
+  if (name == "zlib") {
+    return Codec::kZlib;
+  }
+  throw ConfigurationError(ERS_HERE, "unknown record_compression " + name + ", expected none, gzip or zlib");
+}
+
+// The index file starts with an IndexHeader, followed by one IndexEntry per block
+struct IndexHeader
+{
+  char magic[4] = { 'N', 'D', 'R', 'I' }; // NOLINT(modernize-avoid-c-arrays)
+  uint32_t version = 1;                   // NOLINT(build/unsigned)
+  uint32_t codec = 0;                     // NOLINT(build/unsigned)
+  uint32_t block_size = 0;                // NOLINT(build/unsigned)
+};
+
+struct IndexEntry
+{
+  uint64_t min_ts = 0;          // NOLINT(build/unsigned)
+  uint64_t max_ts = 0;          // NOLINT(build/unsigned)
+  uint64_t offset = 0;          // NOLINT(build/unsigned) of the compressed block in the data file
+  uint64_t compressed_size = 0; // NOLINT(build/unsigned)
+  uint64_t raw_size = 0;        // NOLINT(build/unsigned)
+  uint64_t messages = 0;        // NOLINT(build/unsigned)
+};
+
+inline std::string
+index_path(const std::string& path)
+{
+  return path + ".idx";
+}
+
+// Recording of one run, the run number goes in front of the extension: rec.bin -> rec_run000042.bin
+inline std::string
+run_path(const std::string& path, uint32_t run_number) // NOLINT(build/unsigned)
+{
+  auto slash = path.rfind('/');
+  auto name = slash == std::string::npos ? 0 : slash + 1;
+  // A leading dot names a hidden file rather than starting the extension
+  auto ext = std::min(path.find('.', name + 1), path.size());
+  auto run = std::to_string(run_number);
+  run.insert(0, run.size() < 6 ? 6 - run.size() : 0, '0');
+  return path.substr(0, ext) + "_run" + run + path.substr(ext);
+}
+
+// Every block is compressed into a complete stream of its own, a gzip file is then a
+// sequence of gzip members which the standard tools read as one stream
+inline void
+compress(Codec codec, int level, const char* data, std::size_t size, std::vector<char>& out)
+{
+  namespace io = boost::iostreams;
+  out.clear();
+  if (codec == Codec::kNone) {
+    out.insert(out.end(), data, data + size);
+    return;
+  }
+  io::filtering_ostream stream;
+  if (codec == Codec::kGzip) {
+    stream.push(io::gzip_compressor(io::gzip_params(level)));
+  } else {
+    stream.push(io::zlib_compressor(io::zlib_params(level)));
+  }
+  stream.push(io::back_inserter(out));
+  stream.write(data, size);
+  stream.reset();
+}
+
+inline void
+decompress(Codec codec, const char* data, std::size_t size, std::vector<char>& out)
+{
+  namespace io = boost::iostreams;
+  out.clear();
+  if (codec == Codec::kNone) {
+    out.insert(out.end(), data, data + size);
+    return;
+  }
+  io::filtering_istream stream;
+  if (codec == Codec::kGzip) {
+    stream.push(io::gzip_decompressor());
+  } else {
+    stream.push(io::zlib_decompressor());
+  }
+  stream.push(io::array_source(data, size));
+  io::copy(stream, io::back_inserter(out));
+}
+
+// Page aligned buffer, so that full blocks can be written with aligned offsets and sizes
+struct AlignedBlock
+{
+  static constexpr std::size_t alignment = 4096;
+
+  struct Free
+  {
+    void operator()(char* p) const { std::free(p); } // NOLINT
+  };
+
+  explicit AlignedBlock(std::size_t bytes = 0)
+    : capacity((bytes + alignment - 1) / alignment * alignment)
+    , data(capacity ? static_cast<char*>(std::aligned_alloc(alignment, capacity)) : nullptr)
+  {}
+
+  std::size_t capacity;
+  std::unique_ptr<char, Free> data;
+  std::size_t size = 0;
+  IndexEntry entry;
+};
+
+} // namespace recording
+
+/**
+ * @brief Writes the message bytes of a readout stream into a compressed file.
+ *
+ * Only the real message bytes are kept, back to back, so that a decompressed recording is a
+ * capture file as read by MessageReplaySource. Messages are staged into one of two blocks;
+ * a full block is handed to the compression thread while the other one fills. If the
+ * compression thread is still busy with the previous block the message is dropped rather
+ * than stalling the caller. Compressed blocks go to the data file through page aligned output
+ * blocks, and every block gets an index entry (key range, file offset, sizes) in the index
+ * file next to it, so that a reader can decompress the blocks around a key on their own.
+ * Every run is recorded into files of its own, named after the run (see recording::run_path),
+ * and an existing recording is never overwritten: start() fails with RecordFileError instead.
+ * */
+class CompressedRecorder
+{
+public:
+  using timestamp_t = std::uint64_t; // NOLINT(build/unsigned)
+
+  CompressedRecorder() = default;
+  ~CompressedRecorder() { stop(); }
+  CompressedRecorder(const CompressedRecorder&) = delete;
+  CompressedRecorder& operator=(const CompressedRecorder&) = delete;
+
+  void conf(const std::string& path, const std::string& codec, int level, std::size_t block_size)
+  {
+    m_path = path;
+    m_codec = recording::parse_codec(codec);
+    m_level = level;
+    if (block_size == 0 || block_size > std::numeric_limits<uint32_t>::max()) { // NOLINT(build/unsigned)
+      throw ConfigurationError(ERS_HERE, "record_block_size must be between 1 and 4 GiB");
+    }
+    m_block_size = block_size;
+  }
+
+  void start(uint32_t run_number) // NOLINT(build/unsigned)
+  {
+    if (m_running) {
+      return;
+    }
+    m_run_path = recording::run_path(m_path, run_number);
+    m_fd = open_file(m_run_path);
+    try {
+      m_index_fd = open_file(recording::index_path(m_run_path));
+    } catch (const RecordFileError&) {
+      ::close(m_fd);
+      throw;
+    }
+    recording::IndexHeader header;
+    header.codec = static_cast<uint32_t>(m_codec); // NOLINT(build/unsigned)
+    header.block_size = m_block_size;
+    write_all(m_index_fd, &header, sizeof(header), recording::index_path(m_run_path));
+
+    for (auto& block : m_staging) {
+      block = recording::AlignedBlock(m_block_size);
+    }
+    m_output = recording::AlignedBlock(std::max(m_block_size, recording::AlignedBlock::alignment));
+    m_active = 0;
+    m_file_offset = 0;
+    m_pending = false;
+    m_stop = false;
+    m_thread = std::thread(&CompressedRecorder::run, this);
+    pthread_setname_np(m_thread.native_handle(), "nd-recorder");
+    m_running = true;
+  }
+
+  // Compresses the last partial block, then closes the files
+  void stop()
+  {
+    if (!m_running) {
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] { return !m_pending; });
+    }
+    hand_off();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+    if (m_output.size) {
+      write_all(m_fd, m_output.data.get(), m_output.size, m_run_path);
+      m_output.size = 0;
+    }
+    ::close(m_fd);
+    ::close(m_index_fd);
+    m_running = false;
+  }
+
+  bool is_running() const { return m_running; }
+
+  // Data file of the current or last run, empty before the first start()
+  const std::string& file_path() const { return m_run_path; }
+
+  // Single producer. Returns false if the message is dropped.
+  bool record(const char* data, std::size_t size, timestamp_t ts)
+  {
+    auto* block = &m_staging[m_active];
+    if (size > block->capacity) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (block->size + size > block->capacity) {
+      if (!hand_off()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      block = &m_staging[m_active];
+    }
+    std::memcpy(block->data.get() + block->size, data, size);
+    block->size += size;
+    auto& entry = block->entry;
+    entry.min_ts = entry.messages ? std::min(entry.min_ts, ts) : ts;
+    entry.max_ts = entry.messages ? std::max(entry.max_ts, ts) : ts;
+    ++entry.messages;
+    m_messages.fetch_add(1, std::memory_order_relaxed);
+    m_raw_bytes.fetch_add(size, std::memory_order_relaxed);
+    return true;
+  }
+
+  void get_info(opmonlib::InfoCollector& ci, int /*level*/)
+  {
+    ndreadoutinfo::CompressedRecorderInfo info;
+    info.messages_recorded = m_messages.exchange(0);
+    info.messages_dropped = m_dropped.exchange(0);
+    info.raw_bytes = m_raw_bytes.exchange(0);
+    info.compressed_bytes = m_compressed_bytes.exchange(0);
+    info.blocks_written = m_blocks.exchange(0);
+    ci.add(info);
+  }
+
+private:
+  // Fails if the file exists, a recording is never overwritten
+  int open_file(const std::string& path)
+  {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+      throw RecordFileError(ERS_HERE, path, std::strerror(errno));
+    }
+    return fd;
+  }
+
+  static void write_all(int fd, const void* data, std::size_t size, const std::string& path)
+  {
+    auto* p = static_cast<const char*>(data);
+    while (size > 0) {
+      auto written = ::write(fd, p, size);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw RecordFileError(ERS_HERE, path, std::strerror(errno));
+      }
+      p += written;
+      size -= written;
+    }
+  }
+
+  // Passes the active block to the compression thread, false if it still holds the other one
+  bool hand_off()
+  {
+    if (m_staging[m_active].entry.messages == 0) {
+      return true;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_pending) {
+        return false;
+      }
+      m_full = m_active;
+      m_pending = true;
+    }
+    m_cv.notify_all();
+    m_active ^= 1;
+    m_staging[m_active].size = 0;
+    m_staging[m_active].entry = recording::IndexEntry();
+    return true;
+  }
+
+  void run()
+  {
+    std::vector<char> compressed;
+    compressed.reserve(m_block_size);
+    while (true) {
+      std::size_t full;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_pending || m_stop; });
+        if (!m_pending) {
+          return;
+        }
+        full = m_full;
+      }
+      auto& block = m_staging[full];
+      try {
+        recording::compress(m_codec, m_level, block.data.get(), block.size, compressed);
+        block.entry.offset = m_file_offset;
+        block.entry.compressed_size = compressed.size();
+        block.entry.raw_size = block.size;
+        append_output(compressed.data(), compressed.size());
+        write_all(m_index_fd, &block.entry, sizeof(block.entry), recording::index_path(m_run_path));
+        m_compressed_bytes.fetch_add(compressed.size(), std::memory_order_relaxed);
+        m_blocks.fetch_add(1, std::memory_order_relaxed);
+      } catch (const std::exception& e) {
+        ers::error(RecordFileError(ERS_HERE, m_run_path, e.what()));
+        m_dropped.fetch_add(block.entry.messages, std::memory_order_relaxed);
+      }
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = false;
+      }
+      m_cv.notify_all();
+    }
+  }
+
+  // Only whole output blocks are written until stop() flushes the remainder
+  void append_output(const char* data, std::size_t size)
+  {
+    m_file_offset += size;
+    while (size > 0) {
+      auto n = std::min(size, m_output.capacity - m_output.size);
+      std::memcpy(m_output.data.get() + m_output.size, data, n);
+      m_output.size += n;
+      data += n;
+      size -= n;
+      if (m_output.size == m_output.capacity) {
+        write_all(m_fd, m_output.data.get(), m_output.size, m_run_path);
+        m_output.size = 0;
+      }
+    }
+  }
+
+  // Configuration
+  std::string m_path;
+  recording::Codec m_codec = recording::Codec::kGzip;
+  int m_level = 1;
+  std::size_t m_block_size = 4 << 20;
+
+  std::string m_run_path;
+  bool m_running = false;
+  int m_fd = -1;
+  int m_index_fd = -1;
+  std::array<recording::AlignedBlock, 2> m_staging;
+  recording::AlignedBlock m_output;
+  std::size_t m_active = 0;
+  uint64_t m_file_offset = 0; // NOLINT(build/unsigned)
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::size_t m_full = 0;
+  bool m_pending = false;
+  bool m_stop = false;
+  std::thread m_thread;
+
+  // Stats
+  std::atomic<uint64_t> m_messages{ 0 };         // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_dropped{ 0 };          // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_raw_bytes{ 0 };        // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_compressed_bytes{ 0 }; // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_blocks{ 0 };           // NOLINT(build/unsigned)
+};
+
+/**
+ * @brief Random access to a recording through its index file.
+ * */
+class CompressedRecordReader
+{
+public:
+  using timestamp_t = std::uint64_t; // NOLINT(build/unsigned)
+
+  explicit CompressedRecordReader(const std::string& path)
+    : m_path(path)
+  {
+    auto index = recording::index_path(path);
+    int index_fd = ::open(index.c_str(), O_RDONLY);
+    if (index_fd < 0) {
+      throw RecordFileError(ERS_HERE, index, std::strerror(errno));
+    }
+    recording::IndexHeader header;
+    bool valid = ::read(index_fd, &header, sizeof(header)) == sizeof(header) &&
+                 std::memcmp(header.magic, recording::IndexHeader().magic, sizeof(header.magic)) == 0 &&
+                 header.codec <= static_cast<uint32_t>(recording::Codec::kZlib); // NOLINT(build/unsigned)
+    recording::IndexEntry entry;
+    while (valid && ::read(index_fd, &entry, sizeof(entry)) == sizeof(entry)) {
+      m_index.push_back(entry);
+    }
+    ::close(index_fd);
+    if (!valid) {
+      throw RecordFileError(ERS_HERE, index, "not a recording index");
+    }
+    m_codec = static_cast<recording::Codec>(header.codec);
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+      throw RecordFileError(ERS_HERE, path, std::strerror(errno));
+    }
+  }
+
+  ~CompressedRecordReader() { ::close(m_fd); }
+  CompressedRecordReader(const CompressedRecordReader&) = delete;
+  CompressedRecordReader& operator=(const CompressedRecordReader&) = delete;
+
+  recording::Codec codec() const { return m_codec; }
+  const std::vector<recording::IndexEntry>& index() const { return m_index; }
+
+  // First block holding a key at or after ts, index().size() if there is none
+  std::size_t find_block(timestamp_t ts) const
+  {
+    for (std::size_t i = 0; i < m_index.size(); ++i) {
+      if (m_index[i].max_ts >= ts) {
+        return i;
+      }
+    }
+    return m_index.size();
+  }
+
+  // Decompressed message bytes of one block
+  void read_block(std::size_t block, std::vector<char>& raw)
+  {
+    const auto& entry = m_index.at(block);
+    m_compressed.resize(entry.compressed_size);
+    auto n = ::pread(m_fd, m_compressed.data(), entry.compressed_size, entry.offset);
+    if (n != static_cast<ssize_t>(entry.compressed_size)) {
+      throw RecordFileError(ERS_HERE, m_path, "truncated block");
+    }
+    recording::decompress(m_codec, m_compressed.data(), m_compressed.size(), raw);
+    if (raw.size() != entry.raw_size) {
+      throw RecordFileError(ERS_HERE, m_path, "block size does not match the index");
+    }
+  }
+
+private:
+  std::string m_path;
+  recording::Codec m_codec = recording::Codec::kNone;
+  std::vector<recording::IndexEntry> m_index;
+  std::vector<char> m_compressed;
+  int m_fd = -1;
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_COMPRESSEDRECORDER_HPP_
@@ -0,0 +1,119 @@
+/**
+ * @file DeferredReclaimer.hpp Background release of storage evicted from the latency buffer
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_DEFERREDRECLAIMER_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_DEFERREDRECLAIMER_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+/**
+ * Takes over references on evicted storage and drops them on its own thread, so that the
+ * destructors (payload releases to the PayloadPool, chunk frees) run outside of the thread
+ * doing the cleanup. When the thread is not running, retire() drops the reference in place.
+ * */
+class DeferredReclaimer
+{
+public:
+  DeferredReclaimer() = default;
+  ~DeferredReclaimer() { stop(); }
+  DeferredReclaimer(const DeferredReclaimer&) = delete;
+  DeferredReclaimer& operator=(const DeferredReclaimer&) = delete;
+
+  void start(const std::string& name = "nd-reclaim")
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (m_running) {
+      return;
+    }
+    m_running = true;
+    m_thread = std::thread(&DeferredReclaimer::run, this);
+    pthread_setname_np(m_thread.native_handle(), name.substr(0, 15).c_str());
+  }
+
+  // Joins the thread once everything queued has been released
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      if (!m_running) {
+        return;
+      }
+      m_running = false;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+  }
+
+  void retire(std::shared_ptr<const void> garbage)
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      if (m_running) {
+        m_queue.push_back(std::move(garbage));
+        m_pending.store(m_queue.size(), std::memory_order_relaxed);
+        m_cv.notify_one();
+        return;
+      }
+    }
+    garbage.reset();
+    m_reclaimed.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  bool is_running()
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_running;
+  }
+  std::size_t get_pending() const { return m_pending.load(std::memory_order_relaxed); }
+  uint64_t get_reclaimed() const { return m_reclaimed.load(std::memory_order_relaxed); } // NOLINT(build/unsigned)
+
+private:
+  void run()
+  {
+    std::vector<std::shared_ptr<const void>> batch;
+    std::unique_lock<std::mutex> lk(m_mutex);
+    while (true) {
+      m_cv.wait(lk, [&] { return !m_queue.empty() || !m_running; });
+      if (m_queue.empty()) {
+        return;
+      }
+      batch.swap(m_queue);
+      m_pending.store(0, std::memory_order_relaxed);
+      lk.unlock();
+      m_reclaimed.fetch_add(batch.size(), std::memory_order_relaxed);
+      batch.clear();
+      lk.lock();
+    }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_running = false;
+  std::thread m_thread;
+  std::vector<std::shared_ptr<const void>> m_queue;
+  std::atomic<std::size_t> m_pending{ 0 };
+  std::atomic<uint64_t> m_reclaimed{ 0 }; // NOLINT(build/unsigned)
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_DEFERREDRECLAIMER_HPP_
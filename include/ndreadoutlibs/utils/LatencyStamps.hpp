@@ -0,0 +1,193 @@
+/**
+ * @file LatencyStamps.hpp Receive to fragment latency stamps of the ND readout, compiled in with
+ * NDREADOUTLIBS_LATENCY_STAMPS
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_LATENCYSTAMPS_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_LATENCYSTAMPS_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace latency {
+
+#ifdef NDREADOUTLIBS_LATENCY_STAMPS
+const constexpr bool enabled = true;
+#else
+const constexpr bool enabled = false;
+#endif
+
+inline uint64_t // NOLINT(build/unsigned)
+now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// Stamped messages are one in (mask + 1), a power of two
+inline std::atomic<uint32_t>& // NOLINT(build/unsigned)
+sample_mask()
+{
+  static std::atomic<uint32_t> mask{ 63 }; // NOLINT(build/unsigned)
+  return mask;
+}
+
+// Stamp one in period loaded messages, period rounded down to a power of two
+inline void
+set_sample_period(uint64_t period) // NOLINT(build/unsigned)
+{
+  uint32_t mask = 0; // NOLINT(build/unsigned)
+  while (mask < (1u << 31) - 1 && period >> 1 > mask) {
+    mask = (mask << 1) | 1;
+  }
+  sample_mask().store(mask, std::memory_order_relaxed);
+}
+
+// Counts the loads of the calling thread, true for the ones to stamp
+inline bool
+sample()
+{
+  thread_local uint32_t counter = 0; // NOLINT(build/unsigned)
+  return (++counter & sample_mask().load(std::memory_order_relaxed)) == 0;
+}
+
+/**
+ * Base of the type adapters: the time their message was loaded, 0 for the messages left out
+ * by sampling. Without NDREADOUTLIBS_LATENCY_STAMPS it is empty and takes no space in the
+ * adapter.
+ * */
+struct LoadStamp
+{
+#ifdef NDREADOUTLIBS_LATENCY_STAMPS
+  uint64_t load_ns = 0; // NOLINT(build/unsigned)
+
+  void stamp_load() { load_ns = sample() ? now_ns() : 0; }
+  uint64_t get_load_stamp() const { return load_ns; } // NOLINT(build/unsigned)
+#else
+  void stamp_load() {}
+  uint64_t get_load_stamp() const { return 0; } // NOLINT(build/unsigned)
+#endif
+};
+
+struct HistogramSummary
+{
+  uint64_t count = 0;   // NOLINT(build/unsigned)
+  uint64_t mean_ns = 0; // NOLINT(build/unsigned)
+  uint64_t p50_ns = 0;  // NOLINT(build/unsigned)
+  uint64_t p99_ns = 0;  // NOLINT(build/unsigned)
+  uint64_t p999_ns = 0; // NOLINT(build/unsigned)
+  uint64_t max_ns = 0;  // NOLINT(build/unsigned)
+};
+
+/**
+ * Log-linear histogram of durations in ns: every power of two is split into sub_buckets
+ * linear bins, so a percentile is known to within 1/sub_buckets of its value. Values below
+ * 2 * sub_buckets have a bin each.
+ *
+ * record() may be called from any thread, it is a relaxed increment of one bin. The counts
+ * are never reset, take() reports the difference since its previous call and is meant for a
+ * single (opmon) thread.
+ * */
+class LogLinearHistogram
+{
+public:
+  static const constexpr unsigned sub_bucket_bits = 4;
+  static const constexpr std::size_t sub_buckets = std::size_t(1) << sub_bucket_bits;
+  static const constexpr std::size_t num_buckets = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+  static std::size_t bucket(uint64_t value) // NOLINT(build/unsigned)
+  {
+    if (value < sub_buckets) {
+      return value;
+    }
+    unsigned msb = 63 - __builtin_clzll(value);
+    return (msb - sub_bucket_bits + 1) * sub_buckets + ((value >> (msb - sub_bucket_bits)) & (sub_buckets - 1));
+  }
+
+  // Largest value falling into bin i
+  static uint64_t bucket_upper_edge(std::size_t i) // NOLINT(build/unsigned)
+  {
+    if (i < sub_buckets) {
+      return i;
+    }
+    unsigned shift = i / sub_buckets - 1;
+    uint64_t lower = (sub_buckets + i % sub_buckets) << shift; // NOLINT(build/unsigned)
+    return lower + ((uint64_t(1) << shift) - 1);              // NOLINT(build/unsigned)
+  }
+
+  void record(uint64_t value_ns) // NOLINT(build/unsigned)
+  {
+    m_buckets[bucket(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value_ns, std::memory_order_relaxed);
+  }
+
+  // Record the time since the element was loaded, if it carries a load stamp
+  template<class T>
+  void record_since_load(const T& element)
+  {
+    if constexpr (enabled) {
+      auto stamp = element.get_load_stamp();
+      if (stamp != 0) {
+        auto now = now_ns();
+        record(now > stamp ? now - stamp : 0);
+      }
+    }
+  }
+
+  HistogramSummary take()
+  {
+    std::array<uint64_t, num_buckets> counts; // NOLINT(build/unsigned)
+    HistogramSummary summary;
+    for (std::size_t i = 0; i < num_buckets; ++i) {
+      auto now = m_buckets[i].load(std::memory_order_relaxed);
+      counts[i] = now - m_reported[i];
+      m_reported[i] = now;
+      summary.count += counts[i];
+    }
+    auto sum = m_sum.load(std::memory_order_relaxed);
+    if (summary.count != 0) {
+      summary.mean_ns = (sum - m_reported_sum) / summary.count;
+      summary.p50_ns = percentile(counts, summary.count, 0.50);
+      summary.p99_ns = percentile(counts, summary.count, 0.99);
+      summary.p999_ns = percentile(counts, summary.count, 0.999);
+      summary.max_ns = percentile(counts, summary.count, 1.);
+    }
+    m_reported_sum = sum;
+    return summary;
+  }
+
+private:
+  // Upper edge of the bin holding the given fraction of the values
+  static uint64_t percentile(const std::array<uint64_t, num_buckets>& counts, // NOLINT(build/unsigned)
+                             uint64_t total,                                  // NOLINT(build/unsigned)
+                             double fraction)
+  {
+    uint64_t seen = 0; // NOLINT(build/unsigned)
+    for (std::size_t i = 0; i < num_buckets; ++i) {
+      seen += counts[i];
+      if (counts[i] != 0 && seen >= fraction * total) {
+        return bucket_upper_edge(i);
+      }
+    }
+    return bucket_upper_edge(num_buckets - 1);
+  }
+
+  std::array<std::atomic<uint64_t>, num_buckets> m_buckets{}; // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_sum{ 0 };                            // NOLINT(build/unsigned)
+  std::array<uint64_t, num_buckets> m_reported{};              // NOLINT(build/unsigned)
+  uint64_t m_reported_sum = 0;                                 // NOLINT(build/unsigned)
+};
+
+} // namespace latency
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_LATENCYSTAMPS_HPP_
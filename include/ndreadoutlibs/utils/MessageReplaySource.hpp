@@ -0,0 +1,271 @@
+/**
+ * @file MessageReplaySource.hpp Replay of captured raw PACMAN and MPD messages at a given rate
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_MESSAGEREPLAYSOURCE_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_MESSAGEREPLAYSOURCE_HPP_
+
+#include "ndreadoutlibs/NDReadoutIssues.hpp"
+#include "ndreadoutlibs/NDReadoutPACMANTypeAdapter.hpp"
+#include "ndreadoutlibs/mpd/MPDMessageFormat.hpp"
+#include "ndreadoutlibs/pacman/PACMANMessageFormat.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace replay {
+
+// Size of the message starting at msg, 0 if it is malformed or does not fit in available bytes
+inline std::size_t
+pacman_message_size(const char* msg, std::size_t available)
+{
+  if (available < pacman::header_size) {
+    return 0;
+  }
+  std::size_t size = pacman::header_size + pacman::load_header_words(msg) * pacman::word_size;
+  return size <= available ? size : 0;
+}
+
+inline std::size_t
+mpd_frame_size(const char* msg, std::size_t available)
+{
+  if (available < mpd::device_header_size) {
+    return 0;
+  }
+  std::size_t size = mpd::declared_frame_size(msg);
+  return size <= available ? size : 0;
+}
+
+/**
+ * Rewrite the times of a PACMAN message so that it starts at ts DAQ ticks: the header gets
+ * the unix second of ts, receipt timestamps and LArPix data packet timestamps are shifted
+ * so that the first word and the earliest packet land on its sub-second part, keeping their
+ * spacing. Packets with correct parity keep it. Uses the clocks of the adapter config().
+ * */
+inline void
+stamp_pacman_message(char* msg, std::size_t size, uint64_t ts) // NOLINT(build/unsigned)
+{
+  if (size < pacman::header_size) {
+    return;
+  }
+  auto& cfg = types::NDReadoutPACMANTypeAdapter::config();
+  uint32_t unix_ts = ts / cfg.clock_frequency; // NOLINT(build/unsigned)
+  uint64_t subsecond = (ts % cfg.clock_frequency) * cfg.subsecond_clock_frequency / cfg.clock_frequency; // NOLINT
+  std::memcpy(msg + pacman::header_unix_ts_offset, &unix_ts, sizeof(unix_ts));
+
+  const uint64_t frequency = cfg.subsecond_clock_frequency; // NOLINT(build/unsigned)
+  std::size_t num_words = std::min<std::size_t>(pacman::load_header_words(msg), (size - pacman::header_size) / pacman::word_size);
+  if (num_words == 0) {
+    return;
+  }
+  uint64_t first_packet = frequency; // NOLINT(build/unsigned)
+  for (std::size_t i = 0; i < num_words; ++i) {
+    const char* word = msg + pacman::header_size + i * pacman::word_size;
+    uint64_t packet = pacman::load_packet(word); // NOLINT(build/unsigned)
+    if (types::NDReadoutPACMANTypeAdapter::is_data_packet(word, packet)) {
+      first_packet = std::min(first_packet, ((packet >> pacman::timestamp_shift) & pacman::timestamp_mask) % frequency);
+    }
+  }
+  uint64_t first_receipt = pacman::load_receipt_timestamp(msg + pacman::header_size) % frequency; // NOLINT
+  uint64_t packet_shift = (subsecond + frequency - first_packet % frequency) % frequency;          // NOLINT
+  uint64_t receipt_shift = (subsecond + frequency - first_receipt) % frequency;                    // NOLINT
+
+  for (std::size_t i = 0; i < num_words; ++i) {
+    char* word = msg + pacman::header_size + i * pacman::word_size;
+    uint32_t receipt = (pacman::load_receipt_timestamp(word) % frequency + receipt_shift) % frequency; // NOLINT
+    std::memcpy(word + pacman::word_timestamp_offset, &receipt, sizeof(receipt));
+    uint64_t packet = pacman::load_packet(word); // NOLINT(build/unsigned)
+    if (!types::NDReadoutPACMANTypeAdapter::is_data_packet(word, packet)) {
+      continue;
+    }
+    uint64_t count = (((packet >> pacman::timestamp_shift) & pacman::timestamp_mask) % frequency + packet_shift) % // NOLINT
+                     frequency;
+    packet &= ~((pacman::timestamp_mask << pacman::timestamp_shift) | (uint64_t(1) << pacman::parity_shift)); // NOLINT
+    packet |= count << pacman::timestamp_shift;
+    if (!pacman::parity_ok(packet)) {
+      packet |= uint64_t(1) << pacman::parity_shift; // NOLINT(build/unsigned)
+    }
+    std::memcpy(word + pacman::word_packet_offset, &packet, sizeof(packet));
+  }
+}
+
+struct ReplayStats
+{
+  uint64_t messages = 0; // NOLINT(build/unsigned)
+  uint64_t bytes = 0;    // NOLINT(build/unsigned)
+  uint64_t drops = 0;    // NOLINT(build/unsigned) messages refused by the sink
+  uint64_t loops = 0;    // NOLINT(build/unsigned) complete passes over the capture
+  uint64_t late = 0;     // NOLINT(build/unsigned) messages sent more than max_lag behind schedule
+  double seconds = 0.;
+};
+
+} // namespace replay
+
+/**
+ * @brief Loops over a capture file of back to back raw messages.
+ *
+ * The file is memory mapped and indexed once with the given framing function; trailing
+ * bytes that do not form a message are ignored. Every replayed message is loaded into a
+ * fresh ReadoutType through load_message(), as the receiver does, and gets a key from a
+ * perfectly increasing sequence before it is handed to the sink.
+ *
+ * With a stamper, every message is first copied and its payload times rewritten to its key,
+ * so that fragments and recordings agree with the keys (replay::stamp_pacman_message). There
+ * is none for MPD: the trigger timestamp layout of nddetdataformats::MPDFrame is not
+ * described in this package, so replayed MPD frames keep their captured timestamps.
+ * */
+template<class ReadoutType>
+class MessageReplaySource
+{
+public:
+  using timestamp_t = std::uint64_t; // NOLINT(build/unsigned)
+  using Framer = std::size_t (*)(const char*, std::size_t);
+  using Stamper = void (*)(char*, std::size_t, timestamp_t);
+
+  MessageReplaySource(const std::string& path, Framer framer, Stamper stamper = nullptr)
+    : m_path(path)
+    , m_stamper(stamper)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw ReplayFileError(ERS_HERE, path, "cannot open file");
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      throw ReplayFileError(ERS_HERE, path, "cannot stat file or file is empty");
+    }
+    m_size = st.st_size;
+    void* map = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+      throw ReplayFileError(ERS_HERE, path, "mmap failed");
+    }
+    m_data = static_cast<const char*>(map);
+
+    for (std::size_t offset = 0; offset < m_size;) {
+      std::size_t size = framer(m_data + offset, m_size - offset);
+      if (size == 0) {
+        break;
+      }
+      m_messages.emplace_back(offset, size);
+      offset += size;
+    }
+    if (m_messages.empty()) {
+      ::munmap(const_cast<char*>(m_data), m_size); // NOLINT
+      throw ReplayFileError(ERS_HERE, path, "no complete message found");
+    }
+  }
+
+  ~MessageReplaySource() { ::munmap(const_cast<char*>(m_data), m_size); } // NOLINT
+
+  MessageReplaySource(const MessageReplaySource&) = delete;
+  MessageReplaySource& operator=(const MessageReplaySource&) = delete;
+
+  // Keys handed out: first_ts, first_ts + step, ...
+  void set_timestamps(timestamp_t first_ts, timestamp_t step)
+  {
+    m_next_ts = first_ts;
+    m_ts_step = step;
+  }
+
+  // Messages sent later than this behind their scheduled time are counted as late
+  void set_max_lag(std::chrono::microseconds max_lag) { m_max_lag = max_lag; }
+
+  std::size_t num_messages() const { return m_messages.size(); }
+  std::size_t capture_size() const { return m_size; }
+
+  /**
+   * Send num_messages messages (0 for no limit) at rate messages per second (0 for as fast as
+   * possible), or until run becomes false. sink(ReadoutType&&) returns false to drop the
+   * message. Falling behind the schedule is not caught up with bursts beyond max_lag.
+   * */
+  template<class Sink>
+  replay::ReplayStats replay(uint64_t num_messages, // NOLINT(build/unsigned)
+                             double rate,
+                             Sink&& sink,
+                             const std::atomic<bool>& run)
+  {
+    replay::ReplayStats stats;
+    const auto start = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> period(rate > 0. ? 1. / rate : 0.);
+    auto schedule = start;
+    std::size_t index = 0;
+
+    while (run.load(std::memory_order_relaxed) && (num_messages == 0 || stats.messages < num_messages)) {
+      if (rate > 0.) {
+        schedule += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        auto now = std::chrono::steady_clock::now();
+        if (now < schedule) {
+          if (schedule - now > std::chrono::microseconds(50)) {
+            std::this_thread::sleep_until(schedule - std::chrono::microseconds(20));
+          }
+          while (std::chrono::steady_clock::now() < schedule) {
+          }
+        } else if (now - schedule > m_max_lag) {
+          ++stats.late;
+          schedule = now - m_max_lag;
+        }
+      }
+
+      const auto& message = m_messages[index];
+      const char* payload = m_data + message.first;
+      if (m_stamper != nullptr) {
+        m_scratch.assign(payload, payload + message.second);
+        m_stamper(m_scratch.data(), m_scratch.size(), m_next_ts);
+        payload = m_scratch.data();
+      }
+      ReadoutType element;
+      element.load_message(payload, message.second);
+      element.set_first_timestamp(m_next_ts);
+      m_next_ts += m_ts_step;
+      if (!sink(std::move(element))) {
+        ++stats.drops;
+      }
+      ++stats.messages;
+      stats.bytes += message.second;
+
+      if (++index == m_messages.size()) {
+        index = 0;
+        ++stats.loops;
+      }
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+  }
+
+private:
+  std::string m_path;
+  Stamper m_stamper;
+  // Copy of the message being stamped, the mapping is read only
+  std::vector<char> m_scratch;
+  const char* m_data = nullptr;
+  std::size_t m_size = 0;
+  std::vector<std::pair<std::size_t, std::size_t>> m_messages; // offset, size
+  timestamp_t m_next_ts = 1;
+  timestamp_t m_ts_step = 2500;
+  std::chrono::microseconds m_max_lag{ 1000 };
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_MESSAGEREPLAYSOURCE_HPP_
@@ -0,0 +1,358 @@
+/**
+ * @file PayloadPool.hpp Size-class slab pool for variable size ND message payloads
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_PAYLOADPOOL_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_PAYLOADPOOL_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+/**
+ * @brief Process wide pool of payload blocks, organised in power-of-two size classes.
+ *
+ * Blocks are carved out of slabs that are never given back to the system; a released
+ * block goes on the free list of its class and is handed out again by the next acquire.
+ * Popping an element from the latency buffer therefore recycles its payload instead of
+ * returning it to malloc.
+ * */
+class PayloadPool
+{
+public:
+  static const constexpr std::size_t min_block_shift = 8;  // 256 B
+  static const constexpr std::size_t max_block_shift = 20; // 1 MiB
+  static const constexpr std::size_t num_size_classes = max_block_shift - min_block_shift + 1;
+  static const constexpr std::size_t max_block_size = std::size_t(1) << max_block_shift;
+  static const constexpr std::size_t slab_size = 4 * max_block_size;
+
+  struct Stats
+  {
+    uint64_t bytes_in_use = 0;    // NOLINT(build/unsigned) payload bytes actually stored
+    uint64_t bytes_acquired = 0;  // NOLINT(build/unsigned) block bytes handed out
+    uint64_t bytes_reserved = 0;  // NOLINT(build/unsigned) slab bytes owned by the pool
+    uint64_t blocks_in_use = 0;   // NOLINT(build/unsigned)
+    uint64_t blocks_total = 0;    // NOLINT(build/unsigned)
+    uint64_t slab_allocations = 0; // NOLINT(build/unsigned)
+    uint64_t payload_copies = 0;   // NOLINT(build/unsigned) messages copied into pool blocks
+    uint64_t bytes_copied = 0;     // NOLINT(build/unsigned)
+    uint64_t payload_adoptions = 0; // NOLINT(build/unsigned) externally owned buffers adopted without copy
+    uint64_t oversized_copies = 0;  // NOLINT(build/unsigned) messages above max_block_size copied to the heap
+    std::array<uint64_t, num_size_classes> class_blocks_in_use{}; // NOLINT(build/unsigned)
+    std::array<uint64_t, num_size_classes> class_blocks_total{};  // NOLINT(build/unsigned)
+  };
+
+  static PayloadPool& instance()
+  {
+    static PayloadPool pool;
+    return pool;
+  }
+
+  static std::size_t size_class(std::size_t size)
+  {
+    std::size_t cls = 0;
+    while ((std::size_t(1) << (cls + min_block_shift)) < size) {
+      ++cls;
+    }
+    return cls;
+  }
+
+  static std::size_t block_size(std::size_t cls) { return std::size_t(1) << (cls + min_block_shift); }
+
+  /**
+   * Hand out a block able to hold size bytes, or nullptr if size exceeds max_block_size.
+   * The block size actually granted is returned in capacity.
+   * */
+  char* acquire(std::size_t size, std::size_t& capacity)
+  {
+    if (size > max_block_size) {
+      return nullptr;
+    }
+    auto cls = size_class(size);
+    auto& sc = m_classes[cls];
+    char* block = nullptr;
+    {
+      std::lock_guard<std::mutex> lk(sc.mutex);
+      if (sc.free_blocks.empty()) {
+        grow(cls, sc);
+      }
+      block = sc.free_blocks.back();
+      sc.free_blocks.pop_back();
+    }
+    capacity = block_size(cls);
+    sc.blocks_in_use.fetch_add(1, std::memory_order_relaxed);
+    m_bytes_acquired.fetch_add(capacity, std::memory_order_relaxed);
+    return block;
+  }
+
+  void release(char* block, std::size_t capacity)
+  {
+    if (block == nullptr) {
+      return;
+    }
+    auto cls = size_class(capacity);
+    auto& sc = m_classes[cls];
+    {
+      std::lock_guard<std::mutex> lk(sc.mutex);
+      sc.free_blocks.push_back(block);
+    }
+    sc.blocks_in_use.fetch_sub(1, std::memory_order_relaxed);
+    m_bytes_acquired.fetch_sub(capacity, std::memory_order_relaxed);
+  }
+
+  /**
+   * Make sure at least num_blocks blocks of the class holding size bytes exist up front.
+   * */
+  void reserve(std::size_t size, std::size_t num_blocks)
+  {
+    if (size > max_block_size) {
+      return;
+    }
+    auto cls = size_class(size);
+    auto& sc = m_classes[cls];
+    std::lock_guard<std::mutex> lk(sc.mutex);
+    while (sc.blocks_total.load(std::memory_order_relaxed) < num_blocks) {
+      grow(cls, sc);
+    }
+  }
+
+  // Payload bytes accounting, maintained by PayloadBuffer
+  void add_used_bytes(std::size_t bytes) { m_bytes_in_use.fetch_add(bytes, std::memory_order_relaxed); }
+  void sub_used_bytes(std::size_t bytes) { m_bytes_in_use.fetch_sub(bytes, std::memory_order_relaxed); }
+  void count_copy(std::size_t bytes)
+  {
+    m_payload_copies.fetch_add(1, std::memory_order_relaxed);
+    m_bytes_copied.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  void count_adoption() { m_payload_adoptions.fetch_add(1, std::memory_order_relaxed); }
+  void count_oversized() { m_oversized_copies.fetch_add(1, std::memory_order_relaxed); }
+
+  Stats get_stats() const
+  {
+    Stats stats;
+    stats.bytes_in_use = m_bytes_in_use.load(std::memory_order_relaxed);
+    stats.bytes_acquired = m_bytes_acquired.load(std::memory_order_relaxed);
+    stats.bytes_reserved = m_bytes_reserved.load(std::memory_order_relaxed);
+    stats.slab_allocations = m_slab_allocations.load(std::memory_order_relaxed);
+    stats.payload_copies = m_payload_copies.load(std::memory_order_relaxed);
+    stats.bytes_copied = m_bytes_copied.load(std::memory_order_relaxed);
+    stats.payload_adoptions = m_payload_adoptions.load(std::memory_order_relaxed);
+    stats.oversized_copies = m_oversized_copies.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < num_size_classes; ++i) {
+      stats.class_blocks_in_use[i] = m_classes[i].blocks_in_use.load(std::memory_order_relaxed);
+      stats.class_blocks_total[i] = m_classes[i].blocks_total.load(std::memory_order_relaxed);
+      stats.blocks_in_use += stats.class_blocks_in_use[i];
+      stats.blocks_total += stats.class_blocks_total[i];
+    }
+    return stats;
+  }
+
+  PayloadPool(const PayloadPool&) = delete;
+  PayloadPool& operator=(const PayloadPool&) = delete;
+  PayloadPool(PayloadPool&&) = delete;
+  PayloadPool& operator=(PayloadPool&&) = delete;
+
+private:
+  PayloadPool() = default;
+
+  struct SizeClass
+  {
+    std::mutex mutex;
+    std::vector<char*> free_blocks;
+    std::vector<std::unique_ptr<char[]>> slabs; // NOLINT(modernize-avoid-c-arrays)
+    std::atomic<uint64_t> blocks_total{ 0 };    // NOLINT(build/unsigned)
+    std::atomic<uint64_t> blocks_in_use{ 0 };   // NOLINT(build/unsigned)
+  };
+
+  // Called with the class mutex held
+  void grow(std::size_t cls, SizeClass& sc)
+  {
+    auto bsize = block_size(cls);
+    auto nblocks = slab_size / bsize;
+    sc.slabs.emplace_back(new char[nblocks * bsize]); // NOLINT(modernize-avoid-c-arrays)
+    char* slab = sc.slabs.back().get();
+    sc.free_blocks.reserve(sc.free_blocks.size() + nblocks);
+    for (std::size_t i = 0; i < nblocks; ++i) {
+      sc.free_blocks.push_back(slab + i * bsize);
+    }
+    sc.blocks_total.fetch_add(nblocks, std::memory_order_relaxed);
+    m_bytes_reserved.fetch_add(nblocks * bsize, std::memory_order_relaxed);
+    m_slab_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::array<SizeClass, num_size_classes> m_classes;
+  std::atomic<uint64_t> m_bytes_in_use{ 0 };     // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_bytes_acquired{ 0 };   // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_bytes_reserved{ 0 };   // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_slab_allocations{ 0 }; // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_payload_copies{ 0 };   // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_bytes_copied{ 0 };     // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_payload_adoptions{ 0 }; // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_oversized_copies{ 0 };  // NOLINT(build/unsigned)
+};
+
+/**
+ * @brief Owning handle on a PayloadPool block, holding size() valid bytes.
+ *
+ * Alternatively the buffer can adopt memory owned by someone else (e.g. the receiver's
+ * message), in which case it only keeps a reference on the owner.
+ * Copies are deep (a new block is acquired), moves transfer the block or the owner.
+ * */
+class PayloadBuffer
+{
+public:
+  PayloadBuffer() = default;
+
+  explicit PayloadBuffer(std::size_t size, bool zero_fill = false)
+  {
+    if (allocate(size) && zero_fill) {
+      std::memset(m_data, 0, size);
+    }
+  }
+
+  PayloadBuffer(const PayloadBuffer& other)
+  {
+    assign(other.m_data, other.m_size);
+  }
+
+  PayloadBuffer& operator=(const PayloadBuffer& other)
+  {
+    if (this != &other) {
+      assign(other.m_data, other.m_size);
+    }
+    return *this;
+  }
+
+  PayloadBuffer(PayloadBuffer&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+    , m_capacity(std::exchange(other.m_capacity, 0))
+    , m_owner(std::move(other.m_owner))
+  {}
+
+  PayloadBuffer& operator=(PayloadBuffer&& other) noexcept
+  {
+    if (this != &other) {
+      reset();
+      m_data = std::exchange(other.m_data, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+      m_capacity = std::exchange(other.m_capacity, 0);
+      m_owner = std::move(other.m_owner);
+    }
+    return *this;
+  }
+
+  ~PayloadBuffer() { reset(); }
+
+  /**
+   * Copy size bytes from src, reusing the current block when it is large enough. Sizes above
+   * the largest block of the pool get a heap buffer owned by this buffer alone.
+   * */
+  void assign(const void* src, std::size_t size)
+  {
+    if (m_owner || size > m_capacity) {
+      reset();
+      if (!allocate(size)) {
+        allocate_oversized(size);
+      }
+    } else {
+      set_size(size);
+    }
+    if (size > 0) {
+      std::memcpy(m_data, src, size);
+      PayloadPool::instance().count_copy(size);
+    }
+  }
+
+  /**
+   * Point at size bytes at data without copying them. The owner is kept alive until the
+   * buffer is reset or destroyed, and is then dropped (running its deleter if it was the
+   * last reference).
+   * */
+  void adopt(char* data, std::size_t size, std::shared_ptr<void> owner)
+  {
+    reset();
+    m_data = data;
+    m_size = size;
+    m_owner = std::move(owner);
+    PayloadPool::instance().count_adoption();
+  }
+
+  bool is_adopted() const { return static_cast<bool>(m_owner); }
+
+  void reset()
+  {
+    if (m_owner) {
+      m_owner.reset();
+    } else if (m_data != nullptr) {
+      auto& pool = PayloadPool::instance();
+      pool.sub_used_bytes(m_size);
+      pool.release(m_data, m_capacity);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_capacity = 0;
+  }
+
+  char* data() { return m_data; }
+  const char* data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+  std::size_t capacity() const { return m_capacity; }
+  bool empty() const { return m_size == 0; }
+
+  char& operator[](std::size_t i) { return m_data[i]; }             // NOLINT
+  const char& operator[](std::size_t i) const { return m_data[i]; } // NOLINT
+
+private:
+  bool allocate(std::size_t size)
+  {
+    m_data = PayloadPool::instance().acquire(size, m_capacity);
+    if (m_data == nullptr) {
+      m_capacity = 0;
+      return false;
+    }
+    m_size = size;
+    PayloadPool::instance().add_used_bytes(size);
+    return true;
+  }
+
+  // Released with the owner, like an adopted buffer
+  void allocate_oversized(std::size_t size)
+  {
+    std::shared_ptr<char[]> block(new char[size]); // NOLINT(modernize-avoid-c-arrays)
+    m_data = block.get();
+    m_size = size;
+    m_owner = std::move(block);
+    PayloadPool::instance().count_oversized();
+  }
+
+  void set_size(std::size_t size)
+  {
+    auto& pool = PayloadPool::instance();
+    pool.sub_used_bytes(m_size);
+    pool.add_used_bytes(size);
+    m_size = size;
+  }
+
+  char* m_data = nullptr;
+  std::size_t m_size = 0;
+  std::size_t m_capacity = 0;
+  std::shared_ptr<void> m_owner;
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_PAYLOADPOOL_HPP_
@@ -0,0 +1,157 @@
+/**
+ * @file SPSCWorkerPool.hpp Worker threads fed by one single producer queue each
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_SPSCWORKERPOOL_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_SPSCWORKERPOOL_HPP_
+
+#include <folly/ProducerConsumerQueue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+/**
+ * @brief Fixed set of worker threads, each draining its own folly::ProducerConsumerQueue.
+ *
+ * Jobs are pushed by a single producer thread (a processing pipeline stage) into the queue of
+ * the worker it picks, so no locks are taken on the way in. A full queue refuses the job
+ * instead of blocking the producer. stop() lets every worker drain its queue before joining,
+ * including jobs of a dispatch() running concurrently with it: a job is either refused or run.
+ * The queues are allocated once by allocate() and kept across start() and stop(), so that
+ * num_workers() and get_queued() can be read from any thread while the pool runs or restarts.
+ * Workers can be pinned, worker i to cpus[i % cpus.size()].
+ * */
+template<class Job>
+class SPSCWorkerPool
+{
+public:
+  using Handler = std::function<void(std::size_t worker, Job& job)>;
+
+  SPSCWorkerPool() = default;
+  ~SPSCWorkerPool() { stop(); }
+  SPSCWorkerPool(const SPSCWorkerPool&) = delete;
+  SPSCWorkerPool& operator=(const SPSCWorkerPool&) = delete;
+
+  // One queue per worker; ignored while the pool runs
+  void allocate(std::size_t num_workers, std::size_t queue_size)
+  {
+    if (m_running.load()) {
+      return;
+    }
+    m_queues.clear();
+    for (std::size_t i = 0; i < num_workers; ++i) {
+      m_queues.emplace_back(std::make_unique<folly::ProducerConsumerQueue<Job>>(queue_size));
+    }
+  }
+
+  // One worker per allocated queue
+  void start(const std::string& name, Handler handler, const std::vector<int>& cpus = {})
+  {
+    if (m_running.load()) {
+      return;
+    }
+    m_handler = std::move(handler);
+    m_run_marker.store(true);
+    for (std::size_t i = 0; i < m_queues.size(); ++i) {
+      m_threads.emplace_back(&SPSCWorkerPool::run, this, i);
+      pthread_setname_np(m_threads.back().native_handle(), (name + "-" + std::to_string(i)).substr(0, 15).c_str());
+      if (!cpus.empty()) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpus[i % cpus.size()], &cpuset);
+        pthread_setaffinity_np(m_threads.back().native_handle(), sizeof(cpu_set_t), &cpuset);
+      }
+    }
+    m_running.store(true);
+  }
+
+  // Joins the workers once their queues are empty
+  void stop()
+  {
+    if (!m_running.exchange(false)) {
+      return;
+    }
+    // A dispatch() that saw the pool running gets its job in before the workers drain
+    while (m_dispatching.load() != 0) {
+      std::this_thread::yield();
+    }
+    m_run_marker.store(false);
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+    m_threads.clear();
+  }
+
+  // Producer side only. Returns false if the worker queue is full or the pool is stopped.
+  bool dispatch(std::size_t worker, Job&& job)
+  {
+    m_dispatching.fetch_add(1);
+    bool written = m_running.load() && m_queues[worker]->write(std::move(job));
+    m_dispatching.fetch_sub(1);
+    return written;
+  }
+
+  bool is_running() const { return m_running.load(); }
+  std::size_t num_workers() const { return m_queues.size(); }
+
+  std::size_t get_queued() const
+  {
+    std::size_t queued = 0;
+    for (auto& queue : m_queues) {
+      queued += queue->sizeGuess();
+    }
+    return queued;
+  }
+
+private:
+  static constexpr std::chrono::microseconds min_backoff{ 10 };
+  static constexpr std::chrono::microseconds max_backoff{ 500 };
+
+  void run(std::size_t worker)
+  {
+    auto& queue = *m_queues[worker];
+    Job job;
+    // Idle workers back off, so that many workers on few cores do not poll each other away
+    std::chrono::microseconds backoff(min_backoff);
+    while (true) {
+      if (queue.read(job)) {
+        m_handler(worker, job);
+        backoff = min_backoff;
+      } else if (m_run_marker.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(backoff);
+        backoff = std::min(backoff * 2, max_backoff);
+      } else if (queue.isEmpty()) {
+        return;
+      }
+    }
+  }
+
+  Handler m_handler;
+  std::atomic<bool> m_running{ false };
+  std::atomic<bool> m_run_marker{ false };
+  std::atomic<int> m_dispatching{ 0 };
+  std::vector<std::unique_ptr<folly::ProducerConsumerQueue<Job>>> m_queues;
+  std::vector<std::thread> m_threads;
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_SPSCWORKERPOOL_HPP_
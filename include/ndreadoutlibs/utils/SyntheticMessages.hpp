@@ -0,0 +1,85 @@
+/**
+ * @file SyntheticMessages.hpp Synthetic PACMAN and MPD messages for benchmarks and emulation
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_SYNTHETICMESSAGES_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_SYNTHETICMESSAGES_HPP_
+
+#include "nddetdataformats/MPDFrame.hpp"
+#include "nddetdataformats/PACMANFrame.hpp"
+#include "ndreadoutlibs/NDReadoutPACMANTypeAdapter.hpp"
+#include "ndreadoutlibs/mpd/MPDMessageFormat.hpp"
+#include "ndreadoutlibs/pacman/PACMANMessageFormat.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+namespace synthetic {
+
+/**
+ * PACMAN data message with num_words data words. Receipt and packet timestamps start at
+ * first_ts and increase by ts_step per word; I/O channels, chips and channels are random.
+ * */
+inline std::vector<char>
+make_pacman_message(uint32_t unix_ts,   // NOLINT(build/unsigned)
+                    uint16_t num_words, // NOLINT(build/unsigned)
+                    uint32_t first_ts,  // NOLINT(build/unsigned)
+                    uint32_t ts_step,   // NOLINT(build/unsigned)
+                    std::mt19937& rng)
+{
+  std::vector<char> msg(types::PACMAN_MSG_HEADER_SIZE + num_words * types::PACMAN_MSG_WORD_SIZE, 0);
+  auto frame = reinterpret_cast<const nddetdataformats::PACMANFrame*>(msg.data()); // NOLINT
+  auto header = frame->get_msg_header(msg.data());
+  header->type = 'D';
+  header->unix_ts = unix_ts;
+  header->words = num_words;
+
+  std::uniform_int_distribution<uint32_t> io_channel(1, 32); // NOLINT(build/unsigned)
+  std::uniform_int_distribution<uint32_t> byte(0, 255);      // NOLINT(build/unsigned)
+  for (uint16_t i = 0; i < num_words; ++i) { // NOLINT(build/unsigned)
+    char* word = reinterpret_cast<char*>(frame->get_msg_word(msg.data(), i)); // NOLINT
+    uint32_t ts = first_ts + i * ts_step;                                      // NOLINT(build/unsigned)
+    word[pacman::word_type_offset] = static_cast<char>(pacman::data_word_type);
+    word[pacman::word_channel_offset] = static_cast<char>(io_channel(rng));
+    std::memcpy(word + pacman::word_timestamp_offset, &ts, sizeof(ts));
+    uint64_t packet = pacman::encode_data_packet(byte(rng), byte(rng) % 64, ts, byte(rng)); // NOLINT(build/unsigned)
+    std::memcpy(word + pacman::word_packet_offset, &packet, sizeof(packet));
+  }
+  return msg;
+}
+
+/**
+ * MPD frame of the given size (at least sizeof(MPDFrame)) with a consistent device header,
+ * filled with random sample bytes. The frame timestamp is not meaningful, callers set the
+ * adapter key explicitly.
+ * */
+inline std::vector<char>
+make_mpd_frame(std::size_t size, std::mt19937& rng)
+{
+  if (size < sizeof(nddetdataformats::MPDFrame)) {
+    size = sizeof(nddetdataformats::MPDFrame);
+  }
+  std::vector<char> frame(size, 0);
+  std::uniform_int_distribution<int> byte(0, 255);
+  for (std::size_t i = sizeof(nddetdataformats::MPDFrame); i < size; ++i) {
+    frame[i] = static_cast<char>(byte(rng));
+  }
+  uint32_t sync = mpd::default_sync_word;                             // NOLINT(build/unsigned)
+  uint32_t length = (size - mpd::device_header_size) & mpd::length_mask; // NOLINT(build/unsigned)
+  std::memcpy(frame.data() + mpd::sync_offset, &sync, sizeof(sync));
+  std::memcpy(frame.data() + mpd::length_offset, &length, sizeof(length));
+  return frame;
+}
+
+} // namespace synthetic
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_SYNTHETICMESSAGES_HPP_
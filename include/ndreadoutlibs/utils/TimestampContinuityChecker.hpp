@@ -0,0 +1,147 @@
+/**
+ * @file TimestampContinuityChecker.hpp Timestamp continuity stage shared by the ND frame processors
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_TIMESTAMPCONTINUITYCHECKER_HPP_
+#define NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_TIMESTAMPCONTINUITYCHECKER_HPP_
+
+#include "ndreadoutlibs/ndreadoutinfo/InfoNljs.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace dunedaq {
+namespace ndreadoutlibs {
+
+/**
+ * Classifies the timestamp of every frame against its predecessor: duplicates, regressions
+ * and gaps above a threshold (0 disables gap detection). Inter-frame deltas go into a log2
+ * histogram: bin 0 holds duplicates and regressions, bin k deltas in [2^(k-1), 2^k).
+ *
+ * check() runs on the processing thread only, counters are published with relaxed atomics
+ * and never reset by the reader, so the hot path has no read-modify-write instructions.
+ * get_info() reports the difference since its previous call.
+ * */
+template<class ReadoutType>
+class TimestampContinuityChecker
+{
+public:
+  using timestamp_t = std::uint64_t; // NOLINT(build/unsigned)
+
+  enum Result
+  {
+    kOk = 0,
+    kFirst,
+    kDuplicate,
+    kRegression,
+    kGap,
+    kNumResults
+  };
+
+  static const constexpr std::size_t num_delta_bins = 65;
+
+  explicit TimestampContinuityChecker(timestamp_t gap_threshold = 0)
+    : m_gap_threshold(gap_threshold)
+  {}
+
+  void set_gap_threshold(timestamp_t gap_threshold) { m_gap_threshold = gap_threshold; }
+
+  Result check(timestamp_t ts)
+  {
+    timestamp_t delta = ts - m_previous_ts;
+    bool forward = ts > m_previous_ts;
+    Result result = forward ? ((m_gap_threshold != 0 && delta > m_gap_threshold) ? kGap : kOk)
+                            : (ts == m_previous_ts ? kDuplicate : kRegression);
+    result = m_has_previous ? result : kFirst;
+    std::size_t bin = forward ? 64 - __builtin_clzll(delta) : 0;
+
+    increment(m_results[result]);
+    increment(m_delta_histogram[bin]);
+    m_previous_ts = ts;
+    m_has_previous = true;
+    return result;
+  }
+
+  Result operator()(const ReadoutType* fp) { return check(fp->get_timestamp()); }
+
+  // Forget the previous timestamp, e.g. at the start of a run
+  void reset_previous() { m_has_previous = false; }
+
+  timestamp_t get_previous_timestamp() const { return m_previous_ts; }
+
+  static bool is_error(Result result) { return result == kDuplicate || result == kRegression; }
+
+  // Counters since the previous call; to be called from a single (opmon) thread
+  ndreadoutinfo::TimestampContinuityInfo get_info()
+  {
+    std::array<uint64_t, kNumResults> results;       // NOLINT(build/unsigned)
+    std::array<uint64_t, num_delta_bins> histogram; // NOLINT(build/unsigned)
+    uint64_t frames = 0;                             // NOLINT(build/unsigned)
+    for (std::size_t i = 0; i < kNumResults; ++i) {
+      auto now = m_results[i].load(std::memory_order_relaxed);
+      results[i] = now - m_reported_results[i];
+      m_reported_results[i] = now;
+      frames += results[i];
+    }
+    uint64_t forward_deltas = 0; // NOLINT(build/unsigned)
+    for (std::size_t i = 0; i < num_delta_bins; ++i) {
+      auto now = m_delta_histogram[i].load(std::memory_order_relaxed);
+      histogram[i] = now - m_reported_histogram[i];
+      m_reported_histogram[i] = now;
+      forward_deltas += i ? histogram[i] : 0;
+    }
+
+    ndreadoutinfo::TimestampContinuityInfo info;
+    info.frames = frames;
+    info.duplicates = results[kDuplicate];
+    info.regressions = results[kRegression];
+    info.gaps = results[kGap];
+    info.delta_p50_ticks = delta_percentile(histogram, forward_deltas, 0.50);
+    info.delta_p99_ticks = delta_percentile(histogram, forward_deltas, 0.99);
+    info.delta_max_ticks = delta_percentile(histogram, forward_deltas, 1.);
+    return info;
+  }
+
+private:
+  static void increment(std::atomic<uint64_t>& counter) // NOLINT(build/unsigned)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  // Upper edge of the histogram bin holding the given fraction of the forward deltas
+  static uint64_t delta_percentile(const std::array<uint64_t, num_delta_bins>& histogram, // NOLINT(build/unsigned)
+                                   uint64_t total,                                        // NOLINT(build/unsigned)
+                                   double fraction)
+  {
+    if (total == 0) {
+      return 0;
+    }
+    uint64_t seen = 0; // NOLINT(build/unsigned)
+    for (std::size_t i = 1; i < num_delta_bins; ++i) {
+      seen += histogram[i];
+      if (seen >= fraction * total) {
+        return i == 64 ? ~uint64_t(0) : (uint64_t(1) << i) - 1; // NOLINT(build/unsigned)
+      }
+    }
+    return ~uint64_t(0); // NOLINT(build/unsigned)
+  }
+
+  timestamp_t m_previous_ts = 0;
+  bool m_has_previous = false;
+  timestamp_t m_gap_threshold;
+
+  std::array<std::atomic<uint64_t>, kNumResults> m_results{};           // NOLINT(build/unsigned)
+  std::array<std::atomic<uint64_t>, num_delta_bins> m_delta_histogram{}; // NOLINT(build/unsigned)
+  std::array<uint64_t, kNumResults> m_reported_results{};                // NOLINT(build/unsigned)
+  std::array<uint64_t, num_delta_bins> m_reported_histogram{};           // NOLINT(build/unsigned)
+};
+
+} // namespace ndreadoutlibs
+} // namespace dunedaq
+
+#endif // NDREADOUTLIBS_INCLUDE_NDREADOUTLIBS_UTILS_TIMESTAMPCONTINUITYCHECKER_HPP_
@@ -0,0 +1,207 @@
+/**
+ * @file bench_adapters_app.cxx Ingestion, key extraction and comparison cost of the ND type adapters
+ *
+ * Usage: ndreadoutlibs_bench_adapters [--messages N] [--fixed-messages N] [--pacman-words W]
+ *                                     [--mpd-size B] [--output file.json]
+ *
+ * allocs_per_msg counts the calls to operator new during ingestion. copies_per_msg and
+ * bytes_copied_per_msg come from the payload pool, so they miss the copy into the inline MPD
+ * adapter.
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/NDReadoutMPDInlineTypeAdapter.hpp"
+#include "ndreadoutlibs/NDReadoutMPDTypeAdapter.hpp"
+#include "ndreadoutlibs/NDReadoutPACMANTypeAdapter.hpp"
+#include "ndreadoutlibs/utils/BenchmarkReport.hpp"
+#include "ndreadoutlibs/utils/PayloadPool.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::benchmark;
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{ 0 }; // NOLINT(build/unsigned)
+
+} // namespace
+
+// Counting replacements of the global allocation functions. GCC pairs the inlined free()
+// with the new-expression at each call site, so its mismatch warning does not apply here.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void*
+operator new(std::size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size)) { // NOLINT
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+  std::free(p); // NOLINT
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p); // NOLINT
+}
+
+namespace {
+
+const constexpr uint64_t batch_size = 64; // NOLINT(build/unsigned)
+const constexpr std::size_t window_size = 4096;
+// Fixed frame adapters hold PACMAN_FRAME_SIZE each, keep their window small
+const constexpr std::size_t fixed_window_size = 256;
+
+/**
+ * Ingest num_messages copies of message into a rolling window of adapters, as the
+ * latency buffer would keep them, and report rate and payload copies per message.
+ * */
+template<class Adapter, class Ingest>
+void
+bench_ingest(BenchmarkReport& report,
+             const std::string& name,
+             uint64_t num_messages, // NOLINT(build/unsigned)
+             const std::vector<char>& message,
+             std::size_t window_entries,
+             Ingest&& ingest)
+{
+  std::vector<Adapter> window(window_entries);
+  // Receiver side buffers are refilled outside of the timed region
+  std::vector<std::vector<char>> received(batch_size);
+  LatencySampler samples;
+  auto before = PayloadPool::instance().get_stats();
+  uint64_t allocations = 0; // NOLINT(build/unsigned)
+  double seconds = 0.;
+  for (uint64_t first = 0; first < num_messages; first += batch_size) { // NOLINT(build/unsigned)
+    for (auto& buffer : received) {
+      buffer = message;
+    }
+    auto count = std::min(batch_size, num_messages - first);
+    auto allocations_before = g_allocations.load(std::memory_order_relaxed);
+    seconds += time_batches(count, count, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+      Adapter adapter;
+      ingest(adapter, received[i]);
+      window[(first + i) % window_entries] = std::move(adapter);
+    });
+    allocations += g_allocations.load(std::memory_order_relaxed) - allocations_before;
+  }
+  auto after = PayloadPool::instance().get_stats();
+  auto& result = report.add(name, { { "message_size", message.size() } }, num_messages, seconds, samples);
+  result["copies_per_msg"] = static_cast<double>(after.payload_copies - before.payload_copies) / num_messages;
+  result["bytes_copied_per_msg"] = static_cast<double>(after.bytes_copied - before.bytes_copied) / num_messages;
+  result["allocs_per_msg"] = static_cast<double>(allocations) / num_messages;
+}
+
+template<class Adapter>
+void
+bench_compare(BenchmarkReport& report, const std::string& name, std::vector<Adapter>& adapters, uint64_t num_ops) // NOLINT
+{
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<std::size_t> pick(0, adapters.size() - 1);
+  std::vector<std::pair<std::size_t, std::size_t>> pairs(4096);
+  for (auto& p : pairs) {
+    p = { pick(rng), pick(rng) };
+  }
+  LatencySampler samples;
+  uint64_t less = 0; // NOLINT(build/unsigned)
+  auto seconds = time_batches(num_ops, batch_size, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+    auto& p = pairs[i % pairs.size()];
+    less += adapters[p.first] < adapters[p.second];
+  });
+  auto& result = report.add(name, { { "entries", adapters.size() } }, num_ops, seconds, samples);
+  result["checksum"] = less;
+}
+
+template<class Adapter>
+void
+bench_decode(BenchmarkReport& report, const std::string& name, std::vector<Adapter>& adapters, uint64_t num_ops) // NOLINT
+{
+  LatencySampler samples;
+  uint64_t sum = 0; // NOLINT(build/unsigned)
+  auto seconds = time_batches(num_ops, batch_size, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+    sum += adapters[i % adapters.size()].decode_timestamp();
+  });
+  auto& result = report.add(name, { { "entries", adapters.size() } }, num_ops, seconds, samples);
+  result["checksum"] = sum;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  BenchmarkOptions opts(argc, argv);
+  auto num_messages = opts.get("messages", 1000000);
+  auto num_fixed_messages = opts.get("fixed-messages", 10000);
+  uint16_t pacman_words = opts.get("pacman-words", 256); // NOLINT(build/unsigned)
+  auto mpd_size = opts.get("mpd-size", 4096);
+
+  BenchmarkReport report("adapters");
+  std::mt19937 rng(12345);
+  auto pacman_msg = synthetic::make_pacman_message(1700000000, pacman_words, 0, 10, rng);
+  auto mpd_msg = synthetic::make_mpd_frame(mpd_size, rng);
+  auto& pacman_config = types::NDReadoutPACMANTypeAdapter::config();
+
+  // load_message() / adopt_message() throughput
+  auto load = [](auto& adapter, std::vector<char>& received) { adapter.load_message(received.data(), received.size()); };
+  auto adopt = [](auto& adapter, std::vector<char>& received) { adapter.adopt_message(std::move(received)); };
+
+  pacman_config.storage_mode = types::PACMANStorageMode::kFixedFrame;
+  bench_ingest<types::NDReadoutPACMANTypeAdapter>(report, "pacman_load_message_fixed", num_fixed_messages, pacman_msg, fixed_window_size, load);
+  pacman_config.storage_mode = types::PACMANStorageMode::kPooled;
+  bench_ingest<types::NDReadoutPACMANTypeAdapter>(report, "pacman_load_message_pooled", num_messages, pacman_msg, window_size, load);
+  bench_ingest<types::NDReadoutPACMANTypeAdapter>(report, "pacman_adopt_message", num_messages, pacman_msg, window_size, adopt);
+  bench_ingest<types::NDReadoutMPDTypeAdapter>(report, "mpd_load_message", num_messages, mpd_msg, window_size, load);
+  bench_ingest<types::NDReadoutMPDTypeAdapter>(report, "mpd_adopt_message", num_messages, mpd_msg, window_size, adopt);
+  bench_ingest<types::NDReadoutMPDInlineTypeAdapter>(report, "mpd_inline_load_message", num_messages, mpd_msg, window_size, load);
+
+  // Key extraction and comparison on a buffer-sized population
+  std::vector<types::NDReadoutPACMANTypeAdapter> pacman_adapters(window_size);
+  std::vector<types::NDReadoutMPDTypeAdapter> mpd_adapters(window_size);
+  std::vector<types::NDReadoutMPDInlineTypeAdapter> mpd_inline_adapters(window_size);
+  for (std::size_t i = 0; i < window_size; ++i) {
+    auto msg = synthetic::make_pacman_message(1700000000 + i / 100, pacman_words, (i % 100) * 100000, 10, rng);
+    pacman_adapters[i].load_message(msg.data(), msg.size());
+    mpd_adapters[i].load_message(mpd_msg.data(), mpd_msg.size());
+    mpd_adapters[i].set_first_timestamp(i * 1000);
+    mpd_inline_adapters[i].load_message(mpd_msg.data(), mpd_msg.size());
+    mpd_inline_adapters[i].set_first_timestamp(i * 1000);
+  }
+
+  const std::vector<std::pair<std::string, types::PACMANTimestampMode>> modes = {
+    { "unix", types::PACMANTimestampMode::kUnixSeconds },
+    { "receipt", types::PACMANTimestampMode::kReceiptTimestamp },
+    { "packet", types::PACMANTimestampMode::kPacketTimestamp },
+    { "range", types::PACMANTimestampMode::kPacketRange },
+  };
+  for (auto& mode : modes) {
+    pacman_config.timestamp_mode = mode.second;
+    bench_decode(report, "pacman_decode_timestamp_" + mode.first, pacman_adapters, num_messages);
+  }
+  bench_decode(report, "mpd_decode_timestamp", mpd_adapters, num_messages);
+  bench_decode(report, "mpd_inline_decode_timestamp", mpd_inline_adapters, num_messages);
+  bench_compare(report, "pacman_compare", pacman_adapters, num_messages);
+  bench_compare(report, "mpd_compare", mpd_adapters, num_messages);
+  bench_compare(report, "mpd_inline_compare", mpd_inline_adapters, num_messages);
+
+  report.write(opts.get_string("output", "-"));
+  return 0;
+}
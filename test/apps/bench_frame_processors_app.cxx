@@ -0,0 +1,96 @@
+/**
+ * @file bench_frame_processors_app.cxx Preprocess pipeline rate of the MPD and PACMAN frame processors
+ *
+ * Usage: ndreadoutlibs_bench_frame_processors [--messages N] [--pacman-words W] [--mpd-size B]
+ *                                             [--output file.json]
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/mpd/MPDFrameProcessor.hpp"
+#include "ndreadoutlibs/pacman/PACMANFrameProcessor.hpp"
+#include "ndreadoutlibs/utils/BenchmarkReport.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::benchmark;
+
+namespace {
+
+const constexpr uint64_t batch_size = 64; // NOLINT(build/unsigned)
+const constexpr std::size_t num_distinct = 4096;
+
+template<class Processor, class Adapter>
+void
+bench_pipeline(BenchmarkReport& report,
+               const std::string& name,
+               const nlohmann::json& args,
+               std::vector<Adapter>& adapters,
+               uint64_t num_messages) // NOLINT(build/unsigned)
+{
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  Processor processor(error_registry);
+  processor.conf(args);
+
+  LatencySampler samples;
+  auto seconds = time_batches(num_messages, batch_size, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+    processor.preprocess_item(&adapters[i % adapters.size()]);
+  });
+  report.add(name, args, num_messages, seconds, samples);
+  processor.scrap(args);
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  BenchmarkOptions opts(argc, argv);
+  auto num_messages = opts.get("messages", 10000000);
+  uint16_t pacman_words = opts.get("pacman-words", 256); // NOLINT(build/unsigned)
+  auto mpd_size = opts.get("mpd-size", 4096);
+
+  BenchmarkReport report("frame_processors");
+  std::mt19937 rng(12345);
+
+  nlohmann::json args = { { "rawdataprocessorconf",
+                            { { "source_id", 0 }, { "clock_speed_hz", 50000000 }, { "emulator_mode", false } } },
+                          { "ndreadoutconf", { { "pacman_storage_mode", "pooled" } } } };
+
+  // Increasing timestamps within the population, as from a live link
+  std::vector<types::NDReadoutMPDTypeAdapter> mpd_adapters(num_distinct);
+  auto mpd_msg = synthetic::make_mpd_frame(mpd_size, rng);
+  for (std::size_t i = 0; i < num_distinct; ++i) {
+    mpd_adapters[i].load_message(mpd_msg.data(), mpd_msg.size());
+    mpd_adapters[i].set_first_timestamp(1000 + i * 1000);
+  }
+  bench_pipeline<MPDFrameProcessor>(report, "mpd_preprocess", args, mpd_adapters, num_messages);
+
+  for (const std::string mode : { "unix", "receipt", "unix_nocheck" }) {
+    // The word check stage dominates, also measure the pipeline without it
+    args["ndreadoutconf"]["pacman_word_check"] = mode != "unix_nocheck";
+    args["ndreadoutconf"]["pacman_timestamp_mode"] = mode == "receipt" ? "receipt" : "unix";
+    std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+    // Configure once so that the adapters decode their keys in the requested mode
+    PACMANFrameProcessor(error_registry).conf(args);
+    std::vector<types::NDReadoutPACMANTypeAdapter> pacman_adapters(num_distinct);
+    for (std::size_t i = 0; i < num_distinct; ++i) {
+      auto msg = synthetic::make_pacman_message(1700000000 + i / 1000, pacman_words, (i % 1000) * 50000, 10, rng);
+      pacman_adapters[i].load_message(msg.data(), msg.size());
+    }
+    bench_pipeline<PACMANFrameProcessor>(report, "pacman_preprocess_" + mode, args, pacman_adapters, num_messages);
+  }
+
+  report.write(opts.get_string("output", "-"));
+  return 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file bench_hit_extraction_app.cxx LArPix hit extraction rate, single threaded and through
+ *                                    the PACMAN frame processor workers
+ *
+ * Usage: ndreadoutlibs_bench_hit_extraction [--messages N] [--pacman-words W] [--workers 1,2,4,8,16]
+ *                                           [--shard-key io_channel|chip] [--pin 0|1]
+ *                                           [--link-gbps G] [--output file.json]
+ *
+ * The processor runs the word check and hit extraction, once in serial mode (word check in
+ * the preprocess pipeline, whole messages per worker) and once in sharded mode (words split
+ * between the workers) for every worker count. With --pin worker i is pinned to CPU i.
+ * link_rate_fraction compares the processed message bytes per second with a PACMAN link of
+ * the given rate; values above 1 mean the processing keeps up with the link.
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/pacman/LArPixHitExtractor.hpp"
+#include "ndreadoutlibs/pacman/PACMANFrameProcessor.hpp"
+#include "ndreadoutlibs/utils/BenchmarkReport.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::benchmark;
+
+namespace {
+
+const constexpr uint64_t batch_size = 64; // NOLINT(build/unsigned)
+const constexpr std::size_t num_distinct = 4096;
+
+void
+add_rates(nlohmann::json& result, uint64_t messages, uint64_t hits, uint64_t bytes, double seconds, double link_gbps) // NOLINT
+{
+  double bytes_per_s = seconds > 0. ? bytes / seconds : 0.;
+  result["decoded_messages"] = messages;
+  result["hits"] = hits;
+  result["hits_per_s"] = seconds > 0. ? hits / seconds : 0.;
+  result["mbytes_per_s"] = bytes_per_s / 1e6;
+  result["link_rate_fraction"] = bytes_per_s * 8 / (link_gbps * 1e9);
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  BenchmarkOptions opts(argc, argv);
+  auto num_messages = opts.get("messages", 1000000);
+  uint16_t pacman_words = opts.get("pacman-words", 256); // NOLINT(build/unsigned)
+  auto worker_counts = opts.get_list("workers", { 1, 2, 4, 8, 16 });
+  std::string shard_key = opts.get_string("shard-key", "io_channel");
+  bool pin = opts.get("pin", 0) != 0;
+  auto link_gbps = opts.get_double("link-gbps", 10.);
+
+  BenchmarkReport report("hit_extraction");
+  std::mt19937 rng(12345);
+
+  nlohmann::json args = { { "rawdataprocessorconf",
+                            { { "source_id", 0 }, { "clock_speed_hz", 62500000 }, { "emulator_mode", false } } },
+                          { "ndreadoutconf",
+                            { { "pacman_storage_mode", "pooled" },
+                              { "pacman_word_check", true },
+                              { "pacman_shard_key", shard_key },
+                              { "pacman_hit_extraction", true },
+                              { "pacman_subsecond_clock_hz", 10000000 } } } };
+
+  std::vector<std::vector<char>> messages(num_distinct);
+  for (std::size_t i = 0; i < num_distinct; ++i) {
+    messages[i] = synthetic::make_pacman_message(1700000000 + i / 1000, pacman_words, (i % 1000) * 10000, 10, rng);
+  }
+
+  // Decode cost alone, on the calling thread
+  std::vector<uint64_t> expected_hits(num_distinct, 0); // NOLINT(build/unsigned)
+  {
+    pacman::LArPixHitExtractor extractor(62500000, 10000000);
+    pacman::LArPixHits hits;
+    uint64_t num_hits = 0; // NOLINT(build/unsigned)
+    uint64_t bytes = 0;    // NOLINT(build/unsigned)
+    LatencySampler samples;
+    auto seconds = time_batches(num_messages, batch_size, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+      const auto& msg = messages[i % num_distinct];
+      auto n = extractor.extract(msg.data(), msg.size(), hits);
+      num_hits += n;
+      bytes += msg.size();
+      if (i < num_distinct) {
+        expected_hits[i] = n;
+      }
+    });
+    auto& result = report.add("extract", { { "pacman_words", pacman_words } }, num_messages, seconds, samples);
+    add_rates(result, num_messages, num_hits, bytes, seconds, link_gbps);
+  }
+
+  // Full processing of every message; timed until the workers have drained
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  PACMANFrameProcessor(error_registry).conf(args);
+  std::vector<types::NDReadoutPACMANTypeAdapter> adapters(num_distinct);
+  for (std::size_t i = 0; i < num_distinct; ++i) {
+    adapters[i].load_message(messages[i].data(), messages[i].size());
+  }
+
+  for (const std::string mode : { "serial", "sharded" }) {
+    for (auto workers : worker_counts) {
+      std::string cpus;
+      for (uint64_t i = 0; pin && i < workers; ++i) { // NOLINT(build/unsigned)
+        cpus += (i ? "," : "") + std::to_string(i);
+      }
+      args["ndreadoutconf"]["pacman_processing_mode"] = mode;
+      args["ndreadoutconf"]["pacman_worker_threads"] = workers;
+      args["ndreadoutconf"]["pacman_worker_cpus"] = cpus;
+      PACMANFrameProcessor processor(error_registry);
+      processor.conf(args);
+      std::atomic<uint64_t> published_hits{ 0 }; // NOLINT(build/unsigned)
+      processor.set_hit_sink([&](pacman::LArPixHits&& hits) {
+        published_hits.fetch_add(hits.size(), std::memory_order_relaxed);
+        return true;
+      });
+      processor.start(args);
+
+      LatencySampler samples;
+      auto start = std::chrono::steady_clock::now();
+      time_batches(num_messages, batch_size, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+        auto& adapter = adapters[i % num_distinct];
+        adapter.set_first_timestamp(1000 + i * 1000);
+        processor.preprocess_item(&adapter);
+        processor.postprocess_item(&adapter);
+      });
+      processor.stop(args);
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      // Words dropped on full worker queues show up as missing hits
+      uint64_t total_hits = 0; // NOLINT(build/unsigned)
+      for (uint64_t i = 0; i < num_messages; ++i) { // NOLINT(build/unsigned)
+        total_hits += expected_hits[i % num_distinct];
+      }
+      double processed = total_hits ? static_cast<double>(published_hits.load()) / total_hits : 1.;
+      uint64_t words = processed * num_messages * pacman_words; // NOLINT(build/unsigned)
+      auto& result = report.add("pipeline_" + mode,
+                                { { "pacman_words", pacman_words }, { "workers", workers }, { "pinned", pin } },
+                                num_messages,
+                                seconds,
+                                samples);
+      add_rates(result, words / pacman_words, published_hits.load(), words * pacman::word_size, seconds, link_gbps);
+      result["hit_loss_fraction"] = 1. - processed;
+      result["words_per_s"] = words / seconds;
+      processor.scrap(args);
+    }
+  }
+
+  report.write(opts.get_string("output", "-"));
+  return 0;
+}
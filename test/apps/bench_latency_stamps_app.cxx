@@ -0,0 +1,155 @@
+/**
+ * @file bench_latency_stamps_app.cxx Cost and accuracy of the latency stamps enabled by
+ *                                    NDREADOUTLIBS_LATENCY_STAMPS
+ *
+ * Usage: ndreadoutlibs_bench_latency_stamps [--messages N] [--mpd-size B] [--sample-period P]
+ *                                          [--output file.json]
+ *
+ * stamp times one clock read plus one histogram record, as done at every stage, sample the
+ * per message sampling decision. accuracy compares the histogram percentiles of log-normal
+ * samples with the exact ones and fails above the 1/16 bin width. mpd_ingest runs
+ * load_message(), the MPD preprocess pipeline and the latency buffer insert; its
+ * overhead_fraction is the share taken by the sampling decision and the three stamps
+ * recorded on that path for one in sample-period messages.
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef NDREADOUTLIBS_LATENCY_STAMPS
+#define NDREADOUTLIBS_LATENCY_STAMPS
+#endif
+
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/mpd/MPDFrameProcessor.hpp"
+#include "ndreadoutlibs/utils/BenchmarkReport.hpp"
+#include "ndreadoutlibs/utils/LatencyStamps.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::benchmark;
+
+namespace {
+
+const constexpr uint64_t batch_size = 64; // NOLINT(build/unsigned)
+const constexpr std::size_t num_accuracy_samples = 1000000;
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  BenchmarkOptions opts(argc, argv);
+  auto num_messages = opts.get("messages", 1000000);
+  auto mpd_size = opts.get("mpd-size", 4096);
+  auto sample_period = opts.get("sample-period", 64);
+
+  BenchmarkReport report("latency_stamps");
+  std::mt19937 rng(12345);
+  LatencySampler samples;
+
+  // Cost of one stamp
+  latency::LogLinearHistogram histogram;
+  uint64_t sink = 0; // NOLINT(build/unsigned)
+  auto clock_seconds = time_batches(num_messages, batch_size, samples, [&](uint64_t) { // NOLINT(build/unsigned)
+    sink += latency::now_ns();
+  });
+  report.add("clock_read", { { "sink", sink & 1 } }, num_messages, clock_seconds, samples);
+  samples.clear();
+  auto since = latency::now_ns();
+  auto stamp_seconds = time_batches(num_messages, batch_size, samples, [&](uint64_t) { // NOLINT(build/unsigned)
+    histogram.record(latency::now_ns() - since);
+  });
+  report.add("stamp", {}, num_messages, stamp_seconds, samples);
+  double stamp_ns = stamp_seconds * 1e9 / num_messages;
+  samples.clear();
+  uint64_t sampled = 0; // NOLINT(build/unsigned)
+  auto sample_seconds = time_batches(num_messages, batch_size, samples, [&](uint64_t) { // NOLINT(build/unsigned)
+    sampled += latency::sample();
+  });
+  report.add("sample", { { "sampled", sampled } }, num_messages, sample_seconds, samples);
+  double sample_ns = sample_seconds * 1e9 / num_messages;
+
+  // Percentiles against the exact values
+  histogram.take();
+  std::lognormal_distribution<double> duration(std::log(20000.), 1.);
+  std::vector<uint64_t> values(num_accuracy_samples); // NOLINT(build/unsigned)
+  for (auto& value : values) {
+    value = static_cast<uint64_t>(duration(rng)); // NOLINT(build/unsigned)
+    histogram.record(value);
+  }
+  std::sort(values.begin(), values.end());
+  auto summary = histogram.take();
+  double worst_error = 0.;
+  nlohmann::json errors;
+  for (auto [name, fraction, measured] : { std::make_tuple("p50", 0.50, summary.p50_ns),
+                                           std::make_tuple("p99", 0.99, summary.p99_ns),
+                                           std::make_tuple("p999", 0.999, summary.p999_ns) }) {
+    auto exact = values[static_cast<std::size_t>(std::ceil(fraction * values.size())) - 1];
+    double error = std::abs(static_cast<double>(measured) - exact) / exact;
+    errors[name] = error;
+    worst_error = std::max(worst_error, error);
+  }
+  samples.clear();
+  auto& accuracy = report.add("accuracy", {}, num_accuracy_samples, 0., samples);
+  accuracy["relative_errors"] = errors;
+  if (summary.count != num_accuracy_samples || worst_error > 1. / latency::LogLinearHistogram::sub_buckets) {
+    std::cerr << "Histogram percentiles off by " << worst_error << " over " << summary.count << " samples"
+              << std::endl;
+    return 1;
+  }
+
+  // Receive to latency buffer path of the MPD readout
+  nlohmann::json args = { { "rawdataprocessorconf",
+                            { { "source_id", 0 }, { "clock_speed_hz", 50000000 }, { "emulator_mode", false } } },
+                          { "latencybufferconf", { { "latency_buffer_size", 100000 } } },
+                          { "ndreadoutconf", { { "latency_sample_period", sample_period } } } };
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  MPDFrameProcessor processor(error_registry);
+  processor.conf(args);
+  NDLatencyBufferModel<types::NDReadoutMPDTypeAdapter> latency_buffer;
+  latency_buffer.conf(args);
+  auto frame = synthetic::make_mpd_frame(mpd_size, rng);
+
+  samples.clear();
+  auto ingest_seconds = time_batches(num_messages, batch_size, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+    types::NDReadoutMPDTypeAdapter adapter;
+    adapter.load_message(frame.data(), frame.size());
+    adapter.set_first_timestamp(1000 + i * 1000);
+    processor.preprocess_item(&adapter);
+    latency_buffer.write(std::move(adapter));
+    if (latency_buffer.occupancy() > 50000) {
+      latency_buffer.pop(10000);
+    }
+  });
+  auto insert = latency_buffer.get_insert_latency().take();
+  uint64_t period = latency::sample_mask().load() + 1; // NOLINT(build/unsigned)
+  auto& ingest = report.add(
+    "mpd_ingest", { { "frame_size", frame.size() }, { "sample_period", period } }, num_messages, ingest_seconds, samples);
+  ingest["overhead_fraction"] = (sample_ns + 3 * stamp_ns / period) / (ingest_seconds * 1e9 / num_messages);
+  ingest["insert_count"] = insert.count;
+  ingest["insert_p50_ns"] = insert.p50_ns;
+  ingest["insert_p99_ns"] = insert.p99_ns;
+  ingest["insert_p999_ns"] = insert.p999_ns;
+  processor.scrap(args);
+  if (insert.count == 0 || insert.count > num_messages / period + 1) {
+    std::cerr << "Recorded " << insert.count << " inserts for " << num_messages << " messages" << std::endl;
+    return 1;
+  }
+
+  report.write(opts.get_string("output", "-"));
+  return 0;
+}
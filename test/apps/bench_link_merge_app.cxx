@@ -0,0 +1,221 @@
+/**
+ * @file bench_link_merge_app.cxx Merge rate of several PACMAN links into one latency buffer,
+ *                                and requests served per link versus from the merged buffer
+ *
+ * Usage: ndreadoutlibs_bench_link_merge [--links 2,4,8,16] [--messages N] [--requests N]
+ *                                       [--window-ticks T] [--tick-step T] [--output file.json]
+ *
+ * Every link carries N messages, keys of link l are offset by l * tick-step / links so that
+ * the links interleave. The per_link variant keeps one latency buffer and request handler per
+ * link and serves every request with one data request per link; the merged variant serves it
+ * with a single data request on the buffer filled by LinkMergerModel.
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/models/LinkMergerModel.hpp"
+#include "ndreadoutlibs/models/MergedListRequestHandlerModel.hpp"
+#include "ndreadoutlibs/pacman/PACMANListRequestHandler.hpp"
+#include "ndreadoutlibs/utils/BenchmarkReport.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::benchmark;
+
+namespace {
+
+using Adapter = types::NDReadoutPACMANTypeAdapter;
+
+// Expose the request path, which the DAQ module reaches through issue_request()
+template<class Handler>
+class BenchRequestHandler : public Handler
+{
+public:
+  using Handler::Handler;
+  using Handler::data_request;
+};
+
+struct MergeBenchConfig
+{
+  uint64_t links;        // NOLINT(build/unsigned)
+  uint64_t messages;     // NOLINT(build/unsigned)
+  uint64_t requests;     // NOLINT(build/unsigned)
+  uint64_t window_ticks; // NOLINT(build/unsigned)
+  uint64_t tick_step;    // NOLINT(build/unsigned)
+};
+
+Adapter
+make_element(const std::shared_ptr<std::vector<char>>& shared, const MergeBenchConfig& cfg, uint64_t link, uint64_t i) // NOLINT
+{
+  Adapter adapter;
+  adapter.adopt_message(shared->data(), shared->size(), std::shared_ptr<void>(shared));
+  adapter.set_first_timestamp((i + 1) * cfg.tick_step + link * cfg.tick_step / cfg.links);
+  return adapter;
+}
+
+dfmessages::DataRequest
+make_request(uint64_t i, uint64_t begin, uint64_t window) // NOLINT(build/unsigned)
+{
+  dfmessages::DataRequest dr;
+  dr.request_number = i;
+  dr.trigger_number = i;
+  dr.request_information.window_begin = begin;
+  dr.request_information.window_end = begin + window;
+  return dr;
+}
+
+nlohmann::json
+make_args(const MergeBenchConfig& cfg, uint64_t depth) // NOLINT(build/unsigned)
+{
+  return {
+    { "ndreadoutconf",
+      { { "latency_buffer_model", "skiplist" },
+        { "link_merge_inputs", cfg.links },
+        { "link_merge_queue_size", 4096 },
+        { "link_merge_max_wait_us", 1000 } } },
+    { "latencybufferconf", { { "latency_buffer_size", depth } } },
+    { "requesthandlerconf",
+      { { "latency_buffer_size", depth }, { "pop_limit_pct", 0.9 }, { "pop_size_pct", 0.5 }, { "source_id", 0 } } },
+  };
+}
+
+void
+bench_links(BenchmarkReport& report, const MergeBenchConfig& cfg, const std::shared_ptr<std::vector<char>>& shared)
+{
+  nlohmann::json params = { { "links", cfg.links }, { "window_ticks", cfg.window_ticks }, { "tick_step", cfg.tick_step } };
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  uint64_t total = cfg.links * cfg.messages; // NOLINT(build/unsigned)
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<uint64_t> position(1, cfg.messages * cfg.tick_step); // NOLINT(build/unsigned)
+
+  // Per link buffers and handlers
+  {
+    using LatencyBuffer = NDLatencyBufferModel<Adapter>;
+    auto args = make_args(cfg, cfg.messages * 2);
+    std::vector<std::unique_ptr<LatencyBuffer>> buffers;
+    std::vector<std::unique_ptr<BenchRequestHandler<PACMANListRequestHandler>>> handlers;
+    // The handlers keep a reference to their buffer pointer
+    buffers.reserve(cfg.links);
+    for (uint64_t l = 0; l < cfg.links; ++l) { // NOLINT(build/unsigned)
+      buffers.emplace_back(std::make_unique<LatencyBuffer>());
+      buffers.back()->conf(args);
+      handlers.emplace_back(std::make_unique<BenchRequestHandler<PACMANListRequestHandler>>(buffers.back(), error_registry));
+      handlers.back()->conf(args);
+      handlers.back()->start(args);
+    }
+    LatencySampler samples;
+    auto seconds = time_batches(total, 64, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+      buffers[i % cfg.links]->write(make_element(shared, cfg, i % cfg.links, i / cfg.links));
+    });
+    report.add("per_link_insert", params, total, seconds, samples);
+
+    samples.clear();
+    uint64_t fragments = 0; // NOLINT(build/unsigned)
+    uint64_t bytes = 0;     // NOLINT(build/unsigned)
+    seconds = time_batches(cfg.requests, 1, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+      auto begin = position(rng);
+      for (auto& handler : handlers) {
+        auto result = handler->data_request(make_request(i, begin, cfg.window_ticks));
+        if (result.fragment) {
+          ++fragments;
+          bytes += result.fragment->get_size();
+        }
+      }
+    });
+    auto& result = report.add("per_link_request", params, cfg.requests, seconds, samples);
+    result["fragments_per_request"] = cfg.requests ? static_cast<double>(fragments) / cfg.requests : 0.;
+    result["bytes_per_request"] = cfg.requests ? bytes / cfg.requests : 0;
+    for (auto& handler : handlers) {
+      handler->stop(args);
+    }
+  }
+
+  // Merged buffer
+  {
+    using Merger = LinkMergerModel<Adapter>;
+    auto args = make_args(cfg, total * 2);
+    std::unique_ptr<Merger::LatencyBufferType> buffer = std::make_unique<Merger::LatencyBufferType>();
+    buffer->conf(args);
+    BenchRequestHandler<MergedListRequestHandlerModel<Adapter>> handler(buffer, error_registry);
+    handler.conf(args);
+    handler.start(args);
+    Merger merger(buffer);
+    merger.conf(args);
+    merger.start();
+
+    // Timed until the merge thread has written every message
+    LatencySampler samples;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t retries = 0; // NOLINT(build/unsigned)
+    time_batches(total, 64, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+      auto link = i % cfg.links;
+      auto element = make_element(shared, cfg, link, i / cfg.links);
+      // A refused element is left untouched by the queue
+      while (!merger.push(link, std::move(element))) {
+        ++retries;
+        std::this_thread::yield();
+      }
+    });
+    while (buffer->occupancy() < total) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto& merge = report.add("merged_insert", params, total, seconds, samples);
+    merge["full_queue_retries"] = retries;
+
+    samples.clear();
+    uint64_t fragments = 0; // NOLINT(build/unsigned)
+    uint64_t bytes = 0;     // NOLINT(build/unsigned)
+    seconds = time_batches(cfg.requests, 1, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+      auto result = handler.data_request(make_request(i, position(rng), cfg.window_ticks));
+      if (result.fragment) {
+        ++fragments;
+        bytes += result.fragment->get_size();
+      }
+    });
+    auto& result = report.add("merged_request", params, cfg.requests, seconds, samples);
+    result["fragments_per_request"] = cfg.requests ? static_cast<double>(fragments) / cfg.requests : 0.;
+    result["bytes_per_request"] = cfg.requests ? bytes / cfg.requests : 0;
+    merger.stop();
+    handler.stop(args);
+  }
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  BenchmarkOptions opts(argc, argv);
+  auto links = opts.get_list("links", { 2, 4, 8, 16 });
+  MergeBenchConfig cfg;
+  cfg.messages = opts.get("messages", 100000);
+  cfg.requests = opts.get("requests", 1000);
+  cfg.window_ticks = opts.get("window-ticks", 50000);
+  cfg.tick_step = opts.get("tick-step", 1000);
+  uint16_t pacman_words = opts.get("pacman-words", 64); // NOLINT(build/unsigned)
+
+  BenchmarkReport report("link_merge");
+  std::mt19937 rng(12345);
+  auto shared = std::make_shared<std::vector<char>>(synthetic::make_pacman_message(1700000000, pacman_words, 0, 10, rng));
+
+  for (auto num_links : links) {
+    cfg.links = num_links;
+    bench_links(report, cfg, shared);
+  }
+
+  report.write(opts.get_string("output", "-"));
+  return 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file bench_recorder_app.cxx Compressed recording rate and size of PACMAN messages, and
+ *                              random access through the recording index
+ *
+ * Usage: ndreadoutlibs_bench_recorder [--messages N] [--pacman-words W] [--codecs none,gzip,zlib]
+ *                                     [--levels 1,6] [--block-size B] [--rate R] [--lookups N]
+ *                                     [--path /tmp/ndrecord.bin] [--output file.json]
+ *
+ * Every codec and level is recorded as a run of its own, path_runNNNNNN.bin, removed afterwards.
+ *
+ * compress_block times the codec alone on one block. Messages are then recorded at the given
+ * rate (0 for as fast as possible) and the run is timed until the last block is on disk.
+ * Messages dropped because compression fell behind are reported as drop_fraction. size_ratio compares the file with the recorded message bytes,
+ * fixed_frame_ratio with the PACMAN_FRAME_SIZE buffers the adapter holds in fixed mode.
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/NDReadoutPACMANTypeAdapter.hpp"
+#include "ndreadoutlibs/utils/BenchmarkReport.hpp"
+#include "ndreadoutlibs/utils/CompressedRecorder.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::benchmark;
+
+namespace {
+
+const constexpr uint64_t batch_size = 64; // NOLINT(build/unsigned)
+const constexpr std::size_t num_distinct = 1024;
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  BenchmarkOptions opts(argc, argv);
+  auto num_messages = opts.get("messages", 100000);
+  uint16_t pacman_words = opts.get("pacman-words", 256); // NOLINT(build/unsigned)
+  auto codecs = opts.get_string("codecs", "none,gzip,zlib");
+  auto levels = opts.get_list("levels", { 1, 6 });
+  auto block_size = opts.get("block-size", 4 << 20);
+  auto rate = opts.get_double("rate", 50000.);
+  auto num_lookups = opts.get("lookups", 100);
+  auto path = opts.get_string("path", "/tmp/ndreadoutlibs_bench_record.bin");
+
+  BenchmarkReport report("recorder");
+  uint32_t run = 0; // NOLINT(build/unsigned)
+  std::mt19937 rng(12345);
+  std::vector<std::vector<char>> messages(num_distinct);
+  for (std::size_t i = 0; i < num_distinct; ++i) {
+    messages[i] = synthetic::make_pacman_message(1700000000 + i / 1000, pacman_words, (i % 1000) * 10000, 10, rng);
+  }
+
+  for (const auto& codec : { std::string("none"), std::string("gzip"), std::string("zlib") }) {
+    if (codecs.find(codec) == std::string::npos) {
+      continue;
+    }
+    for (auto level : levels) {
+      if (codec == "none" && level != levels.front()) {
+        continue;
+      }
+      nlohmann::json params = { { "codec", codec }, { "level", level }, { "block_size", block_size },
+                                { "pacman_words", pacman_words }, { "rate", rate } };
+      // Codec alone, on one block of back to back messages
+      std::vector<char> block;
+      for (std::size_t i = 0; block.size() + messages[i % num_distinct].size() <= block_size; ++i) {
+        block.insert(block.end(), messages[i % num_distinct].begin(), messages[i % num_distinct].end());
+      }
+      std::vector<char> compressed;
+      LatencySampler codec_samples;
+      uint64_t num_blocks = 20; // NOLINT(build/unsigned)
+      auto codec_seconds = time_batches(num_blocks, 1, codec_samples, [&](uint64_t) { // NOLINT(build/unsigned)
+        recording::compress(recording::parse_codec(codec), static_cast<int>(level), block.data(), block.size(), compressed);
+      });
+      auto& codec_result = report.add("compress_block", params, num_blocks, codec_seconds, codec_samples);
+      codec_result["mbytes_per_s"] = num_blocks * block.size() / codec_seconds / 1e6;
+      codec_result["size_ratio"] = block.empty() ? 0. : static_cast<double>(compressed.size()) / block.size();
+
+      CompressedRecorder recorder;
+      recorder.conf(path, codec, static_cast<int>(level), block_size);
+      recorder.start(run++);
+
+      // Record
+      uint64_t dropped = 0; // NOLINT(build/unsigned)
+      uint64_t bytes = 0;   // NOLINT(build/unsigned)
+      LatencySampler samples;
+      const std::chrono::duration<double> period(rate > 0. ? 1. / rate : 0.);
+      auto start = std::chrono::steady_clock::now();
+      time_batches(num_messages, batch_size, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+        if (rate > 0.) {
+          std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * i));
+        }
+        const auto& msg = messages[i % num_distinct];
+        if (recorder.record(msg.data(), msg.size(), 1000 + i * 1000)) {
+          bytes += msg.size();
+        } else {
+          ++dropped;
+        }
+      });
+      recorder.stop();
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      CompressedRecordReader reader(recorder.file_path());
+      uint64_t file_bytes = 0; // NOLINT(build/unsigned)
+      for (const auto& entry : reader.index()) {
+        file_bytes += entry.compressed_size;
+      }
+      auto& result = report.add("record", params, num_messages, seconds, samples);
+      result["mbytes_per_s"] = bytes / seconds / 1e6;
+      result["drop_fraction"] = static_cast<double>(dropped) / num_messages;
+      result["size_ratio"] = bytes ? static_cast<double>(file_bytes) / bytes : 0.;
+      result["fixed_frame_ratio"] =
+        static_cast<double>(file_bytes) / ((num_messages - dropped) * types::PACMAN_FRAME_SIZE);
+      result["blocks"] = reader.index().size();
+
+      // Random access: decompress the block holding a random key
+      samples.clear();
+      std::uniform_int_distribution<uint64_t> position(1000, 1000 + (num_messages - 1) * 1000); // NOLINT(build/unsigned)
+      std::vector<char> raw;
+      uint64_t found = 0; // NOLINT(build/unsigned)
+      auto lookup_seconds = time_batches(num_lookups, 1, samples, [&](uint64_t) { // NOLINT(build/unsigned)
+        auto index = reader.find_block(position(rng));
+        if (index < reader.index().size()) {
+          reader.read_block(index, raw);
+          ++found;
+        }
+      });
+      auto& lookup = report.add("lookup", params, num_lookups, lookup_seconds, samples);
+      lookup["found"] = found;
+
+      // The first block starts with the first recorded messages
+      if (!reader.index().empty()) {
+        reader.read_block(0, raw);
+        if (dropped == 0 && (raw.size() < messages[0].size() ||
+                             !std::equal(messages[0].begin(), messages[0].end(), raw.begin()))) {
+          std::cerr << "Recording of " << codec << " does not match the recorded messages" << std::endl;
+          return 1;
+        }
+      }
+      std::remove(recorder.file_path().c_str());
+      std::remove(recording::index_path(recorder.file_path()).c_str());
+    }
+  }
+
+  report.write(opts.get_string("output", "-"));
+  return 0;
+}
@@ -0,0 +1,357 @@
+/**
+ * @file bench_request_handlers_app.cxx Latency buffer insert, lookup, request and cleanup rates
+ *                                      through the MPD and PACMAN list request handlers
+ *
+ * Usage: ndreadoutlibs_bench_request_handlers [--depths 10000,100000,1000000] [--lookups N]
+ *                                             [--requests N] [--window-ticks T] [--tick-step T]
+ *                                             [--jitter T] [--models skiplist,buckets]
+ *                                             [--bucket-width T] [--cleanup-budget-us N]
+ *                                             [--range-messages N] [--range-span T]
+ *                                             [--output file.json]
+ *
+ * pacman_match_* serve windows over PACMAN messages whose data packets spread over
+ * range-span ticks, in shuffled word order. efficiency is the fraction of the messages with
+ * data in the window that the fragment holds, dragged_fraction the fraction of fragment
+ * messages without data in the window, in_window_word_fraction the fraction of shipped
+ * words inside the window.
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/mpd/MPDListRequestHandler.hpp"
+#include "ndreadoutlibs/pacman/PACMANListRequestHandler.hpp"
+#include "ndreadoutlibs/utils/BenchmarkReport.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::benchmark;
+
+namespace {
+
+const constexpr uint64_t batch_size = 64; // NOLINT(build/unsigned)
+
+// Expose the request path, which the DAQ module reaches through issue_request()
+template<class Handler>
+class BenchRequestHandler : public Handler
+{
+public:
+  using Handler::Handler;
+  using Handler::data_request;
+};
+
+struct HandlerBenchConfig
+{
+  uint64_t depth;        // NOLINT(build/unsigned)
+  uint64_t num_lookups;  // NOLINT(build/unsigned)
+  uint64_t num_requests; // NOLINT(build/unsigned)
+  uint64_t window_ticks; // NOLINT(build/unsigned)
+  uint64_t tick_step;    // NOLINT(build/unsigned)
+  uint64_t jitter;       // NOLINT(build/unsigned)
+  uint64_t bucket_width; // NOLINT(build/unsigned)
+  uint64_t cleanup_budget_us; // NOLINT(build/unsigned)
+  std::string model;
+};
+
+/**
+ * All entries share one payload through adopt_message(), so that millions of entries
+ * measure the buffer structure rather than memory bandwidth. A non-zero jitter adds a
+ * random offset to every key, i.e. irregular and slightly out of order arrival.
+ * */
+template<class Adapter, class Handler>
+void
+bench_handler(BenchmarkReport& report,
+              const std::string& prefix,
+              const HandlerBenchConfig& cfg,
+              const std::vector<char>& message)
+{
+  using LatencyBuffer = NDLatencyBufferModel<Adapter>;
+  nlohmann::json params = { { "depth", cfg.depth },         { "window_ticks", cfg.window_ticks },
+                            { "tick_step", cfg.tick_step }, { "jitter", cfg.jitter },
+                            { "model", cfg.model },         { "bucket_width", cfg.bucket_width },
+                            { "cleanup_budget_us", cfg.cleanup_budget_us } };
+  nlohmann::json args = {
+    { "ndreadoutconf",
+      { { "latency_buffer_model", cfg.model },
+        { "bucket_width_ticks", cfg.bucket_width },
+        { "cleanup_time_budget_us", cfg.cleanup_budget_us } } },
+    { "latencybufferconf", { { "latency_buffer_size", cfg.depth } } },
+    { "requesthandlerconf",
+      { { "latency_buffer_size", cfg.depth }, { "pop_limit_pct", 0.5 }, { "pop_size_pct", 0.5 }, { "source_id", 0 } } },
+  };
+
+  auto shared = std::make_shared<std::vector<char>>(message);
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  std::unique_ptr<LatencyBuffer> latency_buffer = std::make_unique<LatencyBuffer>();
+  latency_buffer->conf(args);
+  BenchRequestHandler<Handler> handler(latency_buffer, error_registry);
+  handler.conf(args);
+  handler.start(args);
+
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<uint64_t> jitter(0, cfg.jitter); // NOLINT(build/unsigned)
+
+  // Insert
+  LatencySampler samples;
+  auto seconds = time_batches(cfg.depth, batch_size, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+    Adapter adapter;
+    adapter.adopt_message(shared->data(), shared->size(), std::shared_ptr<void>(shared));
+    adapter.set_first_timestamp((i + 1) * cfg.tick_step + jitter(rng));
+    latency_buffer->write(std::move(adapter));
+  });
+  report.add(prefix + "_insert", params, cfg.depth, seconds, samples);
+
+  std::uniform_int_distribution<uint64_t> position(1, cfg.depth * cfg.tick_step); // NOLINT(build/unsigned)
+
+  // Lookup
+  samples.clear();
+  uint64_t found = 0; // NOLINT(build/unsigned)
+  seconds = time_batches(cfg.num_lookups, 1, samples, [&](uint64_t) { // NOLINT(build/unsigned)
+    Adapter request_element;
+    request_element.set_first_timestamp(position(rng));
+    auto it = latency_buffer->lower_bound(request_element, false);
+    found += it.good();
+  });
+  auto& lookup = report.add(prefix + "_lookup", params, cfg.num_lookups, seconds, samples);
+  lookup["found"] = found;
+
+  // Request windows served into fragments
+  samples.clear();
+  uint64_t fragment_bytes = 0; // NOLINT(build/unsigned)
+  seconds = time_batches(cfg.num_requests, 1, samples, [&](uint64_t i) { // NOLINT(build/unsigned)
+    dfmessages::DataRequest dr;
+    dr.request_number = i;
+    dr.trigger_number = i;
+    dr.request_information.window_begin = position(rng);
+    dr.request_information.window_end = dr.request_information.window_begin + cfg.window_ticks;
+    auto result = handler.data_request(dr);
+    if (result.fragment) {
+      fragment_bytes += result.fragment->get_size();
+    }
+  });
+  auto& request = report.add(prefix + "_request", params, cfg.num_requests, seconds, samples);
+  request["mean_fragment_bytes"] = cfg.num_requests ? fragment_bytes / cfg.num_requests : 0;
+
+  // Cleanup of the buffer filled above its pop limit, in as many budgeted passes as it takes
+  samples.clear();
+  auto before = latency_buffer->occupancy();
+  uint64_t passes = 0; // NOLINT(build/unsigned)
+  double ns = 0.;
+  double max_pass_ns = 0.;
+  for (auto occupancy = before; occupancy > cfg.depth / 2 && passes < cfg.depth; ++passes) {
+    auto t0 = std::chrono::steady_clock::now();
+    handler.cleanup_check();
+    auto t1 = std::chrono::steady_clock::now();
+    double pass_ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    auto now = latency_buffer->occupancy();
+    if (now == occupancy) {
+      break;
+    }
+    samples.add(pass_ns / (occupancy - now));
+    ns += pass_ns;
+    max_pass_ns = std::max(max_pass_ns, pass_ns);
+    occupancy = now;
+  }
+  auto evicted = before - latency_buffer->occupancy();
+  auto& cleanup = report.add(prefix + "_cleanup", params, evicted, ns * 1e-9, samples);
+  cleanup["cleanup_duration_ns"] = ns;
+  cleanup["cleanup_passes"] = passes;
+  cleanup["max_pass_duration_ns"] = max_pass_ns;
+
+  handler.stop(args);
+  latency_buffer->flush();
+}
+
+// Data packet timestamps of a PACMAN message, in DAQ ticks
+std::vector<uint64_t> // NOLINT(build/unsigned)
+packet_ticks(const char* msg, std::size_t size)
+{
+  std::vector<uint64_t> ticks; // NOLINT(build/unsigned)
+  uint64_t second_ticks = // NOLINT(build/unsigned)
+    static_cast<uint64_t>(pacman::load_header_unix_ts(msg)) * types::NDReadoutPACMANTypeAdapter::config().clock_frequency;
+  std::size_t num_words = std::min<std::size_t>(pacman::load_header_words(msg), (size - pacman::header_size) / pacman::word_size);
+  for (std::size_t i = 0; i < num_words; ++i) {
+    const char* word = msg + pacman::header_size + i * pacman::word_size;
+    uint64_t packet = pacman::load_packet(word); // NOLINT(build/unsigned)
+    if (types::NDReadoutPACMANTypeAdapter::is_data_packet(word, packet)) {
+      ticks.push_back(types::NDReadoutPACMANTypeAdapter::packet_ticks(second_ticks, packet));
+    }
+  }
+  return ticks;
+}
+
+void
+bench_interval_matching(BenchmarkReport& report,
+                        uint64_t num_messages, // NOLINT(build/unsigned)
+                        uint64_t span,         // NOLINT(build/unsigned)
+                        uint64_t num_requests, // NOLINT(build/unsigned)
+                        uint64_t window_ticks, // NOLINT(build/unsigned)
+                        uint16_t words)        // NOLINT(build/unsigned)
+{
+  using Adapter = types::NDReadoutPACMANTypeAdapter;
+  using LatencyBuffer = NDLatencyBufferModel<Adapter>;
+  // Packet counters wrap at subsecond_clock_frequency, all messages stay within one second
+  const uint64_t message_step = 2000; // NOLINT(build/unsigned)
+  std::mt19937 rng(777);
+  std::vector<std::vector<char>> messages(num_messages);
+  std::vector<std::pair<uint64_t, uint64_t>> ranges(num_messages); // NOLINT(build/unsigned)
+  for (uint64_t i = 0; i < num_messages; ++i) { // NOLINT(build/unsigned)
+    auto step = static_cast<uint32_t>(std::max<uint64_t>(span / std::max<uint16_t>(words - 1, 1), 1)); // NOLINT(build/unsigned)
+    messages[i] = synthetic::make_pacman_message(1700000000, words, 1000000 + i * message_step, step, rng);
+    // Packets of different chips arrive interleaved
+    char* first_word = messages[i].data() + pacman::header_size;
+    for (std::size_t w = words - 1; w > 0; --w) {
+      std::size_t other = std::uniform_int_distribution<std::size_t>(0, w)(rng);
+      char tmp[pacman::word_size];
+      std::memcpy(tmp, first_word + w * pacman::word_size, pacman::word_size);
+      std::memcpy(first_word + w * pacman::word_size, first_word + other * pacman::word_size, pacman::word_size);
+      std::memcpy(first_word + other * pacman::word_size, tmp, pacman::word_size);
+    }
+    auto ticks = packet_ticks(messages[i].data(), messages[i].size());
+    ranges[i] = { *std::min_element(ticks.begin(), ticks.end()), *std::max_element(ticks.begin(), ticks.end()) };
+  }
+  auto first_tick = ranges.front().first;
+  auto last_tick = ranges.back().second;
+
+  for (const std::string mode : { "packet", "range", "range_trim" }) {
+    auto& adapter_config = Adapter::config();
+    adapter_config.storage_mode = types::PACMANStorageMode::kPooled;
+    adapter_config.timestamp_mode =
+      mode == "packet" ? types::PACMANTimestampMode::kPacketTimestamp : types::PACMANTimestampMode::kPacketRange;
+    nlohmann::json params = { { "messages", num_messages }, { "range_span", span },
+                              { "window_ticks", window_ticks }, { "mode", mode } };
+    nlohmann::json args = {
+      { "ndreadoutconf", { { "pacman_trim_to_window", mode == "range_trim" } } },
+      { "latencybufferconf", { { "latency_buffer_size", num_messages } } },
+      { "requesthandlerconf",
+        { { "latency_buffer_size", num_messages }, { "pop_limit_pct", 0.9 }, { "pop_size_pct", 0.5 }, { "source_id", 0 } } },
+    };
+    std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+    std::unique_ptr<LatencyBuffer> latency_buffer = std::make_unique<LatencyBuffer>();
+    latency_buffer->conf(args);
+    BenchRequestHandler<PACMANListRequestHandler> handler(latency_buffer, error_registry);
+    handler.conf(args);
+    for (auto& msg : messages) {
+      Adapter adapter;
+      adapter.load_message(msg.data(), msg.size());
+      latency_buffer->write(std::move(adapter));
+    }
+
+    std::mt19937_64 request_rng(42);
+    std::uniform_int_distribution<uint64_t> position(first_tick + span, last_tick - span - window_ticks); // NOLINT
+    uint64_t expected = 0;   // NOLINT(build/unsigned)
+    uint64_t matched = 0;    // NOLINT(build/unsigned)
+    uint64_t dragged = 0;    // NOLINT(build/unsigned)
+    uint64_t shipped = 0;    // NOLINT(build/unsigned)
+    uint64_t words_total = 0;     // NOLINT(build/unsigned)
+    uint64_t words_in_window = 0; // NOLINT(build/unsigned)
+    uint64_t fragment_bytes = 0;  // NOLINT(build/unsigned)
+    LatencySampler samples;
+    double seconds = 0.;
+    for (uint64_t r = 0; r < num_requests; ++r) { // NOLINT(build/unsigned)
+      dfmessages::DataRequest dr;
+      dr.request_number = r;
+      dr.request_information.window_begin = position(request_rng);
+      dr.request_information.window_end = dr.request_information.window_begin + window_ticks;
+      auto begin = dr.request_information.window_begin;
+      auto end = dr.request_information.window_end;
+      auto t0 = std::chrono::steady_clock::now();
+      auto result = handler.data_request(dr);
+      auto t1 = std::chrono::steady_clock::now();
+      double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+      samples.add(ns);
+      seconds += ns * 1e-9;
+      fragment_bytes += result.fragment->get_size();
+
+      // Messages truly holding data in the window: data packets in [begin, end)
+      for (uint64_t i = 0; i < num_messages; ++i) { // NOLINT(build/unsigned)
+        if (ranges[i].first < end && ranges[i].second >= begin) {
+          auto ticks = packet_ticks(messages[i].data(), messages[i].size());
+          expected += std::any_of(ticks.begin(), ticks.end(), [&](uint64_t t) { return t >= begin && t < end; });
+        }
+      }
+      // What the fragment holds
+      const char* payload = static_cast<const char*>(result.fragment->get_data());
+      std::size_t remaining = result.fragment->get_data_size();
+      while (remaining >= pacman::header_size) {
+        std::size_t size = pacman::header_size + pacman::load_header_words(payload) * pacman::word_size;
+        auto ticks = packet_ticks(payload, std::min(size, remaining));
+        auto inside = std::count_if(ticks.begin(), ticks.end(), [&](uint64_t t) { return t >= begin && t < end; });
+        ++shipped;
+        matched += inside != 0;
+        dragged += inside == 0;
+        words_total += ticks.size();
+        words_in_window += inside;
+        payload += size;
+        remaining -= std::min(size, remaining);
+      }
+    }
+    auto& result = report.add("pacman_match_" + mode, params, num_requests, seconds, samples);
+    result["efficiency"] = expected ? static_cast<double>(matched) / expected : 1.;
+    result["dragged_fraction"] = shipped ? static_cast<double>(dragged) / shipped : 0.;
+    result["in_window_word_fraction"] = words_total ? static_cast<double>(words_in_window) / words_total : 0.;
+    result["mean_fragment_bytes"] = num_requests ? fragment_bytes / num_requests : 0;
+    latency_buffer->flush();
+  }
+  Adapter::config().timestamp_mode = types::PACMANTimestampMode::kUnixSeconds;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  BenchmarkOptions opts(argc, argv);
+  auto depths = opts.get_list("depths", { 10000, 100000, 1000000 });
+  HandlerBenchConfig cfg;
+  cfg.num_lookups = opts.get("lookups", 100000);
+  cfg.num_requests = opts.get("requests", 1000);
+  cfg.window_ticks = opts.get("window-ticks", 50000);
+  cfg.tick_step = opts.get("tick-step", 1000);
+  cfg.jitter = opts.get("jitter", 0);
+  cfg.bucket_width = opts.get("bucket-width", 50000);
+  cfg.cleanup_budget_us = opts.get("cleanup-budget-us", 200);
+  auto models = opts.get_string("models", "skiplist,buckets");
+  uint16_t pacman_words = opts.get("pacman-words", 256); // NOLINT(build/unsigned)
+  auto mpd_size = opts.get("mpd-size", 4096);
+
+  BenchmarkReport report("request_handlers");
+  std::mt19937 rng(12345);
+  auto pacman_msg = synthetic::make_pacman_message(1700000000, pacman_words, 0, 10, rng);
+  auto mpd_msg = synthetic::make_mpd_frame(mpd_size, rng);
+
+  for (const auto& model : { std::string("skiplist"), std::string("buckets") }) {
+    if (models.find(model) == std::string::npos) {
+      continue;
+    }
+    cfg.model = model;
+    for (auto depth : depths) {
+      cfg.depth = depth;
+      bench_handler<types::NDReadoutMPDTypeAdapter, MPDListRequestHandler>(report, "mpd_" + model, cfg, mpd_msg);
+      bench_handler<types::NDReadoutPACMANTypeAdapter, PACMANListRequestHandler>(
+        report, "pacman_" + model, cfg, pacman_msg);
+    }
+  }
+
+  bench_interval_matching(report,
+                          opts.get("range-messages", 20000),
+                          opts.get("range-span", 20000),
+                          cfg.num_requests,
+                          cfg.window_ticks,
+                          pacman_words);
+
+  report.write(opts.get_string("output", "-"));
+  return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * @file replay_source_app.cxx Replay a capture of raw PACMAN or MPD messages through a frame
+ *                             processor into an ND latency buffer and request handler
+ *
+ * Usage: ndreadoutlibs_replay_source [--format pacman|mpd] [--file capture.bin] [--generate N]
+ *                                    [--rate msgs/s] [--messages N] [--seconds S] [--step ticks]
+ *                                    [--model skiplist|buckets] [--capacity N] [--emulator]
+ *                                    [--output file.json]
+ *
+ * Without --file a capture of N synthetic messages is generated in a temporary file. A rate of
+ * 0 replays as fast as possible, which measures the ingestion limit of the pipeline. PACMAN
+ * payload times are rewritten to the replay keys, MPD frames keep their captured timestamps.
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/mpd/MPDFrameProcessor.hpp"
+#include "ndreadoutlibs/mpd/MPDListRequestHandler.hpp"
+#include "ndreadoutlibs/pacman/PACMANFrameProcessor.hpp"
+#include "ndreadoutlibs/pacman/PACMANListRequestHandler.hpp"
+#include "ndreadoutlibs/utils/BenchmarkReport.hpp"
+#include "ndreadoutlibs/utils/MessageReplaySource.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::benchmark;
+
+namespace {
+
+const constexpr uint64_t sample_every = 64; // NOLINT(build/unsigned)
+
+std::string
+generate_capture(const std::string& format, uint64_t num_messages) // NOLINT(build/unsigned)
+{
+  char path[] = "/tmp/ndreadoutlibs_replay_XXXXXX"; // NOLINT(modernize-avoid-c-arrays)
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    throw ReplayFileError(ERS_HERE, path, "cannot create temporary capture");
+  }
+  close(fd);
+  std::ofstream out(path, std::ios::binary);
+  std::mt19937 rng(12345);
+  std::uniform_int_distribution<int> pacman_words(16, 512);
+  std::uniform_int_distribution<int> mpd_size(1024, 8192);
+  for (uint64_t i = 0; i < num_messages; ++i) { // NOLINT(build/unsigned)
+    auto msg = format == "pacman" ? synthetic::make_pacman_message(1700000000 + i / 1000, pacman_words(rng), 0, 10, rng)
+                                  : synthetic::make_mpd_frame(mpd_size(rng), rng);
+    out.write(msg.data(), msg.size());
+  }
+  return path;
+}
+
+template<class Adapter, class Processor, class Handler>
+void
+run_replay(BenchmarkReport& report,
+           const std::string& format,
+           const std::string& path,
+           const BenchmarkOptions& opts,
+           typename MessageReplaySource<Adapter>::Framer framer,
+           typename MessageReplaySource<Adapter>::Stamper stamper)
+{
+  auto rate = opts.get_double("rate", 0.);
+  auto num_messages = opts.get("messages", 1000000);
+  auto capacity = opts.get("capacity", 100000);
+  std::string model = opts.get_string("model", "skiplist");
+  bool emulator = opts.get("emulator", 0) != 0;
+
+  nlohmann::json args = {
+    { "rawdataprocessorconf", { { "source_id", 0 }, { "clock_speed_hz", 62500000 }, { "emulator_mode", emulator } } },
+    { "latencybufferconf", { { "latency_buffer_size", capacity } } },
+    { "requesthandlerconf",
+      { { "latency_buffer_size", capacity }, { "pop_limit_pct", 0.8 }, { "pop_size_pct", 0.1 }, { "source_id", 0 } } },
+    { "ndreadoutconf", { { "pacman_storage_mode", "pooled" }, { "latency_buffer_model", model } } },
+  };
+
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  std::unique_ptr<NDLatencyBufferModel<Adapter>> latency_buffer = std::make_unique<NDLatencyBufferModel<Adapter>>();
+  Processor processor(error_registry);
+  Handler handler(latency_buffer, error_registry);
+  latency_buffer->conf(args);
+  processor.conf(args);
+  handler.conf(args);
+  processor.start(args);
+  handler.start(args);
+
+  MessageReplaySource<Adapter> source(path, framer, stamper);
+  source.set_timestamps(opts.get("first-ts", 1), opts.get("step", 2500));
+
+  std::atomic<bool> run{ true };
+  std::thread timer;
+  if (opts.get("seconds", 0) != 0) {
+    timer = std::thread([&run, seconds = opts.get("seconds", 0)] {
+      std::this_thread::sleep_for(std::chrono::seconds(seconds));
+      run = false;
+    });
+  }
+
+  LatencySampler samples;
+  uint64_t count = 0; // NOLINT(build/unsigned)
+  auto stats = source.replay(
+    num_messages,
+    rate,
+    [&](Adapter&& element) {
+      bool sample = (++count % sample_every) == 0;
+      auto t0 = sample ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+      processor.preprocess_item(&element);
+      bool stored = latency_buffer->write(std::move(element));
+      handler.cleanup_check();
+      if (sample) {
+        samples.add(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count());
+      }
+      return stored;
+    },
+    run);
+
+  run = false;
+  if (timer.joinable()) {
+    timer.join();
+  }
+  handler.stop(args);
+  processor.stop(args);
+
+  nlohmann::json params = { { "format", format }, { "rate", rate }, { "model", model }, { "capacity", capacity },
+                            { "emulator", emulator }, { "capture_messages", source.num_messages() } };
+  auto& result = report.add("replay_" + format, params, stats.messages, stats.seconds, samples);
+  result["bytes"] = stats.bytes;
+  result["mbytes_per_s"] = stats.seconds > 0. ? stats.bytes / stats.seconds / 1e6 : 0.;
+  result["drops"] = stats.drops;
+  result["late"] = stats.late;
+  result["loops"] = stats.loops;
+  result["occupancy"] = latency_buffer->occupancy();
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  BenchmarkOptions opts(argc, argv);
+  std::string format = opts.get_string("format", "pacman");
+  if (format != "pacman" && format != "mpd") {
+    std::cerr << "Unknown format " << format << ", expected pacman or mpd" << std::endl;
+    return 1;
+  }
+  std::string path = opts.get_string("file", "");
+  bool generated = path.empty();
+  if (generated) {
+    path = generate_capture(format, opts.get("generate", 1024));
+  }
+
+  BenchmarkReport report("replay_source");
+  if (format == "pacman") {
+    run_replay<types::NDReadoutPACMANTypeAdapter, PACMANFrameProcessor, PACMANListRequestHandler>(
+      report, format, path, opts, &replay::pacman_message_size, &replay::stamp_pacman_message);
+  } else {
+    run_replay<types::NDReadoutMPDTypeAdapter, MPDFrameProcessor, MPDListRequestHandler>(
+      report, format, path, opts, &replay::mpd_frame_size, nullptr);
+  }
+  if (generated) {
+    std::remove(path.c_str());
+  }
+
+  report.write(opts.get_string("output", "-"));
+  return 0;
+}
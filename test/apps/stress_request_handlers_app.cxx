@@ -0,0 +1,603 @@
+/**
+ * @file stress_request_handlers_app.cxx Soak test of the MPD and PACMAN list request handlers
+ *                                       under concurrent ingestion, requests and cleanup
+ *
+ * Usage: ndreadoutlibs_stress_request_handlers [--duration-s S] [--report-interval-s S]
+ *                                              [--stall-timeout-s S] [--detectors mpd,pacman]
+ *                                              [--links N] [--rate MSGS_PER_S] [--queue-size N]
+ *                                              [--tick-step T] [--requesters N]
+ *                                              [--request-rate REQS_PER_S] [--window-ticks T]
+ *                                              [--request-delay-ticks T] [--buffer-size N]
+ *                                              [--model skiplist|buckets] [--bucket-width T]
+ *                                              [--cleanup-budget-us N] [--mpd-size B]
+ *                                              [--pacman-words W] [--output file.json]
+ *
+ * Every link runs the threads of a readout link handler: a receiver loading messages at rate
+ * messages per second (0: as fast as it can) into a bounded queue, and a consumer running the
+ * frame processor preprocess pipeline, the latency buffer write, cleanup_check() and the
+ * postprocess pipeline. Per detector, requesters threads serve windows of window-ticks ending
+ * request-delay-ticks before the newest key of a random link, at request-rate requests per
+ * second in total (0: back to back).
+ *
+ * Every report-interval-s, <detector>_interval holds the consumed message rate, the request
+ * latency percentiles and result codes, the messages dropped by a full queue (backpressure
+ * from the consumer), the writes rejected by the latency buffer, the occupancy and queue
+ * high-water marks, how often the occupancy was seen above buffer-size, and the payload pool
+ * high-water marks; <detector>_total sums the whole run. The run fails when a consumer or
+ * requester spends more than stall-timeout-s in a single call. Runs for hours only need a
+ * larger --duration-s, the memory used for statistics does not grow with the duration.
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/mpd/MPDFrameProcessor.hpp"
+#include "ndreadoutlibs/mpd/MPDListRequestHandler.hpp"
+#include "ndreadoutlibs/pacman/PACMANFrameProcessor.hpp"
+#include "ndreadoutlibs/pacman/PACMANListRequestHandler.hpp"
+#include "ndreadoutlibs/utils/BenchmarkReport.hpp"
+#include "ndreadoutlibs/utils/LatencyStamps.hpp"
+#include "ndreadoutlibs/utils/PayloadPool.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+
+#include <folly/ProducerConsumerQueue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::benchmark;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Expose the request path, which the DAQ module reaches through issue_request()
+template<class Handler>
+class StressRequestHandler : public Handler
+{
+public:
+  using Handler::Handler;
+  using Handler::data_request;
+};
+
+struct StressConfig
+{
+  uint64_t links;               // NOLINT(build/unsigned)
+  double rate;                  // messages per second and link
+  uint64_t queue_size;          // NOLINT(build/unsigned)
+  uint64_t tick_step;           // NOLINT(build/unsigned)
+  uint64_t requesters;          // NOLINT(build/unsigned)
+  double request_rate;          // requests per second and detector
+  uint64_t window_ticks;        // NOLINT(build/unsigned)
+  uint64_t request_delay_ticks; // NOLINT(build/unsigned)
+  uint64_t buffer_size;         // NOLINT(build/unsigned)
+  std::string model;
+  uint64_t bucket_width;      // NOLINT(build/unsigned)
+  uint64_t cleanup_budget_us; // NOLINT(build/unsigned)
+};
+
+// Cumulative counters, written by the worker threads and read by the monitor
+struct StressCounters
+{
+  std::atomic<uint64_t> received{ 0 };         // NOLINT(build/unsigned)
+  std::atomic<uint64_t> dropped{ 0 };          // NOLINT(build/unsigned)
+  std::atomic<uint64_t> consumed{ 0 };         // NOLINT(build/unsigned)
+  std::atomic<uint64_t> write_rejected{ 0 };   // NOLINT(build/unsigned)
+  std::atomic<uint64_t> found{ 0 };            // NOLINT(build/unsigned)
+  std::atomic<uint64_t> not_yet{ 0 };          // NOLINT(build/unsigned)
+  std::atomic<uint64_t> too_old{ 0 };          // NOLINT(build/unsigned)
+  std::atomic<uint64_t> not_found{ 0 };        // NOLINT(build/unsigned)
+  std::atomic<uint64_t> other_results{ 0 };    // NOLINT(build/unsigned)
+  std::atomic<uint64_t> fragment_bytes{ 0 };   // NOLINT(build/unsigned)
+  std::atomic<uint64_t> over_capacity{ 0 };    // NOLINT(build/unsigned) monitor samples above buffer-size
+  std::atomic<uint64_t> max_occupancy{ 0 };    // NOLINT(build/unsigned)
+  std::atomic<uint64_t> max_queue_depth{ 0 };  // NOLINT(build/unsigned)
+};
+
+// Interval view of StressCounters, the difference between two snapshots
+struct StressSnapshot
+{
+  uint64_t received = 0;       // NOLINT(build/unsigned)
+  uint64_t dropped = 0;        // NOLINT(build/unsigned)
+  uint64_t consumed = 0;       // NOLINT(build/unsigned)
+  uint64_t write_rejected = 0; // NOLINT(build/unsigned)
+  uint64_t found = 0;          // NOLINT(build/unsigned)
+  uint64_t not_yet = 0;        // NOLINT(build/unsigned)
+  uint64_t too_old = 0;        // NOLINT(build/unsigned)
+  uint64_t not_found = 0;      // NOLINT(build/unsigned)
+  uint64_t other_results = 0;  // NOLINT(build/unsigned)
+  uint64_t fragment_bytes = 0; // NOLINT(build/unsigned)
+  uint64_t over_capacity = 0;  // NOLINT(build/unsigned)
+
+  static StressSnapshot take(const StressCounters& c)
+  {
+    StressSnapshot s;
+    s.received = c.received.load(std::memory_order_relaxed);
+    s.dropped = c.dropped.load(std::memory_order_relaxed);
+    s.consumed = c.consumed.load(std::memory_order_relaxed);
+    s.write_rejected = c.write_rejected.load(std::memory_order_relaxed);
+    s.found = c.found.load(std::memory_order_relaxed);
+    s.not_yet = c.not_yet.load(std::memory_order_relaxed);
+    s.too_old = c.too_old.load(std::memory_order_relaxed);
+    s.not_found = c.not_found.load(std::memory_order_relaxed);
+    s.other_results = c.other_results.load(std::memory_order_relaxed);
+    s.fragment_bytes = c.fragment_bytes.load(std::memory_order_relaxed);
+    s.over_capacity = c.over_capacity.load(std::memory_order_relaxed);
+    return s;
+  }
+
+  StressSnapshot operator-(const StressSnapshot& o) const
+  {
+    StressSnapshot s;
+    s.received = received - o.received;
+    s.dropped = dropped - o.dropped;
+    s.consumed = consumed - o.consumed;
+    s.write_rejected = write_rejected - o.write_rejected;
+    s.found = found - o.found;
+    s.not_yet = not_yet - o.not_yet;
+    s.too_old = too_old - o.too_old;
+    s.not_found = not_found - o.not_found;
+    s.other_results = other_results - o.other_results;
+    s.fragment_bytes = fragment_bytes - o.fragment_bytes;
+    s.over_capacity = over_capacity - o.over_capacity;
+    return s;
+  }
+
+  uint64_t requests() const { return found + not_yet + too_old + not_found + other_results; } // NOLINT
+};
+
+void
+raise_max(std::atomic<uint64_t>& max, uint64_t value) // NOLINT(build/unsigned)
+{
+  auto current = max.load(std::memory_order_relaxed);
+  while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+}
+
+// Time a thread entered its current call, 0 while it is idle
+class Watchdog
+{
+public:
+  void enter() { m_since_ns.store(latency::now_ns(), std::memory_order_relaxed); }
+  void leave() { m_since_ns.store(0, std::memory_order_relaxed); }
+  uint64_t busy_ns(uint64_t now) const // NOLINT(build/unsigned)
+  {
+    auto since = m_since_ns.load(std::memory_order_relaxed);
+    return since != 0 && now > since ? now - since : 0;
+  }
+
+private:
+  std::atomic<uint64_t> m_since_ns{ 0 }; // NOLINT(build/unsigned)
+};
+
+class StressTarget
+{
+public:
+  virtual ~StressTarget() = default;
+  virtual void start() = 0;
+  virtual void stop() = 0;
+  // Called by the monitor: track high-water marks, return the name of a stalled thread if any
+  virtual std::string sample(uint64_t stall_timeout_ns) = 0; // NOLINT(build/unsigned)
+  virtual void report_interval(BenchmarkReport& report, double elapsed, double seconds) = 0;
+  virtual void report_total(BenchmarkReport& report, double seconds) = 0;
+};
+
+/**
+ * One detector: links of receiver, consumer, latency buffer and request handler, and the
+ * requester threads spread over those links.
+ * */
+template<class Adapter, class Processor, class Handler>
+class DetectorStress : public StressTarget
+{
+public:
+  using LatencyBuffer = NDLatencyBufferModel<Adapter>;
+
+  DetectorStress(std::string name, const StressConfig& cfg, std::vector<char> message)
+    : m_name(std::move(name))
+    , m_cfg(cfg)
+    , m_message(std::move(message))
+    , m_requester_samples(cfg.requesters)
+    , m_requester_watchdogs(cfg.requesters)
+  {
+    m_args = {
+      { "rawdataprocessorconf", { { "source_id", 0 }, { "clock_speed_hz", 50000000 }, { "emulator_mode", false } } },
+      { "ndreadoutconf",
+        { { "latency_buffer_model", cfg.model },
+          { "bucket_width_ticks", cfg.bucket_width },
+          { "cleanup_time_budget_us", cfg.cleanup_budget_us },
+          { "pacman_storage_mode", "pooled" } } },
+      { "latencybufferconf", { { "latency_buffer_size", cfg.buffer_size } } },
+      { "requesthandlerconf",
+        { { "latency_buffer_size", cfg.buffer_size },
+          { "pop_limit_pct", 0.8 },
+          { "pop_size_pct", 0.1 },
+          { "source_id", 0 } } },
+    };
+    for (uint64_t i = 0; i < cfg.links; ++i) { // NOLINT(build/unsigned)
+      m_links.push_back(std::make_unique<Link>(m_args, cfg.queue_size));
+    }
+  }
+
+  void start() override
+  {
+    m_run_marker = true;
+    for (auto& link : m_links) {
+      link->processor.start(m_args);
+      link->handler.start(m_args);
+      link->consumer = std::thread(&DetectorStress::consume, this, link.get());
+      link->receiver = std::thread(&DetectorStress::receive, this, link.get());
+    }
+    for (uint64_t i = 0; i < m_cfg.requesters; ++i) { // NOLINT(build/unsigned)
+      m_requesters.emplace_back(&DetectorStress::request, this, i);
+    }
+  }
+
+  void stop() override
+  {
+    m_run_marker = false;
+    for (auto& thread : m_requesters) {
+      thread.join();
+    }
+    for (auto& link : m_links) {
+      link->receiver.join();
+      link->consumer.join();
+      link->handler.stop(m_args);
+      link->processor.stop(m_args);
+      link->processor.scrap(m_args);
+    }
+  }
+
+  std::string sample(uint64_t stall_timeout_ns) override // NOLINT(build/unsigned)
+  {
+    auto now = latency::now_ns();
+    for (std::size_t i = 0; i < m_links.size(); ++i) {
+      auto& link = *m_links[i];
+      auto occupancy = link.latency_buffer->occupancy();
+      raise_max(m_counters.max_occupancy, occupancy);
+      m_counters.over_capacity += occupancy > m_cfg.buffer_size;
+      raise_max(m_counters.max_queue_depth, link.queue.sizeGuess());
+      if (link.watchdog.busy_ns(now) > stall_timeout_ns) {
+        return m_name + " consumer of link " + std::to_string(i);
+      }
+    }
+    for (std::size_t i = 0; i < m_requester_watchdogs.size(); ++i) {
+      if (m_requester_watchdogs[i].busy_ns(now) > stall_timeout_ns) {
+        return m_name + " requester " + std::to_string(i);
+      }
+    }
+    auto pool = PayloadPool::instance().get_stats();
+    m_max_pool_bytes_in_use = std::max(m_max_pool_bytes_in_use, pool.bytes_in_use);
+    m_max_pool_bytes_reserved = std::max(m_max_pool_bytes_reserved, pool.bytes_reserved);
+    return "";
+  }
+
+  void report_interval(BenchmarkReport& report, double elapsed, double seconds) override
+  {
+    auto now = StressSnapshot::take(m_counters);
+    LatencySampler samples;
+    for (auto& requester : m_requester_samples) {
+      std::vector<double> taken;
+      {
+        std::lock_guard<std::mutex> lk(requester.mutex);
+        taken.swap(requester.ns);
+      }
+      for (auto ns : taken) {
+        samples.add(ns);
+      }
+    }
+    auto& result = report.add(m_name + "_interval", params(elapsed), (now - m_reported).consumed, seconds, samples);
+    fill(result, now - m_reported, m_interval_latency.take());
+    result["max_occupancy"] = m_counters.max_occupancy.exchange(0);
+    result["max_queue_depth"] = m_counters.max_queue_depth.exchange(0);
+    result["max_pool_bytes_in_use"] = std::exchange(m_max_pool_bytes_in_use, 0);
+    result["max_pool_bytes_reserved"] = std::exchange(m_max_pool_bytes_reserved, 0);
+    m_reported = now;
+    m_max_total_occupancy = std::max<uint64_t>(m_max_total_occupancy, result["max_occupancy"]);
+    m_max_total_queue_depth = std::max<uint64_t>(m_max_total_queue_depth, result["max_queue_depth"]);
+    m_max_total_pool_bytes = std::max<uint64_t>(m_max_total_pool_bytes, result["max_pool_bytes_reserved"]);
+  }
+
+  void report_total(BenchmarkReport& report, double seconds) override
+  {
+    LatencySampler samples;
+    auto total = StressSnapshot::take(m_counters);
+    auto latency = m_total_latency.take();
+    auto& result = report.add(m_name + "_total", params(seconds), total.consumed, seconds, samples);
+    fill(result, total, latency);
+    // No per request samples are kept over the whole run, the histogram stands in for them
+    result["p50_ns"] = latency.p50_ns;
+    result["p99_ns"] = latency.p99_ns;
+    result["max_occupancy"] = m_max_total_occupancy;
+    result["max_queue_depth"] = m_max_total_queue_depth;
+    result["max_pool_bytes_reserved"] = m_max_total_pool_bytes;
+  }
+
+private:
+  struct Link
+  {
+    Link(const nlohmann::json& args, uint64_t queue_size) // NOLINT(build/unsigned)
+      : error_registry(std::make_unique<readoutlibs::FrameErrorRegistry>())
+      , latency_buffer(std::make_unique<LatencyBuffer>())
+      , processor(error_registry)
+      , handler(latency_buffer, error_registry)
+      , queue(queue_size + 1)
+    {
+      processor.conf(args);
+      latency_buffer->conf(args);
+      handler.conf(args);
+    }
+
+    std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry;
+    std::unique_ptr<LatencyBuffer> latency_buffer;
+    Processor processor;
+    StressRequestHandler<Handler> handler;
+    folly::ProducerConsumerQueue<Adapter> queue;
+    // Newest key written to the latency buffer, where requests are placed
+    std::atomic<uint64_t> newest_ts{ 0 }; // NOLINT(build/unsigned)
+    Watchdog watchdog;
+    std::thread receiver;
+    std::thread consumer;
+  };
+
+  struct RequesterSamples
+  {
+    std::mutex mutex;
+    std::vector<double> ns;
+  };
+
+  nlohmann::json params(double elapsed) const
+  {
+    return { { "elapsed_s", elapsed },
+             { "links", m_cfg.links },
+             { "rate", m_cfg.rate },
+             { "requesters", m_cfg.requesters },
+             { "request_rate", m_cfg.request_rate },
+             { "window_ticks", m_cfg.window_ticks },
+             { "request_delay_ticks", m_cfg.request_delay_ticks },
+             { "buffer_size", m_cfg.buffer_size },
+             { "model", m_cfg.model } };
+  }
+
+  static void fill(nlohmann::json& result, const StressSnapshot& s, const latency::HistogramSummary& latency)
+  {
+    result["received"] = s.received;
+    result["dropped"] = s.dropped;
+    result["drop_fraction"] = s.received ? static_cast<double>(s.dropped) / s.received : 0.;
+    result["write_rejected"] = s.write_rejected;
+    result["over_capacity_samples"] = s.over_capacity;
+    result["requests"] = s.requests();
+    result["requests_per_s"] = result["seconds"].get<double>() > 0. ? s.requests() / result["seconds"].get<double>() : 0.;
+    result["found"] = s.found;
+    result["not_yet"] = s.not_yet;
+    result["too_old"] = s.too_old;
+    result["not_found"] = s.not_found;
+    result["other_results"] = s.other_results;
+    result["mean_fragment_bytes"] = s.found ? s.fragment_bytes / s.found : 0;
+    result["request_mean_ns"] = latency.mean_ns;
+    result["request_p50_ns"] = latency.p50_ns;
+    result["request_p99_ns"] = latency.p99_ns;
+    result["request_p999_ns"] = latency.p999_ns;
+    result["request_max_ns"] = latency.max_ns;
+  }
+
+  // Sleep until the i-th event of a rate paced sequence is due, return false once stopped
+  bool pace(Clock::time_point start, double rate, uint64_t i) // NOLINT(build/unsigned)
+  {
+    if (rate > 0.) {
+      auto due = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(i / rate));
+      if (Clock::now() < due) {
+        std::this_thread::sleep_until(due);
+      }
+    }
+    return m_run_marker.load(std::memory_order_relaxed);
+  }
+
+  void receive(Link* link)
+  {
+    auto start = Clock::now();
+    for (uint64_t i = 0; pace(start, m_cfg.rate, i); ++i) { // NOLINT(build/unsigned)
+      Adapter adapter;
+      adapter.load_message(m_message.data(), m_message.size());
+      adapter.set_first_timestamp((i + 1) * m_cfg.tick_step);
+      ++m_counters.received;
+      // A full queue drops the message, as the receiver of a link that cannot keep up does
+      if (!link->queue.write(std::move(adapter))) {
+        ++m_counters.dropped;
+      }
+    }
+  }
+
+  void consume(Link* link)
+  {
+    Adapter adapter;
+    while (m_run_marker.load(std::memory_order_relaxed) || !link->queue.isEmpty()) {
+      if (!link->queue.read(adapter)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        continue;
+      }
+      link->watchdog.enter();
+      link->processor.preprocess_item(&adapter);
+      auto ts = adapter.get_first_timestamp();
+      if (link->latency_buffer->write(std::move(adapter))) {
+        link->newest_ts.store(ts, std::memory_order_release);
+        link->processor.postprocess_item(link->latency_buffer->back());
+      } else {
+        ++m_counters.write_rejected;
+      }
+      link->handler.cleanup_check();
+      link->watchdog.leave();
+      ++m_counters.consumed;
+    }
+  }
+
+  void request(uint64_t index) // NOLINT(build/unsigned)
+  {
+    std::mt19937_64 rng(index + 1);
+    std::uniform_int_distribution<std::size_t> pick(0, m_links.size() - 1);
+    auto& watchdog = m_requester_watchdogs[index];
+    auto& samples = m_requester_samples[index];
+    double rate = m_cfg.request_rate / m_cfg.requesters;
+    auto start = Clock::now();
+    for (uint64_t i = 0; pace(start, rate, i); ++i) { // NOLINT(build/unsigned)
+      auto& link = *m_links[pick(rng)];
+      auto newest = link.newest_ts.load(std::memory_order_acquire);
+      if (newest < m_cfg.request_delay_ticks + m_cfg.window_ticks) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      dfmessages::DataRequest dr;
+      dr.request_number = i;
+      dr.trigger_number = i;
+      dr.request_information.window_end = newest - m_cfg.request_delay_ticks;
+      dr.request_information.window_begin = dr.request_information.window_end - m_cfg.window_ticks;
+
+      watchdog.enter();
+      auto t0 = latency::now_ns();
+      auto result = link.handler.data_request(dr);
+      auto ns = latency::now_ns() - t0;
+      watchdog.leave();
+
+      m_interval_latency.record(ns);
+      m_total_latency.record(ns);
+      {
+        std::lock_guard<std::mutex> lk(samples.mutex);
+        samples.ns.push_back(ns);
+      }
+      switch (result.result_code) {
+        case Handler::ResultCode::kFound:
+          ++m_counters.found;
+          m_counters.fragment_bytes += result.fragment->get_size();
+          break;
+        case Handler::ResultCode::kNotYet:
+          ++m_counters.not_yet;
+          break;
+        case Handler::ResultCode::kTooOld:
+          ++m_counters.too_old;
+          break;
+        case Handler::ResultCode::kNotFound:
+          ++m_counters.not_found;
+          break;
+        default:
+          ++m_counters.other_results;
+      }
+    }
+  }
+
+  std::string m_name;
+  StressConfig m_cfg;
+  std::vector<char> m_message;
+  nlohmann::json m_args;
+  std::vector<std::unique_ptr<Link>> m_links;
+  std::vector<std::thread> m_requesters;
+  std::vector<RequesterSamples> m_requester_samples;
+  std::vector<Watchdog> m_requester_watchdogs;
+  std::atomic<bool> m_run_marker{ false };
+
+  StressCounters m_counters;
+  StressSnapshot m_reported;
+  latency::LogLinearHistogram m_interval_latency;
+  latency::LogLinearHistogram m_total_latency;
+  uint64_t m_max_pool_bytes_in_use = 0;   // NOLINT(build/unsigned)
+  uint64_t m_max_pool_bytes_reserved = 0; // NOLINT(build/unsigned)
+  uint64_t m_max_total_occupancy = 0;     // NOLINT(build/unsigned)
+  uint64_t m_max_total_queue_depth = 0;   // NOLINT(build/unsigned)
+  uint64_t m_max_total_pool_bytes = 0;    // NOLINT(build/unsigned)
+};
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  BenchmarkOptions opts(argc, argv);
+  auto duration_s = opts.get_double("duration-s", 10.);
+  auto report_interval_s = opts.get_double("report-interval-s", 5.);
+  auto stall_timeout_s = opts.get_double("stall-timeout-s", 5.);
+  auto detectors = opts.get_string("detectors", "mpd,pacman");
+  StressConfig cfg;
+  cfg.links = std::max<uint64_t>(opts.get("links", 2), 1);
+  cfg.rate = opts.get_double("rate", 20000.);
+  cfg.queue_size = opts.get("queue-size", 10000);
+  cfg.tick_step = opts.get("tick-step", 2500);
+  cfg.requesters = std::max<uint64_t>(opts.get("requesters", 2), 1);
+  cfg.request_rate = opts.get_double("request-rate", 1000.);
+  cfg.window_ticks = opts.get("window-ticks", 50000);
+  cfg.request_delay_ticks = opts.get("request-delay-ticks", 500000);
+  cfg.buffer_size = opts.get("buffer-size", 100000);
+  cfg.model = opts.get_string("model", "skiplist");
+  cfg.bucket_width = opts.get("bucket-width", 50000);
+  cfg.cleanup_budget_us = opts.get("cleanup-budget-us", 200);
+  uint16_t pacman_words = opts.get("pacman-words", 64); // NOLINT(build/unsigned)
+  auto mpd_size = opts.get("mpd-size", 1024);
+
+  BenchmarkReport report("stress_request_handlers");
+  std::mt19937 rng(12345);
+  std::vector<std::unique_ptr<StressTarget>> targets;
+  if (detectors.find("mpd") != std::string::npos) {
+    targets.push_back(std::make_unique<DetectorStress<types::NDReadoutMPDTypeAdapter, MPDFrameProcessor, MPDListRequestHandler>>(
+      "mpd", cfg, synthetic::make_mpd_frame(mpd_size, rng)));
+  }
+  if (detectors.find("pacman") != std::string::npos) {
+    targets.push_back(
+      std::make_unique<DetectorStress<types::NDReadoutPACMANTypeAdapter, PACMANFrameProcessor, PACMANListRequestHandler>>(
+        "pacman", cfg, synthetic::make_pacman_message(1700000000, pacman_words, 0, 10, rng)));
+  }
+
+  for (auto& target : targets) {
+    target->start();
+  }
+  auto stall_timeout_ns = static_cast<uint64_t>(stall_timeout_s * 1e9); // NOLINT(build/unsigned)
+  auto start = Clock::now();
+  auto last_report = start;
+  std::string stalled;
+  while (stalled.empty()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (auto& target : targets) {
+      if (stalled.empty()) {
+        stalled = target->sample(stall_timeout_ns);
+      }
+    }
+    auto now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - start).count();
+    bool done = elapsed >= duration_s;
+    if (done || std::chrono::duration<double>(now - last_report).count() >= report_interval_s) {
+      for (auto& target : targets) {
+        target->report_interval(report, elapsed, std::chrono::duration<double>(now - last_report).count());
+      }
+      last_report = now;
+    }
+    if (done) {
+      break;
+    }
+  }
+
+  if (!stalled.empty()) {
+    // The stalled thread cannot be joined, leave without unwinding the targets it uses
+    std::cerr << "Stall: " << stalled << " spent more than " << stall_timeout_s << " s in one call" << std::endl;
+    report.write(opts.get_string("output", "-"));
+    std::_Exit(1);
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  for (auto& target : targets) {
+    target->stop();
+    target->report_total(report, seconds);
+  }
+  report.write(opts.get_string("output", "-"));
+  return 0;
+}
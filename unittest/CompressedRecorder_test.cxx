@@ -0,0 +1,111 @@
+/**
+ * @file CompressedRecorder_test.cxx Recordings of consecutive runs and their index
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/utils/CompressedRecorder.hpp"
+
+#define BOOST_TEST_MODULE CompressedRecorder_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(CompressedRecorder_test)
+
+namespace {
+
+// Recording base path of the test, files of the given runs removed afterwards
+struct RecordPath
+{
+  RecordPath(const std::string& name, std::vector<uint32_t> runs) // NOLINT(build/unsigned)
+    : path("/tmp/" + name + "_" + std::to_string(::getpid()) + ".bin")
+    , runs(std::move(runs))
+  {}
+  ~RecordPath()
+  {
+    for (auto run : runs) {
+      std::remove(recording::run_path(path, run).c_str());
+      std::remove(recording::index_path(recording::run_path(path, run)).c_str());
+    }
+  }
+  std::string path;
+  std::vector<uint32_t> runs; // NOLINT(build/unsigned)
+};
+
+// Records count messages of 1 KiB, the i-th one filled with and keyed by first + i
+void
+record_run(CompressedRecorder& recorder, uint32_t run, char first, std::size_t count) // NOLINT(build/unsigned)
+{
+  recorder.start(run);
+  for (std::size_t i = 0; i < count; ++i) {
+    std::vector<char> msg(1024, static_cast<char>(first + i));
+    BOOST_REQUIRE(recorder.record(msg.data(), msg.size(), static_cast<uint64_t>(first + i))); // NOLINT(build/unsigned)
+  }
+  recorder.stop();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(RunPaths)
+{
+  BOOST_REQUIRE_EQUAL(recording::run_path("/data/rec.bin", 42), "/data/rec_run000042.bin");
+  BOOST_REQUIRE_EQUAL(recording::run_path("/data.d/rec", 7), "/data.d/rec_run000007");
+  BOOST_REQUIRE_EQUAL(recording::run_path("rec.bin.gz", 1234567), "rec_run1234567.bin.gz");
+  BOOST_REQUIRE_EQUAL(recording::run_path("/data/.rec", 1), "/data/.rec_run000001");
+}
+
+BOOST_AUTO_TEST_CASE(RestartKeepsPreviousRun)
+{
+  RecordPath files("CompressedRecorder_test_restart", { 1, 2 });
+  // Blocks of four messages
+  CompressedRecorder recorder;
+  recorder.conf(files.path, "gzip", 1, 4096);
+  record_run(recorder, 1, 'a', 8);
+  record_run(recorder, 2, 'A', 4);
+
+  std::vector<char> raw;
+  CompressedRecordReader first(recording::run_path(files.path, 1));
+  BOOST_REQUIRE_EQUAL(first.index().size(), 2);
+  BOOST_REQUIRE_EQUAL(first.index().front().min_ts, 'a');
+  BOOST_REQUIRE_EQUAL(first.index().back().max_ts, 'a' + 7);
+  first.read_block(1, raw);
+  BOOST_REQUIRE_EQUAL(raw.size(), 4 * 1024);
+  BOOST_REQUIRE_EQUAL(raw.back(), 'a' + 7);
+
+  CompressedRecordReader second(recording::run_path(files.path, 2));
+  BOOST_REQUIRE_EQUAL(second.index().size(), 1);
+  BOOST_REQUIRE_EQUAL(second.index().front().messages, 4);
+  second.read_block(0, raw);
+  BOOST_REQUIRE_EQUAL(raw.front(), 'A');
+}
+
+BOOST_AUTO_TEST_CASE(ExistingRecordingNotOverwritten)
+{
+  RecordPath files("CompressedRecorder_test_existing", { 3 });
+  CompressedRecorder recorder;
+  recorder.conf(files.path, "none", 1, 4096);
+  record_run(recorder, 3, 'a', 2);
+
+  // Same run number again, as after a restart of the process
+  CompressedRecorder again;
+  again.conf(files.path, "none", 1, 4096);
+  BOOST_REQUIRE_THROW(again.start(3), RecordFileError);
+  BOOST_REQUIRE(!again.is_running());
+
+  CompressedRecordReader reader(recording::run_path(files.path, 3));
+  BOOST_REQUIRE_EQUAL(reader.index().size(), 1);
+  BOOST_REQUIRE_EQUAL(reader.index().front().messages, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
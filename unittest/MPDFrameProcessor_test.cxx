@@ -0,0 +1,146 @@
+/**
+ * @file MPDFrameProcessor_test.cxx Frame checks of the MPD frame processor
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/mpd/MPDFrameProcessor.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+
+#define BOOST_TEST_MODULE MPDFrameProcessor_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(MPDFrameProcessor_test)
+
+namespace {
+
+const nlohmann::json args = { { "rawdataprocessorconf",
+                                { { "source_id", 0 }, { "clock_speed_hz", 50000000 }, { "emulator_mode", false } } } };
+
+// Run one frame through the preprocess pipeline, return whether it got a length error
+template<class Processor, class Adapter>
+bool
+has_length_error(const std::vector<char>& frame)
+{
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  Processor processor(error_registry);
+  processor.conf(args);
+  Adapter adapter;
+  adapter.load_message(frame.data(), frame.size());
+  adapter.set_first_timestamp(1000);
+  processor.preprocess_item(&adapter);
+  processor.scrap(args);
+  return error_registry->has_error("MPDLength");
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(ConsistentFrame)
+{
+  std::mt19937 rng(1);
+  auto frame = synthetic::make_mpd_frame(1024, rng);
+  BOOST_REQUIRE(!(has_length_error<MPDFrameProcessor, types::NDReadoutMPDTypeAdapter>(frame)));
+  BOOST_REQUIRE(!(has_length_error<MPDInlineFrameProcessor, types::NDReadoutMPDInlineTypeAdapter>(frame)));
+}
+
+BOOST_AUTO_TEST_CASE(TrailingBytes)
+{
+  std::mt19937 rng(2);
+  auto frame = synthetic::make_mpd_frame(1024, rng);
+  frame.resize(frame.size() + 16, 0);
+  BOOST_REQUIRE((has_length_error<MPDFrameProcessor, types::NDReadoutMPDTypeAdapter>(frame)));
+  BOOST_REQUIRE((has_length_error<MPDInlineFrameProcessor, types::NDReadoutMPDInlineTypeAdapter>(frame)));
+}
+
+BOOST_AUTO_TEST_CASE(MissingBytes)
+{
+  std::mt19937 rng(3);
+  auto frame = synthetic::make_mpd_frame(1024, rng);
+  frame.resize(frame.size() - 16);
+  BOOST_REQUIRE((has_length_error<MPDFrameProcessor, types::NDReadoutMPDTypeAdapter>(frame)));
+  BOOST_REQUIRE((has_length_error<MPDInlineFrameProcessor, types::NDReadoutMPDInlineTypeAdapter>(frame)));
+}
+
+BOOST_AUTO_TEST_CASE(OversizedFrame)
+{
+  // Above the largest payload pool block, the frame is kept in a heap buffer
+  std::mt19937 rng(6);
+  auto frame = synthetic::make_mpd_frame(2 * PayloadPool::max_block_size + 64, rng);
+  auto oversized = PayloadPool::instance().get_stats().oversized_copies;
+  types::NDReadoutMPDTypeAdapter adapter;
+  adapter.load_message(frame.data(), frame.size());
+  BOOST_REQUIRE_EQUAL(PayloadPool::instance().get_stats().oversized_copies, oversized + 1);
+  BOOST_REQUIRE_EQUAL(adapter.get_received_size(), frame.size());
+  BOOST_REQUIRE_EQUAL(adapter.get_message_size(), frame.size());
+  BOOST_REQUIRE(std::equal(frame.begin(), frame.end(), adapter.message_data()));
+
+  auto copy = adapter;
+  BOOST_REQUIRE(std::equal(frame.begin(), frame.end(), copy.message_data()));
+  BOOST_REQUIRE(!(has_length_error<MPDFrameProcessor, types::NDReadoutMPDTypeAdapter>(frame)));
+}
+
+BOOST_AUTO_TEST_CASE(EmulatorKeys)
+{
+  nlohmann::json emulator_args = args;
+  emulator_args["rawdataprocessorconf"]["emulator_mode"] = true;
+  emulator_args["ndreadoutconf"] = { { "emulator_timestamp_step_ticks", 100 } };
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  MPDFrameProcessor processor(error_registry);
+  processor.conf(emulator_args);
+  std::mt19937 rng(4);
+  auto frame = synthetic::make_mpd_frame(1024, rng);
+
+  // In order keys are kept, the others continue from the previous key
+  std::vector<std::pair<uint64_t, uint64_t>> keys = { { 1000, 1000 }, { 500, 1100 }, { 1100, 1200 }, { 5000, 5000 } }; // NOLINT
+  for (auto [key, expected] : keys) {
+    types::NDReadoutMPDTypeAdapter adapter;
+    adapter.load_message(frame.data(), frame.size());
+    adapter.set_first_timestamp(key);
+    processor.preprocess_item(&adapter);
+    BOOST_REQUIRE_EQUAL(adapter.get_timestamp(), expected);
+  }
+  BOOST_REQUIRE(!error_registry->has_error("MPDTsRegression"));
+  processor.scrap(emulator_args);
+}
+
+BOOST_AUTO_TEST_CASE(ContinuityResetAtStart)
+{
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  MPDFrameProcessor processor(error_registry);
+  processor.conf(args);
+  std::mt19937 rng(5);
+  auto frame = synthetic::make_mpd_frame(1024, rng);
+  auto process = [&](uint64_t key) { // NOLINT(build/unsigned)
+    types::NDReadoutMPDTypeAdapter adapter;
+    adapter.load_message(frame.data(), frame.size());
+    adapter.set_first_timestamp(key);
+    processor.preprocess_item(&adapter);
+  };
+
+  // A new run starting below the last key of the previous one is not a regression
+  processor.start(args);
+  process(5000);
+  processor.stop(args);
+  processor.start(args);
+  process(1000);
+  BOOST_REQUIRE(!error_registry->has_error("MPDTsRegression"));
+  process(500);
+  BOOST_REQUIRE(error_registry->has_error("MPDTsRegression"));
+  processor.stop(args);
+  processor.scrap(args);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,109 @@
+/**
+ * @file MessageReplaySource_test.cxx Keys and payload times of replayed PACMAN messages
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/NDReadoutPACMANTypeAdapter.hpp"
+#include "ndreadoutlibs/utils/MessageReplaySource.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#define BOOST_TEST_MODULE MessageReplaySource_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(MessageReplaySource_test)
+
+namespace {
+
+using Adapter = types::NDReadoutPACMANTypeAdapter;
+
+// Capture of num_messages PACMAN messages, removed with the fixture
+struct PACMANCapture
+{
+  PACMANCapture()
+  {
+    char name[] = "/tmp/ndreadoutlibs_replay_test_XXXXXX"; // NOLINT(modernize-avoid-c-arrays)
+    int fd = mkstemp(name);
+    BOOST_REQUIRE(fd >= 0);
+    close(fd);
+    path = name;
+    std::ofstream out(path, std::ios::binary);
+    std::mt19937 rng(7);
+    for (uint32_t i = 0; i < num_messages; ++i) { // NOLINT(build/unsigned)
+      auto msg = synthetic::make_pacman_message(1600000000, 32, 1000 + i * 100000, 25, rng);
+      out.write(msg.data(), msg.size());
+    }
+    Adapter::config().storage_mode = types::PACMANStorageMode::kPooled;
+    Adapter::config().timestamp_mode = types::PACMANTimestampMode::kPacketTimestamp;
+  }
+  ~PACMANCapture()
+  {
+    std::remove(path.c_str());
+    Adapter::config().timestamp_mode = types::PACMANTimestampMode::kUnixSeconds;
+  }
+
+  std::vector<Adapter> replay(MessageReplaySource<Adapter>::Stamper stamper) const
+  {
+    MessageReplaySource<Adapter> source(path, &replay::pacman_message_size, stamper);
+    source.set_timestamps(first_ts, step);
+    std::vector<Adapter> replayed;
+    std::atomic<bool> run{ true };
+    source.replay(num_messages, 0., [&](Adapter&& element) {
+      replayed.push_back(std::move(element));
+      return true;
+    }, run);
+    return replayed;
+  }
+
+  static const constexpr uint32_t num_messages = 16; // NOLINT(build/unsigned)
+  // Within a second of the 50 MHz default clock
+  static const constexpr uint64_t first_ts = 1700000000ull * 50000000 + 12345; // NOLINT(build/unsigned)
+  static const constexpr uint64_t step = 2500;                                 // NOLINT(build/unsigned)
+  std::string path;
+};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(StampedPayloadMatchesKeys, PACMANCapture)
+{
+  auto replayed = replay(&replay::stamp_pacman_message);
+  BOOST_REQUIRE_EQUAL(replayed.size(), num_messages);
+  for (std::size_t i = 0; i < replayed.size(); ++i) {
+    auto key = first_ts + i * step;
+    BOOST_REQUIRE_EQUAL(replayed[i].get_timestamp(), key);
+    // The payload decodes to the key, and its packets still pass the parity check
+    BOOST_REQUIRE_EQUAL(replayed[i].decode_timestamp(), key);
+    const char* msg = replayed[i].data.data();
+    BOOST_REQUIRE_EQUAL(pacman::load_header_unix_ts(msg), key / Adapter::config().clock_frequency);
+    for (std::size_t w = 0; w < pacman::load_header_words(msg); ++w) {
+      const char* word = msg + pacman::header_size + w * pacman::word_size;
+      BOOST_REQUIRE(Adapter::is_data_packet(word, pacman::load_packet(word)));
+    }
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(UnstampedPayloadKeepsCaptureTimes, PACMANCapture)
+{
+  auto replayed = replay(nullptr);
+  BOOST_REQUIRE_EQUAL(replayed.size(), num_messages);
+  for (std::size_t i = 0; i < replayed.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(replayed[i].get_timestamp(), first_ts + i * step);
+    BOOST_REQUIRE_EQUAL(pacman::load_header_unix_ts(replayed[i].data.data()), 1600000000u);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,74 @@
+/**
+ * @file NDLatencyBufferModel_test.cxx Eviction of the ND latency buffer with either backend
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/NDReadoutMPDTypeAdapter.hpp"
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#define BOOST_TEST_MODULE NDLatencyBufferModel_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(NDLatencyBufferModel_test)
+
+namespace {
+
+using Adapter = types::NDReadoutMPDTypeAdapter;
+using Buffer = NDLatencyBufferModel<Adapter>;
+
+const std::size_t frame_size = 256;
+
+// Buffer of the given model holding the given keys, 100 tick buckets
+void
+fill(Buffer& buffer, const std::string& model, const std::vector<uint64_t>& keys) // NOLINT(build/unsigned)
+{
+  buffer.conf(nlohmann::json{ { "ndreadoutconf", { { "latency_buffer_model", model }, { "bucket_width_ticks", 100 } } } });
+  std::mt19937 rng(5);
+  auto frame = synthetic::make_mpd_frame(frame_size, rng);
+  for (auto key : keys) {
+    Adapter adapter;
+    adapter.load_message(frame.data(), frame.size());
+    adapter.set_first_timestamp(key);
+    buffer.write(std::move(adapter));
+  }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(SkipListPopUntil)
+{
+  Buffer buffer;
+  fill(buffer, "skiplist", { 10, 30, 120, 150, 250 });
+
+  auto eviction = buffer.pop_until(140, 2);
+  BOOST_REQUIRE_EQUAL(eviction.entries, 2);
+  BOOST_REQUIRE_EQUAL(eviction.bytes, 2 * frame_size);
+  eviction = buffer.pop_until(140);
+  BOOST_REQUIRE_EQUAL(eviction.entries, 1);
+  BOOST_REQUIRE_EQUAL(buffer.occupancy(), 2);
+  BOOST_REQUIRE_EQUAL(buffer.front()->get_first_timestamp(), 150);
+}
+
+BOOST_AUTO_TEST_CASE(BucketPopUntil)
+{
+  Buffer buffer;
+  fill(buffer, "buckets", { 10, 30, 120, 150, 250 });
+
+  auto eviction = buffer.pop_until(200);
+  BOOST_REQUIRE_EQUAL(eviction.entries, 4);
+  BOOST_REQUIRE_EQUAL(eviction.bytes, 4 * frame_size);
+  BOOST_REQUIRE_EQUAL(buffer.occupancy(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
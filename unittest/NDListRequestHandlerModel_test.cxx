@@ -0,0 +1,126 @@
+/**
+ * @file NDListRequestHandlerModel_test.cxx Requests served while the ND request handler
+ * cleans up its latency buffer
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/NDReadoutMPDTypeAdapter.hpp"
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/mpd/MPDListRequestHandler.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#define BOOST_TEST_MODULE NDListRequestHandlerModel_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(NDListRequestHandlerModel_test)
+
+namespace {
+
+using Adapter = types::NDReadoutMPDTypeAdapter;
+using LatencyBuffer = NDLatencyBufferModel<Adapter>;
+
+class TestRequestHandler : public MPDListRequestHandler
+{
+public:
+  using MPDListRequestHandler::data_request;
+  using MPDListRequestHandler::MPDListRequestHandler;
+};
+
+const std::size_t frame_size = 128;
+const uint64_t key_step = 10; // NOLINT(build/unsigned)
+
+// One writer cleaning up after every write, one requester asking for the oldest data
+void
+run_requests_during_cleanup(const std::string& model)
+{
+  nlohmann::json args = {
+    { "ndreadoutconf",
+      { { "latency_buffer_model", model },
+        { "bucket_width_ticks", 100 },
+        { "cleanup_horizon_ticks", 2000 },
+        { "cleanup_batch_size", 8 } } },
+    { "latencybufferconf", { { "latency_buffer_size", 1000 } } },
+    { "requesthandlerconf",
+      { { "latency_buffer_size", 1000 }, { "pop_limit_pct", 0.5 }, { "pop_size_pct", 0.5 }, { "source_id", 0 } } },
+  };
+  auto error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  auto latency_buffer = std::make_unique<LatencyBuffer>();
+  latency_buffer->conf(args);
+  TestRequestHandler handler(latency_buffer, error_registry);
+  handler.conf(args);
+  handler.start(args);
+
+  std::mt19937 rng(17);
+  auto frame = synthetic::make_mpd_frame(frame_size, rng);
+  std::atomic<uint64_t> newest{ 0 }; // NOLINT(build/unsigned)
+  std::atomic<bool> writing{ true };
+  std::thread writer([&] {
+    for (uint64_t key = key_step; key <= 40000 * key_step; key += key_step) { // NOLINT(build/unsigned)
+      Adapter adapter;
+      adapter.load_message(frame.data(), frame.size());
+      adapter.set_first_timestamp(key);
+      latency_buffer->write(std::move(adapter));
+      newest.store(key);
+      handler.cleanup_check();
+    }
+    writing.store(false);
+  });
+
+  std::size_t found = 0;
+  std::size_t corrupted = 0;
+  while (writing.load()) {
+    // Windows at the old end of the buffer, where the cleanup evicts
+    auto back = newest.load();
+    if (back < 3000) {
+      continue;
+    }
+    dfmessages::DataRequest dr;
+    dr.request_information.window_begin = back - 2500;
+    dr.request_information.window_end = back - 1500;
+    auto result = handler.data_request(dr);
+    BOOST_REQUIRE(result.fragment);
+    if (result.result_code != TestRequestHandler::ResultCode::kFound) {
+      continue;
+    }
+    ++found;
+    const char* data = static_cast<const char*>(result.fragment->get_data());
+    std::size_t size = result.fragment->get_data_size();
+    BOOST_REQUIRE_EQUAL(size % frame_size, 0);
+    for (std::size_t offset = 0; offset < size; offset += frame_size) {
+      corrupted += std::memcmp(data + offset, frame.data(), frame_size) != 0;
+    }
+  }
+  writer.join();
+  handler.stop(args);
+
+  BOOST_REQUIRE(found > 0);
+  BOOST_REQUIRE_EQUAL(corrupted, 0);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(SkipListRequestsDuringCleanup)
+{
+  run_requests_during_cleanup("skiplist");
+}
+
+BOOST_AUTO_TEST_CASE(BucketRequestsDuringCleanup)
+{
+  run_requests_during_cleanup("buckets");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,135 @@
+/**
+ * @file NDReadoutPACMANTypeAdapter_test.cxx Storage and keys of the PACMAN type adapter
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/NDReadoutPACMANTypeAdapter.hpp"
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#define BOOST_TEST_MODULE NDReadoutPACMANTypeAdapter_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(NDReadoutPACMANTypeAdapter_test)
+
+namespace {
+
+using Adapter = types::NDReadoutPACMANTypeAdapter;
+
+// Storage mode of the test, restored afterwards
+struct StorageMode
+{
+  explicit StorageMode(types::PACMANStorageMode mode) { Adapter::config().storage_mode = mode; }
+  ~StorageMode() { Adapter::config().storage_mode = types::PACMANStorageMode::kFixedFrame; }
+};
+
+// Timestamp mode of the test, restored afterwards
+struct TimestampMode
+{
+  explicit TimestampMode(types::PACMANTimestampMode mode) { Adapter::config().timestamp_mode = mode; }
+  ~TimestampMode() { Adapter::config().timestamp_mode = types::PACMANTimestampMode::kUnixSeconds; }
+};
+
+const uint32_t unix_ts = 1700000000; // NOLINT(build/unsigned)
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(FixedFrameAllocatedOnLoad)
+{
+  StorageMode mode(types::PACMANStorageMode::kFixedFrame);
+  Adapter probe;
+  BOOST_REQUIRE_EQUAL(probe.get_buffer_size(), 0);
+  BOOST_REQUIRE_EQUAL(probe.get_message_size(), 0);
+  BOOST_REQUIRE_EQUAL(probe.get_message_type(), 0);
+  probe.set_first_timestamp(1234);
+  BOOST_REQUIRE_EQUAL(probe.get_first_timestamp(), 1234);
+
+  std::mt19937 rng(1);
+  auto msg = synthetic::make_pacman_message(unix_ts, 12, 1000, 10, rng);
+  Adapter loaded;
+  loaded.load_message(msg.data(), msg.size());
+  BOOST_REQUIRE_EQUAL(loaded.get_buffer_size(), types::PACMAN_FRAME_SIZE);
+  BOOST_REQUIRE_EQUAL(loaded.get_message_size(), msg.size());
+  BOOST_REQUIRE(std::memcmp(loaded.begin(), msg.data(), msg.size()) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(TimestampModes)
+{
+  StorageMode mode(types::PACMANStorageMode::kPooled);
+  std::mt19937 rng(2);
+  auto msg = synthetic::make_pacman_message(unix_ts, 8, 1000, 10, rng);
+  uint64_t second_ticks = uint64_t(unix_ts) * Adapter::config().clock_frequency; // NOLINT(build/unsigned)
+  auto ticks = [](uint64_t count) { // NOLINT(build/unsigned)
+    return count * Adapter::config().clock_frequency / Adapter::config().subsecond_clock_frequency;
+  };
+
+  Adapter unix_seconds;
+  unix_seconds.load_message(msg.data(), msg.size());
+  BOOST_REQUIRE_EQUAL(unix_seconds.get_timestamp(), second_ticks);
+  BOOST_REQUIRE_EQUAL(unix_seconds.get_end_timestamp(), second_ticks);
+
+  TimestampMode packet_mode(types::PACMANTimestampMode::kPacketTimestamp);
+  Adapter packet;
+  packet.load_message(msg.data(), msg.size());
+  BOOST_REQUIRE_EQUAL(packet.get_timestamp(), second_ticks + ticks(1000));
+}
+
+BOOST_AUTO_TEST_CASE(EqualKeysOrderedByArrival)
+{
+  StorageMode mode(types::PACMANStorageMode::kPooled);
+  std::mt19937 rng(3);
+  auto msg = synthetic::make_pacman_message(unix_ts, 4, 1000, 10, rng);
+  Adapter first;
+  Adapter second;
+  first.load_message(msg.data(), msg.size());
+  second.load_message(msg.data(), msg.size());
+  BOOST_REQUIRE_EQUAL(first.get_timestamp(), second.get_timestamp());
+  BOOST_REQUIRE(first < second);
+  BOOST_REQUIRE(!(second < first));
+
+  // A lookup probe carries no sequence and sorts before all loaded messages of its key
+  Adapter probe;
+  probe.set_first_timestamp(first.get_timestamp());
+  BOOST_REQUIRE(probe < first);
+
+  // Neither message is dropped as a duplicate on insert
+  NDLatencyBufferModel<Adapter> buffer;
+  BOOST_REQUIRE(buffer.write(std::move(first)));
+  BOOST_REQUIRE(buffer.write(std::move(second)));
+  BOOST_REQUIRE_EQUAL(buffer.occupancy(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(ConflictingConfigRejected)
+{
+  types::PACMANTypeAdapterConfig range;
+  range.timestamp_mode = types::PACMANTimestampMode::kPacketRange;
+  types::PACMANTypeAdapterConfig packet;
+  packet.timestamp_mode = types::PACMANTimestampMode::kPacketTimestamp;
+
+  BOOST_REQUIRE(Adapter::acquire_config(range));
+  BOOST_REQUIRE(Adapter::acquire_config(range));
+  BOOST_REQUIRE(!Adapter::acquire_config(packet));
+  BOOST_REQUIRE(Adapter::config() == range);
+
+  // Replaced once every holder released it
+  Adapter::release_config();
+  BOOST_REQUIRE(!Adapter::acquire_config(packet));
+  Adapter::release_config();
+  BOOST_REQUIRE(Adapter::acquire_config(packet));
+  BOOST_REQUIRE(Adapter::config() == packet);
+  Adapter::release_config();
+  Adapter::config() = types::PACMANTypeAdapterConfig();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,97 @@
+/**
+ * @file PACMANFrameProcessor_test.cxx Hit extraction output and worker restarts of the PACMAN
+ * frame processor
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/pacman/PACMANFrameProcessor.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#include "readoutlibs/FrameErrorRegistry.hpp"
+
+#define BOOST_TEST_MODULE PACMANFrameProcessor_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(PACMANFrameProcessor_test)
+
+namespace {
+
+const nlohmann::json args = {
+  { "rawdataprocessorconf", { { "source_id", 0 }, { "clock_speed_hz", 50000000 }, { "emulator_mode", false } } },
+  { "ndreadoutconf", { { "pacman_hit_extraction", true }, { "pacman_worker_threads", 2 } } },
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(HitExtractionNeedsSink)
+{
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  PACMANFrameProcessor processor(error_registry);
+  processor.conf(args);
+  BOOST_REQUIRE_THROW(processor.start(args), ConfigurationError);
+  processor.scrap(args);
+}
+
+BOOST_AUTO_TEST_CASE(HitsReachSink)
+{
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  PACMANFrameProcessor processor(error_registry);
+  processor.conf(args);
+  std::atomic<std::size_t> published{ 0 };
+  processor.set_hit_sink([&](pacman::LArPixHits&& hits) {
+    published.fetch_add(hits.size());
+    return true;
+  });
+  processor.start(args);
+
+  std::mt19937 rng(7);
+  auto msg = synthetic::make_pacman_message(1700000000, 32, 1000, 10, rng);
+  types::NDReadoutPACMANTypeAdapter adapter;
+  adapter.load_message(msg.data(), msg.size());
+  processor.preprocess_item(&adapter);
+  processor.postprocess_item(&adapter);
+  processor.stop(args);
+  processor.scrap(args);
+
+  pacman::LArPixHits hits;
+  auto expected = pacman::LArPixHitExtractor(50000000, 50000000).extract(msg.data(), msg.size(), hits);
+  BOOST_REQUIRE(expected > 0);
+  BOOST_REQUIRE_EQUAL(published.load(), expected);
+}
+
+BOOST_AUTO_TEST_CASE(InfoDuringRestarts)
+{
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  PACMANFrameProcessor processor(error_registry);
+  processor.conf(args);
+  processor.set_hit_sink([](pacman::LArPixHits&&) { return true; });
+
+  // Monitoring keeps walking the shards and queues while the run starts and stops
+  std::atomic<bool> monitoring{ true };
+  std::thread monitor([&] {
+    while (monitoring.load()) {
+      opmonlib::InfoCollector ci;
+      processor.get_info(ci, 1);
+    }
+  });
+  for (int run = 0; run < 50; ++run) {
+    processor.start(args);
+    processor.stop(args);
+  }
+  monitoring.store(false);
+  monitor.join();
+  processor.scrap(args);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,217 @@
+/**
+ * @file PACMANListRequestHandler_test.cxx Packet range matching, trimming and lookback cap
+ * of the PACMAN and merged link request handlers
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/NDReadoutMPDTypeAdapter.hpp"
+#include "ndreadoutlibs/NDReadoutPACMANTypeAdapter.hpp"
+#include "ndreadoutlibs/models/MergedListRequestHandlerModel.hpp"
+#include "ndreadoutlibs/models/NDLatencyBufferModel.hpp"
+#include "ndreadoutlibs/pacman/PACMANListRequestHandler.hpp"
+#include "ndreadoutlibs/pacman/PACMANMessageFormat.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#define BOOST_TEST_MODULE PACMANListRequestHandler_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <cstring>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(PACMANListRequestHandler_test)
+
+namespace {
+
+using Adapter = types::NDReadoutPACMANTypeAdapter;
+using LatencyBuffer = NDLatencyBufferModel<Adapter>;
+
+class TestRequestHandler : public PACMANListRequestHandler
+{
+public:
+  using PACMANListRequestHandler::data_request;
+  using PACMANListRequestHandler::PACMANListRequestHandler;
+};
+
+// Data packet times of the messages in a fragment, one vector per message
+std::vector<std::vector<uint64_t>> // NOLINT(build/unsigned)
+fragment_packet_ticks(const daqdataformats::Fragment& fragment)
+{
+  std::vector<std::vector<uint64_t>> messages; // NOLINT(build/unsigned)
+  const char* payload = static_cast<const char*>(fragment.get_data());
+  std::size_t remaining = fragment.get_data_size();
+  while (remaining >= pacman::header_size) {
+    std::size_t size = pacman::header_size + pacman::load_header_words(payload) * pacman::word_size;
+    BOOST_REQUIRE(size <= remaining);
+    uint64_t second_ticks = // NOLINT(build/unsigned)
+      static_cast<uint64_t>(pacman::load_header_unix_ts(payload)) * Adapter::config().clock_frequency;
+    auto& ticks = messages.emplace_back();
+    for (std::size_t i = 0; i < pacman::load_header_words(payload); ++i) {
+      const char* word = payload + pacman::header_size + i * pacman::word_size;
+      uint64_t packet = pacman::load_packet(word); // NOLINT(build/unsigned)
+      if (Adapter::is_data_packet(word, packet)) {
+        ticks.push_back(Adapter::packet_ticks(second_ticks, packet));
+      }
+    }
+    payload += size;
+    remaining -= size;
+  }
+  return messages;
+}
+
+// Three messages with disjoint packet ranges in the range timestamp mode
+struct RangeBuffer
+{
+  explicit RangeBuffer(nlohmann::json ndconf = nlohmann::json::object())
+  {
+    Adapter::config().storage_mode = types::PACMANStorageMode::kPooled;
+    Adapter::config().timestamp_mode = types::PACMANTimestampMode::kPacketRange;
+    nlohmann::json args = {
+      { "ndreadoutconf", std::move(ndconf) },
+      { "latencybufferconf", { { "latency_buffer_size", 16 } } },
+      { "requesthandlerconf",
+        { { "latency_buffer_size", 16 }, { "pop_limit_pct", 0.9 }, { "pop_size_pct", 0.5 }, { "source_id", 0 } } },
+    };
+    latency_buffer->conf(args);
+    handler = std::make_unique<TestRequestHandler>(latency_buffer, error_registry);
+    handler->conf(args);
+
+    std::mt19937 rng(11);
+    for (uint32_t i = 0; i < 3; ++i) { // NOLINT(build/unsigned)
+      auto msg = synthetic::make_pacman_message(1700000000, 9, 1000000 + i * 20000, 1000, rng);
+      Adapter adapter;
+      adapter.load_message(msg.data(), msg.size());
+      ranges.emplace_back(adapter.get_first_timestamp(), adapter.get_end_timestamp());
+      latency_buffer->write(std::move(adapter));
+    }
+  }
+  ~RangeBuffer() { Adapter::config().timestamp_mode = types::PACMANTimestampMode::kUnixSeconds; }
+
+  std::vector<std::vector<uint64_t>> request(uint64_t begin, uint64_t end) // NOLINT(build/unsigned)
+  {
+    dfmessages::DataRequest dr;
+    dr.request_information.window_begin = begin;
+    dr.request_information.window_end = end;
+    auto result = handler->data_request(dr);
+    BOOST_REQUIRE(result.fragment);
+    return fragment_packet_ticks(*result.fragment);
+  }
+
+  std::unique_ptr<readoutlibs::FrameErrorRegistry> error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  std::unique_ptr<LatencyBuffer> latency_buffer = std::make_unique<LatencyBuffer>();
+  std::unique_ptr<TestRequestHandler> handler;
+  std::vector<std::pair<uint64_t, uint64_t>> ranges; // NOLINT(build/unsigned)
+};
+
+using MergedHandlerBase = MergedListRequestHandlerModel<Adapter>;
+
+class TestMergedRequestHandler : public MergedHandlerBase
+{
+public:
+  using MergedHandlerBase::data_request;
+  using MergedHandlerBase::MergedHandlerBase;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(WindowInsideRangeFindsMessage)
+{
+  RangeBuffer buffer;
+  auto [first, end] = buffer.ranges.front();
+  BOOST_REQUIRE(first < end && end < buffer.ranges[1].first);
+  BOOST_REQUIRE_EQUAL(buffer.latency_buffer->get_max_span(), end - first);
+
+  // Starts after the key of the first message, reaches none of the others
+  auto shipped = buffer.request(first + (end - first) / 2, end + 1);
+  BOOST_REQUIRE_EQUAL(shipped.size(), 1);
+  BOOST_REQUIRE_EQUAL(shipped.front().size(), 9);
+  BOOST_REQUIRE_EQUAL(shipped.front().front(), first);
+}
+
+BOOST_AUTO_TEST_CASE(TrimKeepsWordsInWindow)
+{
+  RangeBuffer buffer(nlohmann::json{ { "pacman_trim_to_window", true } });
+  auto [first, end] = buffer.ranges.front();
+  auto begin = first + (end - first) / 2;
+
+  auto shipped = buffer.request(begin, end + 1);
+  BOOST_REQUIRE_EQUAL(shipped.size(), 1);
+  BOOST_REQUIRE(!shipped.front().empty());
+  BOOST_REQUIRE(shipped.front().size() < 9);
+  for (auto tick : shipped.front()) {
+    BOOST_REQUIRE(tick >= begin && tick <= end);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SpanCappedAndResetAtStart)
+{
+  RangeBuffer uncapped;
+  auto [first, end] = uncapped.ranges.front();
+  auto limit = (end - first) / 4;
+  RangeBuffer buffer(nlohmann::json{ { "pacman_max_range_span_ticks", limit } });
+  BOOST_REQUIRE_EQUAL(buffer.latency_buffer->get_max_span(), limit);
+  BOOST_REQUIRE_EQUAL(buffer.latency_buffer->get_capped_spans(), 3);
+
+  // Beyond the capped lookback from the window begin, the message is not found
+  auto shipped = buffer.request(first + (end - first) / 2, end + 1);
+  BOOST_REQUIRE(shipped.empty());
+
+  buffer.handler->start(nlohmann::json::object());
+  BOOST_REQUIRE_EQUAL(buffer.latency_buffer->get_max_span(), 0);
+  BOOST_REQUIRE_EQUAL(buffer.latency_buffer->get_capped_spans(), 0);
+  buffer.handler->stop(nlohmann::json::object());
+}
+
+BOOST_AUTO_TEST_CASE(MergedHandlerMatchesRanges)
+{
+  static_assert(has_end_timestamp<MergedLinkElement<Adapter>>::value);
+  static_assert(!has_end_timestamp<MergedLinkElement<types::NDReadoutMPDTypeAdapter>>::value);
+
+  Adapter::config().storage_mode = types::PACMANStorageMode::kPooled;
+  Adapter::config().timestamp_mode = types::PACMANTimestampMode::kPacketRange;
+  nlohmann::json args = {
+    { "latencybufferconf", { { "latency_buffer_size", 16 } } },
+    { "requesthandlerconf",
+      { { "latency_buffer_size", 16 }, { "pop_limit_pct", 0.9 }, { "pop_size_pct", 0.5 }, { "source_id", 0 } } },
+  };
+  auto error_registry = std::make_unique<readoutlibs::FrameErrorRegistry>();
+  auto latency_buffer = std::make_unique<NDLatencyBufferModel<MergedLinkElement<Adapter>>>();
+  latency_buffer->conf(args);
+  TestMergedRequestHandler handler(latency_buffer, error_registry);
+  handler.conf(args);
+
+  std::mt19937 rng(11);
+  std::vector<std::pair<uint64_t, uint64_t>> ranges; // NOLINT(build/unsigned)
+  for (uint32_t i = 0; i < 3; ++i) { // NOLINT(build/unsigned)
+    auto msg = synthetic::make_pacman_message(1700000000, 9, 1000000 + i * 20000, 1000, rng);
+    Adapter adapter;
+    adapter.load_message(msg.data(), msg.size());
+    ranges.emplace_back(adapter.get_first_timestamp(), adapter.get_end_timestamp());
+    latency_buffer->write(MergedLinkElement<Adapter>(std::move(adapter), i));
+  }
+  Adapter::config().timestamp_mode = types::PACMANTimestampMode::kUnixSeconds;
+  auto [first, end] = ranges.front();
+  BOOST_REQUIRE_EQUAL(latency_buffer->get_max_span(), end - first);
+
+  // Keyed before the window, its range reaches into it: one header and one message
+  dfmessages::DataRequest dr;
+  dr.request_information.window_begin = first + (end - first) / 2;
+  dr.request_information.window_end = end + 1;
+  auto result = handler.data_request(dr);
+  BOOST_REQUIRE(result.fragment);
+  const char* payload = static_cast<const char*>(result.fragment->get_data());
+  MergedPieceHeader header;
+  std::memcpy(&header, payload, sizeof(header));
+  BOOST_REQUIRE_EQUAL(header.link, 0);
+  BOOST_REQUIRE_EQUAL(result.fragment->get_data_size(), sizeof(header) + header.size);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
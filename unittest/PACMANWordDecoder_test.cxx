@@ -0,0 +1,101 @@
+/**
+ * @file PACMANWordDecoder_test.cxx Scalar and AVX2 paths of the PACMAN word decoder
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/pacman/PACMANMessageFormat.hpp"
+#include "ndreadoutlibs/pacman/PACMANWordDecoder.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#define BOOST_TEST_MODULE PACMANWordDecoder_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace dunedaq::ndreadoutlibs;
+using namespace dunedaq::ndreadoutlibs::pacman;
+
+BOOST_AUTO_TEST_SUITE(PACMANWordDecoder_test)
+
+namespace {
+
+// Words of all types, with random packets (about half of them with a parity error)
+std::vector<char>
+make_mixed_words(std::size_t num_words, std::mt19937& rng)
+{
+  const char types[] = { 'D', 'D', 'D', 'T', 'S', 'P', 'W', 'R', 'E', 'x', 0 }; // NOLINT(modernize-avoid-c-arrays)
+  std::uniform_int_distribution<std::size_t> type(0, sizeof(types) - 1);
+  std::uniform_int_distribution<uint32_t> byte(0, 255);            // NOLINT(build/unsigned)
+  std::uniform_int_distribution<uint64_t> bits;                    // NOLINT(build/unsigned)
+  std::uniform_int_distribution<uint32_t> ts(0, timestamp_mask); // NOLINT(build/unsigned)
+  std::vector<char> words(num_words * word_size);
+  for (std::size_t i = 0; i < num_words; ++i) {
+    char* word = words.data() + i * word_size;
+    word[word_type_offset] = types[type(rng)];
+    word[word_channel_offset] = static_cast<char>(byte(rng));
+    uint64_t packet = byte(rng) % 4 == 0 ? bits(rng) // NOLINT(build/unsigned)
+                                         : encode_data_packet(byte(rng), byte(rng) % 64, ts(rng), byte(rng));
+    if (byte(rng) % 8 == 0) {
+      packet ^= uint64_t(1) << parity_shift; // NOLINT(build/unsigned)
+    }
+    std::memcpy(word + word_packet_offset, &packet, sizeof(packet));
+  }
+  return words;
+}
+
+void
+require_equal(const PACMANMessageSummary& a, const PACMANMessageSummary& b)
+{
+  BOOST_REQUIRE_EQUAL(a.num_words, b.num_words);
+  BOOST_REQUIRE_EQUAL(a.data_packets, b.data_packets);
+  BOOST_REQUIRE_EQUAL(a.parity_errors, b.parity_errors);
+  BOOST_REQUIRE_EQUAL(a.unknown_word_types, b.unknown_word_types);
+  BOOST_REQUIRE_EQUAL(a.size_errors, b.size_errors);
+  BOOST_REQUIRE_EQUAL(a.min_packet_timestamp, b.min_packet_timestamp);
+  BOOST_REQUIRE_EQUAL(a.max_packet_timestamp, b.max_packet_timestamp);
+  BOOST_REQUIRE(a.word_type_counts == b.word_type_counts);
+  BOOST_REQUIRE(a.io_channel_hits == b.io_channel_hits);
+  BOOST_REQUIRE(a.chip_hits == b.chip_hits);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(ScalarCountsDataPackets)
+{
+  std::mt19937 rng(1);
+  auto msg = synthetic::make_pacman_message(1700000000, 10, 1000, 10, rng);
+  PACMANMessageSummary summary;
+  PACMANWordDecoder::decode(msg.data(), msg.size(), summary);
+  BOOST_REQUIRE_EQUAL(summary.num_words, 10);
+  BOOST_REQUIRE_EQUAL(summary.data_packets + summary.parity_errors, 10);
+  BOOST_REQUIRE_EQUAL(summary.format_errors(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(AVX2MatchesScalar)
+{
+#ifdef NDREADOUTLIBS_PACMAN_DECODER_AVX2
+  if (!PACMANWordDecoder::vectorized()) {
+    BOOST_TEST_MESSAGE("No AVX2 on this CPU, only the scalar path is available");
+    return;
+  }
+  std::mt19937 rng(2);
+  // Word counts around the four word stride, for the tail handling
+  for (std::size_t num_words : { 0, 1, 3, 4, 5, 7, 8, 63, 64, 65, 1000 }) {
+    auto words = make_mixed_words(num_words, rng);
+    PACMANMessageSummary scalar;
+    PACMANMessageSummary avx2;
+    PACMANWordDecoder::decode_words_scalar(words.data(), num_words, scalar);
+    PACMANWordDecoder::decode_words_avx2(words.data(), num_words, avx2);
+    require_equal(scalar, avx2);
+  }
+#else
+  BOOST_TEST_MESSAGE("AVX2 decoder not compiled for this target");
+#endif
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,86 @@
+/**
+ * @file SPSCWorkerPool_test.cxx Job accounting of the SPSC worker pool
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/utils/SPSCWorkerPool.hpp"
+
+#define BOOST_TEST_MODULE SPSCWorkerPool_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(SPSCWorkerPool_test)
+
+BOOST_AUTO_TEST_CASE(AcceptedJobsRun)
+{
+  SPSCWorkerPool<int> pool;
+  std::atomic<uint64_t> handled{ 0 }; // NOLINT(build/unsigned)
+  pool.allocate(2, 64);
+  pool.start("test-work", [&](std::size_t, int&) { handled.fetch_add(1); });
+  for (int i = 0; i < 100; ++i) {
+    while (!pool.dispatch(i % 2, int(i))) {
+      std::this_thread::yield();
+    }
+  }
+  pool.stop();
+  BOOST_REQUIRE_EQUAL(handled.load(), 100);
+  BOOST_REQUIRE(!pool.dispatch(0, 1));
+}
+
+BOOST_AUTO_TEST_CASE(StopDuringDispatch)
+{
+  // Every job is either refused by dispatch() or run, also when stop() races with it
+  for (int round = 0; round < 20; ++round) {
+    SPSCWorkerPool<int> pool;
+    std::atomic<uint64_t> handled{ 0 }; // NOLINT(build/unsigned)
+    pool.allocate(1, 1024);
+    pool.start("test-work", [&](std::size_t, int&) { handled.fetch_add(1); });
+    uint64_t accepted = 0; // NOLINT(build/unsigned)
+    std::atomic<bool> producing{ true };
+    std::thread producer([&] {
+      while (producing.load()) {
+        accepted += pool.dispatch(0, 1);
+      }
+    });
+    std::this_thread::sleep_for(std::chrono::microseconds(200 + round * 50));
+    pool.stop();
+    producing.store(false);
+    producer.join();
+    BOOST_REQUIRE_EQUAL(handled.load(), accepted);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(QueuesKeptAcrossRestarts)
+{
+  SPSCWorkerPool<int> pool;
+  std::atomic<uint64_t> handled{ 0 }; // NOLINT(build/unsigned)
+  pool.allocate(3, 16);
+  for (int run = 0; run < 3; ++run) {
+    pool.start("test-work", [&](std::size_t, int&) { handled.fetch_add(1); });
+    BOOST_REQUIRE_EQUAL(pool.num_workers(), 3);
+    while (!pool.dispatch(run, int(run))) {
+      std::this_thread::yield();
+    }
+    pool.stop();
+    BOOST_REQUIRE_EQUAL(pool.num_workers(), 3);
+    BOOST_REQUIRE_EQUAL(pool.get_queued(), 0);
+  }
+  BOOST_REQUIRE_EQUAL(handled.load(), 3);
+
+  // Not while running
+  pool.start("test-work", [&](std::size_t, int&) {});
+  pool.allocate(1, 16);
+  BOOST_REQUIRE_EQUAL(pool.num_workers(), 3);
+  pool.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
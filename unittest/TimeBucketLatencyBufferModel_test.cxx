@@ -0,0 +1,132 @@
+/**
+ * @file TimeBucketLatencyBufferModel_test.cxx Bucketing, window lookups and eviction of the
+ * time bucket latency buffer
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/NDReadoutMPDTypeAdapter.hpp"
+#include "ndreadoutlibs/models/TimeBucketLatencyBufferModel.hpp"
+#include "ndreadoutlibs/utils/SyntheticMessages.hpp"
+
+#define BOOST_TEST_MODULE TimeBucketLatencyBufferModel_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <random>
+#include <vector>
+
+using namespace dunedaq;
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(TimeBucketLatencyBufferModel_test)
+
+namespace {
+
+using Adapter = types::NDReadoutMPDTypeAdapter;
+using Buffer = TimeBucketLatencyBufferModel<Adapter>;
+
+const std::size_t frame_size = 256;
+
+// Buffer of 100 tick buckets holding the given keys, written in order
+struct BucketBuffer
+{
+  explicit BucketBuffer(const std::vector<uint64_t>& keys) // NOLINT(build/unsigned)
+  {
+    buffer.conf(nlohmann::json{ { "ndreadoutconf", { { "bucket_width_ticks", 100 } } } });
+    std::mt19937 rng(3);
+    auto frame = synthetic::make_mpd_frame(frame_size, rng);
+    for (auto key : keys) {
+      Adapter adapter;
+      adapter.load_message(frame.data(), frame.size());
+      adapter.set_first_timestamp(key);
+      buffer.write(std::move(adapter));
+    }
+  }
+
+  std::vector<uint64_t> window(uint64_t begin, uint64_t end) // NOLINT(build/unsigned)
+  {
+    std::vector<uint64_t> keys; // NOLINT(build/unsigned)
+    buffer.for_each_in_window(begin, end, [&](Adapter& element) { keys.push_back(element.get_first_timestamp()); });
+    return keys;
+  }
+
+  Buffer buffer;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(WindowVisitsOverlappingBuckets)
+{
+  BucketBuffer b({ 10, 30, 150, 120, 250 });
+  BOOST_REQUIRE_EQUAL(b.buffer.get_bucket_width(), 100);
+  BOOST_REQUIRE_EQUAL(b.buffer.num_buckets(), 3);
+  BOOST_REQUIRE_EQUAL(b.buffer.occupancy(), 5);
+
+  // Arrival order within a bucket, only keys inside the window
+  BOOST_REQUIRE((b.window(100, 200) == std::vector<uint64_t>{ 150, 120 })); // NOLINT(build/unsigned)
+  BOOST_REQUIRE((b.window(125, 251) == std::vector<uint64_t>{ 150, 250 })); // NOLINT(build/unsigned)
+  BOOST_REQUIRE((b.window(0, 1000) == std::vector<uint64_t>{ 10, 30, 150, 120, 250 })); // NOLINT(build/unsigned)
+  BOOST_REQUIRE(b.window(300, 1000).empty());
+}
+
+BOOST_AUTO_TEST_CASE(LateElementJoinsItsBucket)
+{
+  BucketBuffer b({ 10, 150, 250, 40 });
+  BOOST_REQUIRE_EQUAL(b.buffer.num_buckets(), 3);
+  BOOST_REQUIRE((b.window(0, 100) == std::vector<uint64_t>{ 10, 40 })); // NOLINT(build/unsigned)
+}
+
+BOOST_AUTO_TEST_CASE(PopUntilRetiresWholeBuckets)
+{
+  BucketBuffer b({ 10, 30, 150, 120, 250 });
+
+  // Buckets [0, 100) and [100, 200) end at or before 200
+  auto eviction = b.buffer.pop_until(200);
+  BOOST_REQUIRE_EQUAL(eviction.entries, 4);
+  BOOST_REQUIRE_EQUAL(eviction.bytes, 4 * frame_size);
+  BOOST_REQUIRE_EQUAL(b.buffer.num_buckets(), 1);
+  BOOST_REQUIRE_EQUAL(b.buffer.occupancy(), 1);
+  BOOST_REQUIRE((b.window(0, 1000) == std::vector<uint64_t>{ 250 })); // NOLINT(build/unsigned)
+
+  // The bucket being written is hidden rather than retired, its bytes are not freed yet
+  eviction = b.buffer.pop_until(1000);
+  BOOST_REQUIRE_EQUAL(eviction.entries, 1);
+  BOOST_REQUIRE_EQUAL(eviction.bytes, 0);
+  BOOST_REQUIRE_EQUAL(b.buffer.occupancy(), 0);
+  BOOST_REQUIRE(b.window(0, 1000).empty());
+}
+
+BOOST_AUTO_TEST_CASE(PopUntilStopsAtMaxEntries)
+{
+  BucketBuffer b({ 10, 30, 150, 120, 250 });
+  auto eviction = b.buffer.pop_until(200, 1);
+  // Whole buckets only: the first one goes with both of its elements
+  BOOST_REQUIRE_EQUAL(eviction.entries, 2);
+  BOOST_REQUIRE((b.window(0, 1000) == std::vector<uint64_t>{ 150, 120, 250 })); // NOLINT(build/unsigned)
+}
+
+BOOST_AUTO_TEST_CASE(FrontAndBackKeys)
+{
+  BucketBuffer b({ 10, 30, 150, 120, 250 });
+  BOOST_REQUIRE_EQUAL(*b.buffer.front_timestamp(), 10);
+  BOOST_REQUIRE_EQUAL(*b.buffer.back_timestamp(), 250);
+
+  b.buffer.pop_until(200);
+  BOOST_REQUIRE_EQUAL(*b.buffer.front_timestamp(), 250);
+
+  // Hidden elements are neither front nor back
+  b.buffer.pop_until(1000);
+  BOOST_REQUIRE(!b.buffer.front_timestamp());
+  BOOST_REQUIRE(!b.buffer.back_timestamp());
+}
+
+BOOST_AUTO_TEST_CASE(ZeroWidthRejected)
+{
+  Buffer buffer;
+  BOOST_REQUIRE_THROW(buffer.conf(nlohmann::json{ { "ndreadoutconf", { { "bucket_width_ticks", 0 } } } }),
+                      ConfigurationError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
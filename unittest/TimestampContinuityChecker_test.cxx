@@ -0,0 +1,78 @@
+/**
+ * @file TimestampContinuityChecker_test.cxx Classification and counters of the timestamp
+ * continuity checker
+ *
+ * This is part of the DUNE DAQ , copyright 2023.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ndreadoutlibs/NDReadoutMPDTypeAdapter.hpp"
+#include "ndreadoutlibs/utils/TimestampContinuityChecker.hpp"
+
+#define BOOST_TEST_MODULE TimestampContinuityChecker_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+using namespace dunedaq::ndreadoutlibs;
+
+BOOST_AUTO_TEST_SUITE(TimestampContinuityChecker_test)
+
+using Checker = TimestampContinuityChecker<types::NDReadoutMPDTypeAdapter>;
+
+BOOST_AUTO_TEST_CASE(Classification)
+{
+  Checker checker(1000);
+  BOOST_REQUIRE_EQUAL(checker.check(5000), Checker::kFirst);
+  BOOST_REQUIRE_EQUAL(checker.check(5100), Checker::kOk);
+  BOOST_REQUIRE_EQUAL(checker.check(5100), Checker::kDuplicate);
+  BOOST_REQUIRE_EQUAL(checker.check(5000), Checker::kRegression);
+  BOOST_REQUIRE_EQUAL(checker.check(6000), Checker::kOk);
+  BOOST_REQUIRE_EQUAL(checker.check(7001), Checker::kGap);
+  BOOST_REQUIRE_EQUAL(checker.get_previous_timestamp(), 7001);
+
+  BOOST_REQUIRE(Checker::is_error(Checker::kDuplicate));
+  BOOST_REQUIRE(Checker::is_error(Checker::kRegression));
+  BOOST_REQUIRE(!Checker::is_error(Checker::kGap));
+  BOOST_REQUIRE(!Checker::is_error(Checker::kFirst));
+}
+
+BOOST_AUTO_TEST_CASE(GapDetectionDisabled)
+{
+  Checker checker;
+  checker.check(1);
+  BOOST_REQUIRE_EQUAL(checker.check(1000000000), Checker::kOk);
+}
+
+BOOST_AUTO_TEST_CASE(ResetPrevious)
+{
+  Checker checker;
+  checker.check(5000);
+  checker.reset_previous();
+  BOOST_REQUIRE_EQUAL(checker.check(1000), Checker::kFirst);
+  BOOST_REQUIRE_EQUAL(checker.check(900), Checker::kRegression);
+}
+
+BOOST_AUTO_TEST_CASE(InfoSincePreviousCall)
+{
+  Checker checker(100);
+  for (uint64_t ts : { 10, 20, 30, 30, 25, 1000 }) { // NOLINT(build/unsigned)
+    checker.check(ts);
+  }
+  auto info = checker.get_info();
+  BOOST_REQUIRE_EQUAL(info.frames, 6);
+  BOOST_REQUIRE_EQUAL(info.duplicates, 1);
+  BOOST_REQUIRE_EQUAL(info.regressions, 1);
+  BOOST_REQUIRE_EQUAL(info.gaps, 1);
+  // Forward deltas 10, 10 and 975: bins [8, 16) and [512, 1024)
+  BOOST_REQUIRE_EQUAL(info.delta_p50_ticks, 15);
+  BOOST_REQUIRE_EQUAL(info.delta_max_ticks, 1023);
+
+  checker.check(1010);
+  info = checker.get_info();
+  BOOST_REQUIRE_EQUAL(info.frames, 1);
+  BOOST_REQUIRE_EQUAL(info.duplicates, 0);
+  BOOST_REQUIRE_EQUAL(info.gaps, 0);
+  BOOST_REQUIRE_EQUAL(info.delta_max_ticks, 15);
+}
+
+BOOST_AUTO_TEST_SUITE_END()